@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "crc32c.h"
+
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#define CRC32C_X86
+#include <immintrin.h>
+#endif // defined( __GNUC__ ) && defined( __x86_64__ )
+
+// reflected Castagnoli polynomial
+#define CRC32C_POLY 0x82f63b78
+
+typedef uint32_t (*crc32c_copy_fn)( uint32_t crc, uint8_t *dst, const uint8_t *src, size_t len );
+
+static uint32_t crc32c_table[ 8 ][ 256 ];
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+static pthread_once_t crc32c_impl_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_table_init( void ) {
+	unsigned i, j;
+	uint32_t crc;
+
+	for( i = 0; i < 256; i++ ) {
+		crc = i;
+		for( j = 0; j < 8; j++ ) {
+			crc = ( crc >> 1 ) ^ ( CRC32C_POLY & -( crc & 1 ) );
+		}
+		crc32c_table[ 0 ][ i ] = crc;
+	}
+	for( i = 0; i < 256; i++ ) {
+		crc = crc32c_table[ 0 ][ i ];
+		for( j = 1; j < 8; j++ ) {
+			crc = crc32c_table[ 0 ][ crc & 0xff ] ^ ( crc >> 8 );
+			crc32c_table[ j ][ i ] = crc;
+		}
+	}
+}
+
+static inline uint32_t ld32le( const uint8_t *p ) {
+	return (uint32_t) p[ 0 ] | (uint32_t) p[ 1 ] << 8 | (uint32_t) p[ 2 ] << 16 | (uint32_t) p[ 3 ] << 24;
+}
+
+// slicing-by-8; dst may be NULL when only checksumming
+static uint32_t crc32c_copy_slice8( uint32_t crc, uint8_t *dst, const uint8_t *src, size_t len ) {
+	uint32_t lo, hi;
+	uint32_t (*t)[ 256 ];
+
+	t = crc32c_table;
+	crc = ~crc;
+
+	for( ; len >= 8; len -= 8, src += 8 ) {
+		if ( NULL != dst ) {
+			memcpy( dst, src, 8 );
+			dst += 8;
+		}
+		lo = ld32le( src ) ^ crc;
+		hi = ld32le( src + 4 );
+		crc =
+			t[ 7 ][ lo & 0xff ] ^ t[ 6 ][ ( lo >> 8 ) & 0xff ] ^ t[ 5 ][ ( lo >> 16 ) & 0xff ] ^ t[ 4 ][ lo >> 24 ]
+			^ t[ 3 ][ hi & 0xff ] ^ t[ 2 ][ ( hi >> 8 ) & 0xff ] ^ t[ 1 ][ ( hi >> 16 ) & 0xff ] ^ t[ 0 ][ hi >> 24 ];
+	}
+	for( ; len > 0; len--, src++ ) {
+		if ( NULL != dst ) {
+			*dst++ = *src;
+		}
+		crc = t[ 0 ][ ( crc ^ *src ) & 0xff ] ^ ( crc >> 8 );
+	}
+
+	return ~crc;
+}
+
+#ifdef CRC32C_X86
+
+__attribute__(( target( "sse4.2" ) ))
+static uint32_t crc32c_copy_sse42( uint32_t crc, uint8_t *dst, const uint8_t *src, size_t len ) {
+	uint64_t crc64;
+	uint64_t v;
+
+	crc64 = (uint32_t) ~crc;
+
+	for( ; len >= 8; len -= 8, src += 8 ) {
+		memcpy( & v, src, 8 );
+		if ( NULL != dst ) {
+			memcpy( dst, & v, 8 );
+			dst += 8;
+		}
+		crc64 = _mm_crc32_u64( crc64, v );
+	}
+	for( ; len > 0; len--, src++ ) {
+		if ( NULL != dst ) {
+			*dst++ = *src;
+		}
+		crc64 = _mm_crc32_u8( (uint32_t) crc64, *src );
+	}
+
+	return ~(uint32_t) crc64;
+}
+
+#endif // CRC32C_X86
+
+static crc32c_copy_fn crc32c_impl;
+
+static void crc32c_impl_init( void ) {
+	crc32c_impl = crc32c_copy_slice8;
+#ifdef CRC32C_X86
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "sse4.2" ) ) {
+		crc32c_impl = crc32c_copy_sse42;
+		return;
+	}
+#endif // CRC32C_X86
+	pthread_once( & crc32c_table_once, crc32c_table_init );
+}
+
+static inline crc32c_copy_fn crc32c_get_impl( void ) {
+	pthread_once( & crc32c_impl_once, crc32c_impl_init );
+	return crc32c_impl;
+}
+
+uint32_t crc32c( uint32_t crc, const void *data, size_t len ) {
+	if ( NULL == data || 0 == len ) {
+		return crc;
+	}
+	return crc32c_get_impl()( crc, NULL, (const uint8_t *) data, len );
+}
+
+uint32_t crc32c_copy( uint32_t crc, void *dst, const void *src, size_t len ) {
+	if ( NULL == dst || NULL == src || 0 == len ) {
+		return crc;
+	}
+	return crc32c_get_impl()( crc, (uint8_t *) dst, (const uint8_t *) src, len );
+}
+
+uint32_t crc32c_sw( uint32_t crc, const void *data, size_t len ) {
+	if ( NULL == data || 0 == len ) {
+		return crc;
+	}
+	pthread_once( & crc32c_table_once, crc32c_table_init );
+	return crc32c_copy_slice8( crc, NULL, (const uint8_t *) data, len );
+}
+
+uint32_t crc32c_copy_sw( uint32_t crc, void *dst, const void *src, size_t len ) {
+	if ( NULL == dst || NULL == src || 0 == len ) {
+		return crc;
+	}
+	pthread_once( & crc32c_table_once, crc32c_table_init );
+	return crc32c_copy_slice8( crc, (uint8_t *) dst, (const uint8_t *) src, len );
+}
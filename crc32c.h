@@ -0,0 +1,21 @@
+#ifndef CRC32C_H_
+#define CRC32C_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli). crc is the running value, starting from 0, so that
+// crc32c( crc32c( 0, a, n ), b, m ) is the checksum of a followed by b.
+// SSE4.2 is used when the CPU has it, and a slicing-by-8 table otherwise.
+
+uint32_t crc32c( uint32_t crc, const void *data, size_t len );
+
+// copy len bytes from src to dst while checksumming them, in a single pass
+uint32_t crc32c_copy( uint32_t crc, void *dst, const void *src, size_t len );
+
+// as above, but always with the slicing-by-8 table, whatever the CPU has, so
+// that the fallback can be checked on hosts that would never select it
+uint32_t crc32c_sw( uint32_t crc, const void *data, size_t len );
+uint32_t crc32c_copy_sw( uint32_t crc, void *dst, const void *src, size_t len );
+
+#endif /* CRC32C_H_ */
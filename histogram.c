@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "histogram.h"
+
+#define HISTOGRAM_SUB ( 1u << HISTOGRAM_SUB_BITS )
+
+static inline unsigned hbucket( uint64_t value ) {
+	unsigned r;
+	unsigned shift;
+
+	if ( value < HISTOGRAM_SUB ) {
+		r = value;
+		goto out;
+	}
+
+	// the top HISTOGRAM_SUB_BITS + 1 bits of the value pick the bucket
+	shift = 63 - __builtin_clzll( value ) - HISTOGRAM_SUB_BITS;
+	r = ( ( shift + 1 ) << HISTOGRAM_SUB_BITS ) | ( ( value >> shift ) & ( HISTOGRAM_SUB - 1 ) );
+
+out:
+	return r;
+}
+
+// the largest value that falls into bucket i
+static inline uint64_t hhighest( unsigned i ) {
+	uint64_t r;
+	unsigned shift;
+
+	if ( i < HISTOGRAM_SUB ) {
+		r = i;
+		goto out;
+	}
+
+	shift = ( i >> HISTOGRAM_SUB_BITS ) - 1;
+	r = ( (uint64_t)( HISTOGRAM_SUB | ( i & ( HISTOGRAM_SUB - 1 ) ) ) << shift ) + ( ( (uint64_t) 1 << shift ) - 1 );
+
+out:
+	return r;
+}
+
+void histogram_reset( histogram_t *h ) {
+	if ( NULL == h ) {
+		goto out;
+	}
+	memset( h, 0, sizeof( *h ) );
+out:
+	return;
+}
+
+void histogram_record( histogram_t *h, uint64_t value ) {
+	uint64_t max;
+
+	if ( NULL == h ) {
+		goto out;
+	}
+
+	__atomic_fetch_add( & h->counts[ hbucket( value ) ], 1, __ATOMIC_RELAXED );
+	__atomic_fetch_add( & h->sum, value, __ATOMIC_RELAXED );
+
+	max = __atomic_load_n( & h->max, __ATOMIC_RELAXED );
+	while( value > max && ! __atomic_compare_exchange_n( & h->max, & max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+
+out:
+	return;
+}
+
+uint64_t histogram_count( histogram_t *h ) {
+	uint64_t r;
+	unsigned i;
+
+	r = 0;
+	if ( NULL == h ) {
+		goto out;
+	}
+
+	for( i = 0; i < HISTOGRAM_BUCKETS; i++ ) {
+		r += __atomic_load_n( & h->counts[ i ], __ATOMIC_RELAXED );
+	}
+
+out:
+	return r;
+}
+
+double histogram_mean( histogram_t *h ) {
+	uint64_t count = histogram_count( h );
+	return 0 == count ? 0 : (double) __atomic_load_n( & h->sum, __ATOMIC_RELAXED ) / count;
+}
+
+uint64_t histogram_max( histogram_t *h ) {
+	return NULL == h ? 0 : __atomic_load_n( & h->max, __ATOMIC_RELAXED );
+}
+
+uint64_t histogram_percentile( histogram_t *h, double p ) {
+	uint64_t r;
+	uint64_t counts[ HISTOGRAM_BUCKETS ];
+	uint64_t total;
+	uint64_t rank;
+	unsigned i;
+
+	r = 0;
+	if ( NULL == h ) {
+		goto out;
+	}
+
+	// work from one copy, so that concurrent recording cannot move the rank past the end
+	total = 0;
+	for( i = 0; i < HISTOGRAM_BUCKETS; i++ ) {
+		counts[ i ] = __atomic_load_n( & h->counts[ i ], __ATOMIC_RELAXED );
+		total += counts[ i ];
+	}
+	if ( 0 == total ) {
+		goto out;
+	}
+
+	p = p < 0 ? 0 : p > 100 ? 100 : p;
+	rank = (uint64_t)( p / 100 * total + 0.5 );
+	rank = 0 == rank ? 1 : rank;
+
+	for( i = 0, total = 0; i < HISTOGRAM_BUCKETS; i++ ) {
+		total += counts[ i ];
+		if ( total >= rank ) {
+			r = hhighest( i );
+			break;
+		}
+	}
+
+out:
+	return r;
+}
@@ -0,0 +1,31 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <stdint.h>
+
+// A log-linear histogram of 64-bit values, in the style of HdrHistogram:
+// values below 2^HISTOGRAM_SUB_BITS are counted exactly, and each power of two
+// above that is split into 2^HISTOGRAM_SUB_BITS equal buckets, so every value
+// is resolved to within 1 / 2^HISTOGRAM_SUB_BITS (about 3%) of itself over the
+// whole 64-bit range. Recording is a single relaxed atomic increment and may
+// happen from any number of threads, concurrently with queries.
+
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_BUCKETS ( ( 64 - HISTOGRAM_SUB_BITS + 1 ) << HISTOGRAM_SUB_BITS )
+
+typedef struct {
+	uint64_t         counts[ HISTOGRAM_BUCKETS ];
+	uint64_t         sum;
+	uint64_t         max;
+} histogram_t;
+
+void histogram_reset( histogram_t *h );
+void histogram_record( histogram_t *h, uint64_t value );
+
+uint64_t histogram_count( histogram_t *h );
+double histogram_mean( histogram_t *h );
+uint64_t histogram_max( histogram_t *h );
+// the largest value equivalent to the p'th percentile (0 <= p <= 100), or 0 when empty
+uint64_t histogram_percentile( histogram_t *h, double p );
+
+#endif /* HISTOGRAM_H_ */
@@ -0,0 +1,205 @@
+#ifndef RING_BUFFER_ASYNC_HPP_
+#define RING_BUFFER_ASYNC_HPP_
+
+#include <coroutine>
+
+#include "ring-buffer.hpp"
+
+namespace ringbuffer {
+
+// Resumes coroutines that were parked on an async_ring. post() is called from
+// inside the ring operation that satisfied the coroutine, so an executor
+// would usually queue h and resume it later, from its own loop.
+class executor {
+
+public:
+
+	virtual ~executor() = default;
+	virtual void post( std::coroutine_handle<> h ) = 0;
+};
+
+// Resumes h immediately, inside the peer operation.
+class inline_executor : public executor {
+
+public:
+
+	void post( std::coroutine_handle<> h ) override {
+		h.resume();
+	}
+};
+
+// A ring that coroutines can co_await on, instead of polling it:
+//
+//     int n = co_await async_read( ar, buf, 64 );
+//
+// suspends until 64 bytes are in the ring, and reads them all. Likewise
+// async_write() suspends until there is room for the whole write. Parked
+// coroutines are served in arrival order, by whichever operation on the ring
+// makes room or data for them: that operation does the transfer on their
+// behalf, then posts them to the executor, so nothing is lost or reordered
+// between the wake-up and the resumption.
+//
+// Only operations made through the async_ring wake waiters. There are no
+// locks: an async_ring, its ring and its coroutines all belong to one thread,
+// or to one executor. Coroutines still parked when the async_ring is
+// destroyed are never resumed.
+class async_ring {
+
+public:
+
+	async_ring( ring &r, executor &ex ) : r( r ), ex( ex ), readers(), writers() {
+	}
+
+	async_ring( const async_ring & ) = delete;
+	async_ring &operator=( const async_ring & ) = delete;
+
+	ring &get() { return r; }
+
+	// like ring::read() and ring::write(), then serve any waiters they satisfy
+	int read( void *data, unsigned n ) {
+		int res = r.read( data, n );
+		settle();
+		return res;
+	}
+
+	int write( const void *data, unsigned n ) {
+		int res = r.write( data, n );
+		settle();
+		return res;
+	}
+
+	int skip( unsigned n ) {
+		int res = r.skip( n );
+		settle();
+		return res;
+	}
+
+	void reset() {
+		r.reset();
+		settle();
+	}
+
+	// a parked coroutine, linked into a FIFO of readers or writers
+	struct waiter {
+		void *data;
+		unsigned n;
+		int result;
+		std::coroutine_handle<> h;
+		waiter *next;
+	};
+
+	template< bool Write >
+	class awaitable {
+
+	public:
+
+		awaitable( async_ring &ar, void *data, unsigned n ) : ar( ar ), w{ data, n, 0, nullptr, nullptr } {
+		}
+
+		// complete at once when nobody is queued ahead and the ring allows it.
+		// a transfer that could never fit fails with -1 rather than waiting forever
+		bool await_ready() {
+			bool r = true;
+			if ( w.n > ar.r.capacity() ) {
+				w.result = -1;
+				goto out;
+			}
+			if ( nullptr == ar.queue( Write ).head && ar.ready( Write, w.n ) ) {
+				w.result = ar.transfer( Write, w.data, w.n );
+				ar.settle();
+				goto out;
+			}
+			r = false;
+		out:
+			return r;
+		}
+
+		void await_suspend( std::coroutine_handle<> h ) {
+			w.h = h;
+			ar.queue( Write ).push( & w );
+		}
+
+		// the number of bytes transferred, which is always n, or -1
+		int await_resume() const {
+			return w.result;
+		}
+
+	private:
+
+		async_ring &ar;
+		waiter w;
+	};
+
+	typedef awaitable< false > read_awaitable;
+	typedef awaitable< true > write_awaitable;
+
+private:
+
+	struct fifo {
+		waiter *head;
+		waiter *tail;
+
+		void push( waiter *w ) {
+			w->next = nullptr;
+			if ( nullptr == head ) {
+				head = w;
+			} else {
+				tail->next = w;
+			}
+			tail = w;
+		}
+
+		waiter *pop() {
+			waiter *w = head;
+			head = w->next;
+			return w;
+		}
+	};
+
+	fifo &queue( bool write ) { return write ? writers : readers; }
+
+	bool ready( bool write, unsigned n ) const {
+		return write ? r.available() >= n : r.size() >= n;
+	}
+
+	int transfer( bool write, void *data, unsigned n ) {
+		return write ? r.write( data, n ) : r.read( data, n );
+	}
+
+	// serve waiters in order until neither queue can make progress. each
+	// transfer may unblock the other queue, hence the outer loop
+	void settle() {
+		bool progress;
+		waiter *w;
+		do {
+			progress = false;
+			for( bool write: { false, true } ) {
+				while( nullptr != queue( write ).head && ready( write, queue( write ).head->n ) ) {
+					w = queue( write ).pop();
+					w->result = transfer( write, w->data, w->n );
+					ex.post( w->h );
+					progress = true;
+				}
+			}
+		} while( progress );
+	}
+
+	ring &r;
+	executor &ex;
+	fifo readers;
+	fifo writers;
+};
+
+// suspend until n bytes can be read from ar, then read them
+inline async_ring::read_awaitable async_read( async_ring &ar, void *data, unsigned n ) {
+	return async_ring::read_awaitable( ar, data, n );
+}
+
+// suspend until n bytes can be written to ar, then write them
+inline async_ring::write_awaitable async_write( async_ring &ar, const void *data, unsigned n ) {
+	return async_ring::write_awaitable( ar, const_cast< void * >( data ), n );
+}
+
+} // namespace ringbuffer
+
+#endif /* RING_BUFFER_ASYNC_HPP_ */
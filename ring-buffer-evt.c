@@ -0,0 +1,61 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "ring-buffer-evt.h"
+
+static inline ring_buffer_evt_t *evt( ring_buffer_t *rb ) {
+	return RING_BUFFER_CONTAINER( rb, ring_buffer_evt_t, rb );
+}
+
+static inline void evtsignal( int fd ) {
+	if ( -1 != fd ) {
+		eventfd_write( fd, 1 );
+	}
+}
+
+// compare the length before and after an operation and signal any edge crossed
+static void evtedges( ring_buffer_t *rb, unsigned op, unsigned data_len, unsigned before, int result ) {
+	ring_buffer_evt_t *e = evt( rb );
+	unsigned after = e->rb.len;
+	if ( 0 == before && after > 0 ) {
+		evtsignal( e->data_fd );
+	}
+	if ( before > e->space_mark && after <= e->space_mark ) {
+		evtsignal( e->space_fd );
+	}
+}
+
+int ring_buffer_evt_fd( void ) {
+	return eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+}
+
+uint64_t ring_buffer_evt_ack( int fd ) {
+	eventfd_t r;
+	if ( -1 == fd || 0 != eventfd_read( fd, & r ) ) {
+		r = 0;
+	}
+	return r;
+}
+
+int ring_buffer_evt_init( ring_buffer_evt_t *e, unsigned capacity, void *buffer, int data_fd, int space_fd, unsigned space_mark ) {
+	int r;
+
+	if ( NULL == e ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_wrap_init( (ring_buffer_wrap_t *) e, capacity, buffer, RING_BUFFER_OPS_LEN, NULL, evtedges );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	e->data_fd = data_fd;
+	e->space_fd = space_fd;
+	e->space_mark = 0 == space_mark && capacity > 0 ? capacity - 1 : space_mark;
+
+out:
+	return r;
+}
@@ -0,0 +1,37 @@
+#ifndef RING_BUFFER_EVT_H_
+#define RING_BUFFER_EVT_H_
+
+#include <stdint.h>
+
+#include "ring-buffer-wrap.h"
+
+// A ring that signals eventfds on readiness edges, so that a worker can sleep
+// on the ring together with its sockets in epoll. An fd is only written when
+// the ring goes from empty to non-empty (data_fd), or when its length drops
+// from above space_mark to space_mark or below (space_fd); operations that do
+// not cross an edge cost no system call. Several rings may share an fd.
+// The operations that change the length (write, read, send, skip, commit and
+// reset) are watched, and so are the free functions, which end with skip() or
+// commit().
+//
+// To avoid lost wake-ups, a waiter must ring_buffer_evt_ack() the fd before
+// draining (or filling) the ring, and only sleep again once it has seen the
+// ring empty (or full).
+
+typedef struct {
+	RING_BUFFER_WRAP_FIELDS
+	// -1 disables either signal
+	int              data_fd;
+	int              space_fd;
+	unsigned         space_mark;
+} ring_buffer_evt_t;
+
+// a non-blocking eventfd suitable for data_fd or space_fd
+int ring_buffer_evt_fd( void );
+// consume any pending signal on fd; returns the number of edges signalled since the last ack
+uint64_t ring_buffer_evt_ack( int fd );
+
+// space_mark 0 selects capacity - 1, i.e. signal whenever a full ring gains space
+int ring_buffer_evt_init( ring_buffer_evt_t *e, unsigned capacity, void *buffer, int data_fd, int space_fd, unsigned space_mark );
+
+#endif /* RING_BUFFER_EVT_H_ */
@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ring-buffer-mc.h"
+
+#include "minmax.h"
+
+enum {
+	MC_READER_FREE,
+	// claimed, but not yet holding back the producer
+	MC_READER_JOINING,
+	MC_READER_ACTIVE,
+};
+
+static inline int mcvalid( ring_buffer_mc_t *mc, int reader ) {
+	return
+		NULL != mc
+		&& reader >= 0
+		&& reader < RING_BUFFER_MC_MAX_READERS
+		&& MC_READER_ACTIVE == __atomic_load_n( & mc->readers[ reader ].state, __ATOMIC_RELAXED );
+}
+
+// the slowest active cursor, or the tail when there are no readers
+static uint64_t mcgate( ring_buffer_mc_t *mc, uint64_t tail ) {
+	uint64_t r;
+	uint64_t cursor;
+	int i;
+
+	// order the producer's last tail store before the loads of reader states,
+	// pairing with the joiner's store of its state before its load of the tail
+	__atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+	r = tail;
+	for( i = 0; i < RING_BUFFER_MC_MAX_READERS; i++ ) {
+		if ( MC_READER_ACTIVE == __atomic_load_n( & mc->readers[ i ].state, __ATOMIC_SEQ_CST ) ) {
+			cursor = __atomic_load_n( & mc->readers[ i ].cursor, __ATOMIC_ACQUIRE );
+			r = min( r, cursor );
+		}
+	}
+
+	return r;
+}
+
+// the room left before the producer would overrun the gate. a reader caught
+// between the two cursor stores in join() may briefly expose a cursor more
+// than capacity behind the tail; that leaves no room, rather than wrapping
+static inline unsigned mcroom( ring_buffer_mc_t *mc, uint64_t tail ) {
+	return tail - mc->gate >= mc->capacity ? 0 : mc->capacity - (unsigned)( tail - mc->gate );
+}
+
+int ring_buffer_mc_init( ring_buffer_mc_t *mc, unsigned capacity, void *buffer ) {
+	int r;
+
+	if ( NULL == mc || NULL == buffer ) {
+		r = -1;
+		goto out;
+	}
+
+	memset( mc, 0, sizeof( *mc ) );
+	mc->capacity = capacity;
+	mc->buffer = buffer;
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_mc_join( ring_buffer_mc_t *mc ) {
+	int r;
+	uint32_t expected;
+
+	if ( NULL == mc ) {
+		r = -1;
+		goto out;
+	}
+
+	for( r = 0; r < RING_BUFFER_MC_MAX_READERS; r++ ) {
+		expected = MC_READER_FREE;
+		if ( __atomic_compare_exchange_n( & mc->readers[ r ].state, & expected, MC_READER_JOINING, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ) ) {
+			break;
+		}
+	}
+	if ( RING_BUFFER_MC_MAX_READERS == r ) {
+		r = -1;
+		goto out;
+	}
+
+	// a producer that sees us before the second store below treats this
+	// (older, hence smaller) position as our cursor, which is conservative,
+	// and if it is more than capacity behind, mcroom() holds the producer
+	// until the second store lands. one that scanned before we became active
+	// only writes past a gate that is no later than the tail we then load, so
+	// nothing we read is overrun
+	__atomic_store_n( & mc->readers[ r ].cursor, __atomic_load_n( & mc->tail, __ATOMIC_SEQ_CST ), __ATOMIC_SEQ_CST );
+	__atomic_store_n( & mc->readers[ r ].state, MC_READER_ACTIVE, __ATOMIC_SEQ_CST );
+	__atomic_store_n( & mc->readers[ r ].cursor, __atomic_load_n( & mc->tail, __ATOMIC_SEQ_CST ), __ATOMIC_RELEASE );
+
+out:
+	return r;
+}
+
+void ring_buffer_mc_leave( ring_buffer_mc_t *mc, int reader ) {
+	if ( ! mcvalid( mc, reader ) ) {
+		goto out;
+	}
+	__atomic_store_n( & mc->readers[ reader ].state, MC_READER_FREE, __ATOMIC_RELEASE );
+out:
+	return;
+}
+
+int ring_buffer_mc_write( ring_buffer_mc_t *mc, const void *data, unsigned data_len ) {
+	int r;
+	uint64_t tail;
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == mc || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	tail = mc->tail;
+
+	// only rescan the readers when the cached gate is not enough
+	r = mcroom( mc, tail );
+	if ( (unsigned) r < data_len ) {
+		mc->gate = mcgate( mc, tail );
+		r = mcroom( mc, tail );
+	}
+	r = min( (unsigned) r, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = tail % mc->capacity;
+	t1 = min( (unsigned) r, mc->capacity - pos );
+	memcpy( & ( (uint8_t *)mc->buffer )[ pos ], data, t1 );
+	memcpy( & ( (uint8_t *)mc->buffer )[ 0 ], & ( (const uint8_t *) data )[ t1 ], r - t1 );
+
+	__atomic_store_n( & mc->tail, tail + r, __ATOMIC_RELEASE );
+
+out:
+	return r;
+}
+
+unsigned ring_buffer_mc_available( ring_buffer_mc_t *mc ) {
+	unsigned r;
+	uint64_t tail;
+
+	if ( NULL == mc ) {
+		r = 0;
+		goto out;
+	}
+
+	tail = mc->tail;
+	mc->gate = mcgate( mc, tail );
+	r = mcroom( mc, tail );
+
+out:
+	return r;
+}
+
+int ring_buffer_mc_peek( ring_buffer_mc_t *mc, int reader, void *data, unsigned data_len ) {
+	int r;
+	uint64_t cursor;
+	unsigned pos;
+	unsigned t1;
+
+	if ( ! mcvalid( mc, reader ) || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	cursor = mc->readers[ reader ].cursor;
+	r = (unsigned)( __atomic_load_n( & mc->tail, __ATOMIC_ACQUIRE ) - cursor );
+	r = min( (unsigned) r, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = cursor % mc->capacity;
+	t1 = min( (unsigned) r, mc->capacity - pos );
+	memcpy( data, & ( (uint8_t *)mc->buffer )[ pos ], t1 );
+	memcpy( & ( (uint8_t *) data )[ t1 ], & ( (uint8_t *)mc->buffer )[ 0 ], r - t1 );
+
+out:
+	return r;
+}
+
+int ring_buffer_mc_read( ring_buffer_mc_t *mc, int reader, void *data, unsigned data_len ) {
+	int r;
+	r = ring_buffer_mc_peek( mc, reader, data, data_len );
+	if ( r > 0 ) {
+		ring_buffer_mc_skip( mc, reader, r );
+	}
+	return r;
+}
+
+int ring_buffer_mc_skip( ring_buffer_mc_t *mc, int reader, unsigned data_len ) {
+	int r;
+	uint64_t cursor;
+
+	if ( ! mcvalid( mc, reader ) ) {
+		r = -1;
+		goto out;
+	}
+
+	cursor = mc->readers[ reader ].cursor;
+	r = (unsigned)( __atomic_load_n( & mc->tail, __ATOMIC_ACQUIRE ) - cursor );
+	r = min( (unsigned) r, data_len );
+	if ( r > 0 ) {
+		// releases the bytes back to the producer
+		__atomic_store_n( & mc->readers[ reader ].cursor, cursor + r, __ATOMIC_RELEASE );
+	}
+
+out:
+	return r;
+}
+
+unsigned ring_buffer_mc_size( ring_buffer_mc_t *mc, int reader ) {
+	unsigned r;
+
+	if ( ! mcvalid( mc, reader ) ) {
+		r = 0;
+		goto out;
+	}
+
+	r = __atomic_load_n( & mc->tail, __ATOMIC_ACQUIRE ) - mc->readers[ reader ].cursor;
+
+out:
+	return r;
+}
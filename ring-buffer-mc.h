@@ -0,0 +1,53 @@
+#ifndef RING_BUFFER_MC_H_
+#define RING_BUFFER_MC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+
+// A multicast byte ring: one producer, and up to RING_BUFFER_MC_MAX_READERS
+// readers that each consume the whole stream through their own cursor, in
+// the style of the LMAX Disruptor. The producer is only held back by the
+// slowest reader. Reading is wait-free, and readers may join and leave while
+// the producer is running.
+
+#define RING_BUFFER_MC_MAX_READERS 16
+#define RING_BUFFER_MC_CACHELINE 64
+
+typedef struct {
+	// the stream position of the next byte this reader will consume
+	uint64_t         cursor;
+	uint32_t         state;
+} __attribute__(( aligned( RING_BUFFER_MC_CACHELINE ) )) ring_buffer_mc_reader_t;
+
+struct _ring_buffer_mc;
+typedef struct _ring_buffer_mc ring_buffer_mc_t;
+
+struct _ring_buffer_mc {
+	unsigned         capacity;
+	void            *buffer;
+	// the stream position of the next byte the producer will write
+	uint64_t         tail __attribute__(( aligned( RING_BUFFER_MC_CACHELINE ) ));
+	// the slowest cursor, as of the producer's last scan
+	uint64_t         gate;
+	ring_buffer_mc_reader_t readers[ RING_BUFFER_MC_MAX_READERS ];
+};
+
+int ring_buffer_mc_init( ring_buffer_mc_t *mc, unsigned capacity, void *buffer );
+
+// register a reader, positioned at the current end of the stream. returns its id, or -1 when none are free
+int ring_buffer_mc_join( ring_buffer_mc_t *mc );
+void ring_buffer_mc_leave( ring_buffer_mc_t *mc, int reader );
+
+// producer side: append to the stream, returning the number of bytes written
+int ring_buffer_mc_write( ring_buffer_mc_t *mc, const void *data, unsigned data_len );
+// the number of bytes the producer can write without overrunning any reader
+unsigned ring_buffer_mc_available( ring_buffer_mc_t *mc );
+
+// reader side; each reader must only be used by one thread at a time
+int ring_buffer_mc_peek( ring_buffer_mc_t *mc, int reader, void *data, unsigned data_len );
+int ring_buffer_mc_read( ring_buffer_mc_t *mc, int reader, void *data, unsigned data_len );
+int ring_buffer_mc_skip( ring_buffer_mc_t *mc, int reader, unsigned data_len );
+unsigned ring_buffer_mc_size( ring_buffer_mc_t *mc, int reader );
+
+#endif /* RING_BUFFER_MC_H_ */
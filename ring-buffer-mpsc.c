@@ -0,0 +1,162 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ring-buffer-mpsc.h"
+
+#include "minmax.h"
+
+// set in a marker once its producer has finished with the chunk
+#define MPSC_SEALED 0x80000000u
+
+static inline uint8_t *mpscchunk( ring_buffer_mpsc_t *mpsc, uint64_t chunk ) {
+	return & ( (uint8_t *) mpsc->buffer )[ ( chunk % mpsc->nchunks ) * mpsc->chunk ];
+}
+
+// the marker holds the number of bytes published in the chunk, and MPSC_SEALED
+static inline uint32_t *mpscmarker( ring_buffer_mpsc_t *mpsc, uint64_t chunk ) {
+	return (uint32_t *) mpscchunk( mpsc, chunk );
+}
+
+static int mpscclaim( ring_buffer_mpsc_producer_t *p ) {
+	int r;
+	ring_buffer_mpsc_t *mpsc = p->mpsc;
+	uint64_t chunk;
+
+	chunk = __atomic_load_n( & mpsc->claim, __ATOMIC_RELAXED );
+	do {
+		// the consumer clears a chunk's marker before releasing it
+		if ( chunk - __atomic_load_n( & mpsc->head, __ATOMIC_ACQUIRE ) >= mpsc->nchunks ) {
+			r = -1;
+			goto out;
+		}
+	} while( ! __atomic_compare_exchange_n( & mpsc->claim, & chunk, chunk + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) );
+
+	p->chunk = chunk;
+	p->fill = 0;
+	p->active = 1;
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_mpsc_init( ring_buffer_mpsc_t *mpsc, unsigned capacity, void *buffer, unsigned chunk ) {
+	int r;
+	uint64_t i;
+
+	if ( NULL == mpsc || NULL == buffer || chunk <= RING_BUFFER_MPSC_HEADER || chunk >= MPSC_SEALED || 0 != capacity % chunk || 0 == capacity ) {
+		r = -1;
+		goto out;
+	}
+
+	memset( mpsc, 0, sizeof( *mpsc ) );
+	mpsc->capacity = capacity;
+	mpsc->chunk = chunk;
+	mpsc->nchunks = capacity / chunk;
+	mpsc->buffer = buffer;
+	for( i = 0; i < mpsc->nchunks; i++ ) {
+		*mpscmarker( mpsc, i ) = 0;
+	}
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_mpsc_producer_init( ring_buffer_mpsc_producer_t *p, ring_buffer_mpsc_t *mpsc ) {
+	int r;
+
+	if ( NULL == p || NULL == mpsc ) {
+		r = -1;
+		goto out;
+	}
+
+	p->mpsc = mpsc;
+	p->chunk = 0;
+	p->fill = 0;
+	p->active = 0;
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_mpsc_write( ring_buffer_mpsc_producer_t *p, const void *data, unsigned data_len ) {
+	int r;
+
+	if ( NULL == p || NULL == data || data_len > p->mpsc->chunk - RING_BUFFER_MPSC_HEADER ) {
+		r = -1;
+		goto out;
+	}
+
+	if ( p->active && RING_BUFFER_MPSC_HEADER + p->fill + data_len > p->mpsc->chunk ) {
+		ring_buffer_mpsc_flush( p );
+	}
+	if ( ! p->active && EXIT_SUCCESS != mpscclaim( p ) ) {
+		r = 0;
+		goto out;
+	}
+
+	memcpy( & mpscchunk( p->mpsc, p->chunk )[ RING_BUFFER_MPSC_HEADER + p->fill ], data, data_len );
+	p->fill += data_len;
+	r = data_len;
+
+out:
+	return r;
+}
+
+void ring_buffer_mpsc_publish( ring_buffer_mpsc_producer_t *p ) {
+	if ( NULL == p || ! p->active ) {
+		goto out;
+	}
+	__atomic_store_n( mpscmarker( p->mpsc, p->chunk ), p->fill, __ATOMIC_RELEASE );
+out:
+	return;
+}
+
+void ring_buffer_mpsc_flush( ring_buffer_mpsc_producer_t *p ) {
+	if ( NULL == p || ! p->active ) {
+		goto out;
+	}
+	__atomic_store_n( mpscmarker( p->mpsc, p->chunk ), p->fill | MPSC_SEALED, __ATOMIC_RELEASE );
+	p->active = 0;
+out:
+	return;
+}
+
+int ring_buffer_mpsc_read( ring_buffer_mpsc_t *mpsc, void *data, unsigned data_len ) {
+	int r;
+	uint32_t marker;
+	unsigned n;
+
+	if ( NULL == mpsc || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	for( r = 0; (unsigned) r < data_len; ) {
+		// a chunk not yet claimed still has a clear marker, so looks empty
+		marker = __atomic_load_n( mpscmarker( mpsc, mpsc->head ), __ATOMIC_ACQUIRE );
+		n = min( ( marker & ~MPSC_SEALED ) - mpsc->offset, data_len - r );
+		memcpy( & ( (uint8_t *) data )[ r ], & mpscchunk( mpsc, mpsc->head )[ RING_BUFFER_MPSC_HEADER + mpsc->offset ], n );
+		mpsc->offset += n;
+		r += n;
+
+		if ( mpsc->offset != ( marker & ~MPSC_SEALED ) ) {
+			break;
+		}
+		if ( ! ( marker & MPSC_SEALED ) ) {
+			break;
+		}
+		// hand the chunk back
+		*mpscmarker( mpsc, mpsc->head ) = 0;
+		mpsc->offset = 0;
+		__atomic_store_n( & mpsc->head, mpsc->head + 1, __ATOMIC_RELEASE );
+	}
+
+out:
+	return r;
+}
@@ -0,0 +1,61 @@
+#ifndef RING_BUFFER_MPSC_H_
+#define RING_BUFFER_MPSC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A multi-producer / single-consumer byte ring for many threads feeding one.
+// The ring is cut into fixed-size chunks. A producer claims a whole chunk at a
+// time, with one compare-and-swap on a shared counter, then fills it with
+// records using plain stores; records never straddle chunks. Filled bytes are
+// made visible to the consumer in batches, one release store of the chunk's
+// commit marker per ring_buffer_mpsc_publish(), and a chunk is sealed (and a
+// new one claimed) once the next record does not fit. So the shared cache
+// lines are touched once per chunk and once per batch, not once per record.
+//
+// The consumer drains chunks strictly in the order they were claimed, so a
+// producer that goes idle should ring_buffer_mpsc_flush() its chunk, or it
+// will hold back the records claimed after it.
+//
+// Each chunk starts with an 8-byte header holding its marker, so records are
+// at most chunk - RING_BUFFER_MPSC_HEADER bytes long.
+
+#define RING_BUFFER_MPSC_CACHELINE 64
+#define RING_BUFFER_MPSC_HEADER 8
+
+typedef struct {
+	unsigned         capacity;
+	unsigned         chunk;
+	unsigned         nchunks;
+	void            *buffer;
+	// the next chunk number to be claimed
+	uint64_t         claim __attribute__(( aligned( RING_BUFFER_MPSC_CACHELINE ) ));
+	// the chunk number the consumer is draining, and how far
+	uint64_t         head __attribute__(( aligned( RING_BUFFER_MPSC_CACHELINE ) ));
+	unsigned         offset;
+} ring_buffer_mpsc_t;
+
+// per-producer state, owned by one thread
+typedef struct {
+	ring_buffer_mpsc_t *mpsc;
+	uint64_t         chunk;
+	unsigned         fill;
+	int              active;
+} ring_buffer_mpsc_producer_t;
+
+// chunk must divide capacity and exceed RING_BUFFER_MPSC_HEADER, and buffer must be 8-byte aligned
+int ring_buffer_mpsc_init( ring_buffer_mpsc_t *mpsc, unsigned capacity, void *buffer, unsigned chunk );
+int ring_buffer_mpsc_producer_init( ring_buffer_mpsc_producer_t *p, ring_buffer_mpsc_t *mpsc );
+
+// copy one record into the producer's chunk, without publishing it. returns
+// data_len, 0 when no chunk could be claimed because the ring is full, or -1
+int ring_buffer_mpsc_write( ring_buffer_mpsc_producer_t *p, const void *data, unsigned data_len );
+// make everything written so far visible to the consumer
+void ring_buffer_mpsc_publish( ring_buffer_mpsc_producer_t *p );
+// publish, and give up the current chunk so the consumer can move past it
+void ring_buffer_mpsc_flush( ring_buffer_mpsc_producer_t *p );
+
+// consumer side: copy out up to data_len published bytes, in order
+int ring_buffer_mpsc_read( ring_buffer_mpsc_t *mpsc, void *data, unsigned data_len );
+
+#endif /* RING_BUFFER_MPSC_H_ */
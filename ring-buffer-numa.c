@@ -0,0 +1,222 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "ring-buffer-numa.h"
+
+#include "minmax.h"
+
+// from <numaif.h>, which is part of libnuma rather than the C library
+#define NUMA_MPOL_PREFERRED 1
+#define NUMA_MAX_NODES 1024
+
+/*###########################################################################
+  #                            TOPOLOGY
+  ###########################################################################*/
+
+int ring_buffer_numa_nodes( void ) {
+	int r;
+	FILE *f;
+	char list[ 256 ];
+	char *p;
+	long v;
+
+	r = 1;
+	f = fopen( "/sys/devices/system/node/online", "r" );
+	if ( NULL == f ) {
+		goto out;
+	}
+	if ( NULL == fgets( list, sizeof( list ), f ) ) {
+		goto close;
+	}
+
+	// a list of ranges, e.g. "0-1,3": the last number is the highest node
+	for( p = list; '\0' != *p; ) {
+		v = strtol( p, & p, 10 );
+		r = max( r, (int) v + 1 );
+		if ( ',' != *p && '-' != *p ) {
+			break;
+		}
+		p++;
+	}
+	r = min( r, NUMA_MAX_NODES );
+
+close:
+	fclose( f );
+out:
+	return r;
+}
+
+int ring_buffer_numa_node_of_cpu( int cpu ) {
+	int r;
+	int node;
+	int nodes;
+	char path[ 64 ];
+
+	r = 0;
+	nodes = ring_buffer_numa_nodes();
+	for( node = 0; node < nodes; node++ ) {
+		snprintf( path, sizeof( path ), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node );
+		if ( 0 == access( path, F_OK ) ) {
+			r = node;
+			break;
+		}
+	}
+
+	return r;
+}
+
+int ring_buffer_numa_current_node( void ) {
+	unsigned cpu;
+	unsigned node;
+
+	if ( 0 != syscall( SYS_getcpu, & cpu, & node, NULL ) ) {
+		node = 0;
+	}
+	return node;
+}
+
+/*###########################################################################
+  #                            ALLOCATION
+  ###########################################################################*/
+
+void *ring_buffer_numa_alloc( size_t len, int node ) {
+	void *r;
+	unsigned long mask[ NUMA_MAX_NODES / ( 8 * sizeof( unsigned long ) ) ];
+
+	r = NULL;
+	if ( 0 == len || node >= ring_buffer_numa_nodes() || ( node < 0 && RING_BUFFER_NUMA_LOCAL != node ) ) {
+		goto out;
+	}
+
+	r = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( MAP_FAILED == r ) {
+		r = NULL;
+		goto out;
+	}
+
+	if ( RING_BUFFER_NUMA_LOCAL != node ) {
+		memset( mask, 0, sizeof( mask ) );
+		mask[ node / ( 8 * sizeof( unsigned long ) ) ] = 1UL << ( node % ( 8 * sizeof( unsigned long ) ) );
+		// best effort: without it, e.g. in a container that forbids it, the pages are placed on first touch
+		syscall( SYS_mbind, r, len, NUMA_MPOL_PREFERRED, mask, (unsigned long) NUMA_MAX_NODES, 0 );
+	}
+
+	// fault the pages in now, under the policy, rather than on the hot path
+	memset( r, 0, len );
+
+out:
+	return r;
+}
+
+void ring_buffer_numa_free( void *p, size_t len ) {
+	if ( NULL != p ) {
+		munmap( p, len );
+	}
+}
+
+/*###########################################################################
+  #                            SPLIT-INDEX SPSC
+  ###########################################################################*/
+
+int ring_buffer_numa_spsc_init( ring_buffer_numa_spsc_t *s, unsigned capacity, void *buffer, int producer_node, int consumer_node ) {
+	int r;
+
+	if ( NULL == s || NULL == buffer || 0 == capacity ) {
+		r = -1;
+		goto out;
+	}
+
+	s->capacity = capacity;
+	s->buffer = (uint8_t *) buffer;
+	s->tail = (ring_buffer_numa_index_t *) ring_buffer_numa_alloc( sizeof( ring_buffer_numa_index_t ), producer_node );
+	s->head = (ring_buffer_numa_index_t *) ring_buffer_numa_alloc( sizeof( ring_buffer_numa_index_t ), consumer_node );
+	if ( NULL == s->tail || NULL == s->head ) {
+		ring_buffer_numa_spsc_destroy( s );
+		r = -1;
+		goto out;
+	}
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+void ring_buffer_numa_spsc_destroy( ring_buffer_numa_spsc_t *s ) {
+	if ( NULL == s ) {
+		goto out;
+	}
+	ring_buffer_numa_free( s->tail, sizeof( ring_buffer_numa_index_t ) );
+	ring_buffer_numa_free( s->head, sizeof( ring_buffer_numa_index_t ) );
+	s->tail = NULL;
+	s->head = NULL;
+out:
+	return;
+}
+
+int ring_buffer_numa_spsc_write( ring_buffer_numa_spsc_t *s, const void *data, unsigned data_len ) {
+	int r;
+	uint64_t tail;
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == s || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	tail = s->tail->pos;
+	// only look across at the consumer's node when the cached head says the ring is full
+	if ( tail - s->tail->peer + data_len > s->capacity ) {
+		s->tail->peer = __atomic_load_n( & s->head->pos, __ATOMIC_ACQUIRE );
+	}
+	r = min( data_len, s->capacity - (unsigned)( tail - s->tail->peer ) );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = tail % s->capacity;
+	t1 = min( (unsigned) r, s->capacity - pos );
+	memcpy( & s->buffer[ pos ], data, t1 );
+	memcpy( s->buffer, & ( (const uint8_t *) data )[ t1 ], r - t1 );
+	__atomic_store_n( & s->tail->pos, tail + r, __ATOMIC_RELEASE );
+
+out:
+	return r;
+}
+
+int ring_buffer_numa_spsc_read( ring_buffer_numa_spsc_t *s, void *data, unsigned data_len ) {
+	int r;
+	uint64_t head;
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == s || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	head = s->head->pos;
+	// likewise, only look at the producer's node when the cached tail says the ring is empty
+	if ( s->head->peer - head < data_len ) {
+		s->head->peer = __atomic_load_n( & s->tail->pos, __ATOMIC_ACQUIRE );
+	}
+	r = min( data_len, (unsigned)( s->head->peer - head ) );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = head % s->capacity;
+	t1 = min( (unsigned) r, s->capacity - pos );
+	memcpy( data, & s->buffer[ pos ], t1 );
+	memcpy( & ( (uint8_t *) data )[ t1 ], s->buffer, r - t1 );
+	__atomic_store_n( & s->head->pos, head + r, __ATOMIC_RELEASE );
+
+out:
+	return r;
+}
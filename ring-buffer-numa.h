@@ -0,0 +1,62 @@
+#ifndef RING_BUFFER_NUMA_H_
+#define RING_BUFFER_NUMA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+
+// NUMA placement for rings on multi-socket machines, without a dependency on
+// libnuma. Memory is mapped fresh and bound to a node with mbind(2), with the
+// preferred policy, so that the kernel falls back to other nodes rather than
+// failing when the chosen one is full. On a single-node machine, or where
+// mbind is not permitted, the memory is simply local.
+//
+// ring_buffer_numa_spsc_t is a single-producer / single-consumer byte ring
+// whose two indices live apart, each on the node of the thread that writes
+// it, along with that thread's cached copy of the other index. The storage is
+// placed separately, usually on the consumer's node, whose reads would
+// otherwise each pay the cross-socket latency.
+
+#define RING_BUFFER_NUMA_CACHELINE 64
+// passed as a node: do not bind, leaving placement to the first touch
+#define RING_BUFFER_NUMA_LOCAL -1
+
+// the number of nodes, counting from 0 to the highest online; 1 when unknown
+int ring_buffer_numa_nodes( void );
+// the node of cpu, or 0 when unknown
+int ring_buffer_numa_node_of_cpu( int cpu );
+// the node the calling thread is running on, or 0 when unknown
+int ring_buffer_numa_current_node( void );
+
+// len bytes of zeroed, page-aligned memory, preferring node. returns NULL for
+// a node that does not exist, or when the mapping fails
+void *ring_buffer_numa_alloc( size_t len, int node );
+void ring_buffer_numa_free( void *p, size_t len );
+
+typedef struct {
+	// the position of the next byte to be written (or read) by this index's owner
+	uint64_t         pos;
+	// the owner's last sight of the other index
+	uint64_t         peer;
+} __attribute__(( aligned( RING_BUFFER_NUMA_CACHELINE ) )) ring_buffer_numa_index_t;
+
+typedef struct {
+	unsigned         capacity;
+	uint8_t         *buffer;
+	// written by the producer, and placed on its node
+	ring_buffer_numa_index_t *tail;
+	// written by the consumer, and placed on its node
+	ring_buffer_numa_index_t *head;
+} ring_buffer_numa_spsc_t;
+
+// allocates the indices on the given nodes, a page each, since placement is
+// per page. buffer is the caller's, e.g. from ring_buffer_numa_alloc()
+int ring_buffer_numa_spsc_init( ring_buffer_numa_spsc_t *s, unsigned capacity, void *buffer, int producer_node, int consumer_node );
+void ring_buffer_numa_spsc_destroy( ring_buffer_numa_spsc_t *s );
+
+// producer side; returns the number of bytes written
+int ring_buffer_numa_spsc_write( ring_buffer_numa_spsc_t *s, const void *data, unsigned data_len );
+// consumer side; returns the number of bytes read
+int ring_buffer_numa_spsc_read( ring_buffer_numa_spsc_t *s, void *data, unsigned data_len );
+
+#endif /* RING_BUFFER_NUMA_H_ */
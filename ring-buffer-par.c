@@ -0,0 +1,300 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ring-buffer-par.h"
+
+#include "minmax.h"
+
+/*###########################################################################
+  #                            THREAD POOL
+  ###########################################################################*/
+
+// copy bytes [ begin, end ) of the run formed by the regions
+static void parcopy( ring_buffer_par_pool_t *p, size_t begin, size_t end ) {
+	size_t base;
+	size_t a;
+	size_t b;
+	unsigned i;
+
+	for( i = 0, base = 0; i < p->nregions && base < end; base += p->regions[ i ].len, i++ ) {
+		a = max( begin, base );
+		b = min( end, base + p->regions[ i ].len );
+		if ( a < b ) {
+			memcpy( & p->regions[ i ].dst[ a - base ], & p->regions[ i ].src[ a - base ], b - a );
+		}
+	}
+}
+
+// claim and copy chunks until there are none left
+static void parwork( ring_buffer_par_pool_t *p ) {
+	unsigned c;
+
+	while( ( c = __atomic_fetch_add( & p->next, 1, __ATOMIC_RELAXED ) ) < p->nchunks ) {
+		parcopy( p, c * p->chunk, min( p->total, ( c + 1 ) * p->chunk ) );
+	}
+}
+
+// every thread takes part in every copy, and checks back in afterwards, so
+// that none can still be looking at a copy when the next one is set up
+static void *parthread( void *arg ) {
+	ring_buffer_par_pool_t *p = (ring_buffer_par_pool_t *) arg;
+	uint64_t seen;
+
+	// the generation the pool starts at; a copy may have begun before this thread ran
+	seen = 1;
+	pthread_mutex_lock( & p->lock );
+	for( ;; ) {
+		while( 0 != p->generation && seen == p->generation ) {
+			pthread_cond_wait( & p->start, & p->lock );
+		}
+		if ( 0 == p->generation ) {
+			break;
+		}
+		seen = p->generation;
+		pthread_mutex_unlock( & p->lock );
+
+		parwork( p );
+
+		pthread_mutex_lock( & p->lock );
+		if ( ++p->idle == p->nthreads ) {
+			pthread_cond_signal( & p->done );
+		}
+	}
+	pthread_mutex_unlock( & p->lock );
+
+	return NULL;
+}
+
+int ring_buffer_par_pool_init( ring_buffer_par_pool_t *p, unsigned nthreads ) {
+	int r;
+
+	if ( NULL == p || nthreads > RING_BUFFER_PAR_MAX_THREADS ) {
+		r = -1;
+		goto out;
+	}
+
+	memset( p, 0, sizeof( *p ) );
+	pthread_mutex_init( & p->lock, NULL );
+	pthread_mutex_init( & p->busy, NULL );
+	pthread_cond_init( & p->start, NULL );
+	pthread_cond_init( & p->done, NULL );
+	p->generation = 1;
+	p->idle = 0;
+
+	for( p->nthreads = 0; p->nthreads < nthreads; p->nthreads++ ) {
+		if ( 0 != pthread_create( & p->threads[ p->nthreads ], NULL, parthread, p ) ) {
+			ring_buffer_par_pool_destroy( p );
+			r = -1;
+			goto out;
+		}
+	}
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+void ring_buffer_par_pool_destroy( ring_buffer_par_pool_t *p ) {
+	unsigned i;
+
+	if ( NULL == p ) {
+		goto out;
+	}
+
+	pthread_mutex_lock( & p->lock );
+	p->generation = 0;
+	pthread_cond_broadcast( & p->start );
+	pthread_mutex_unlock( & p->lock );
+	for( i = 0; i < p->nthreads; i++ ) {
+		pthread_join( p->threads[ i ], NULL );
+	}
+	p->nthreads = 0;
+
+	pthread_cond_destroy( & p->start );
+	pthread_cond_destroy( & p->done );
+	pthread_mutex_destroy( & p->lock );
+	pthread_mutex_destroy( & p->busy );
+
+out:
+	return;
+}
+
+void ring_buffer_par_copy( ring_buffer_par_pool_t *p, const ring_buffer_par_region_t *regions, unsigned nregions ) {
+	size_t total;
+	unsigned i;
+
+	if ( NULL == p || NULL == regions || nregions > 4 ) {
+		goto out;
+	}
+
+	for( i = 0, total = 0; i < nregions; i++ ) {
+		total += regions[ i ].len;
+	}
+
+	if ( 0 == p->nthreads || total < 2 * RING_BUFFER_PAR_MIN_CHUNK ) {
+		for( i = 0; i < nregions; i++ ) {
+			memcpy( regions[ i ].dst, regions[ i ].src, regions[ i ].len );
+		}
+		goto out;
+	}
+
+	pthread_mutex_lock( & p->busy );
+
+	pthread_mutex_lock( & p->lock );
+	memcpy( p->regions, regions, nregions * sizeof( *regions ) );
+	p->nregions = nregions;
+	p->total = total;
+	// one chunk per thread, unless that would be too small to be worth waking for
+	p->chunk = max( (size_t) RING_BUFFER_PAR_MIN_CHUNK, ( total + p->nthreads ) / ( p->nthreads + 1 ) );
+	p->nchunks = ( total + p->chunk - 1 ) / p->chunk;
+	p->next = 0;
+	p->idle = 0;
+	p->generation++;
+	pthread_cond_broadcast( & p->start );
+	pthread_mutex_unlock( & p->lock );
+
+	parwork( p );
+
+	// once every thread is idle again, every chunk has been copied
+	pthread_mutex_lock( & p->lock );
+	while( p->idle != p->nthreads ) {
+		pthread_cond_wait( & p->done, & p->lock );
+	}
+	pthread_mutex_unlock( & p->lock );
+
+	pthread_mutex_unlock( & p->busy );
+
+out:
+	return;
+}
+
+void ring_buffer_par_memcpy( ring_buffer_par_pool_t *p, void *dst, const void *src, size_t len ) {
+	ring_buffer_par_region_t region;
+
+	region.dst = (uint8_t *) dst;
+	region.src = (const uint8_t *) src;
+	region.len = len;
+	ring_buffer_par_copy( p, & region, 1 );
+}
+
+/*###########################################################################
+  #                            PARALLEL RING
+  ###########################################################################*/
+
+static inline ring_buffer_par_t *par( ring_buffer_t *rb ) {
+	return RING_BUFFER_CONTAINER( rb, ring_buffer_par_t, rb );
+}
+
+// the free space at the tail of rb, as up to 2 destination regions for n bytes
+static unsigned partail( ring_buffer_t *rb, unsigned n, ring_buffer_par_region_t *regions ) {
+	unsigned tail;
+	unsigned t1;
+
+	tail = ( rb->head + rb->len ) % rb->capacity;
+	t1 = min( n, rb->capacity - tail );
+	regions[ 0 ].dst = & ( (uint8_t *) rb->buffer )[ tail ];
+	regions[ 0 ].len = t1;
+	regions[ 1 ].dst = (uint8_t *) rb->buffer;
+	regions[ 1 ].len = n - t1;
+	return 0 == n - t1 ? 1 : 2;
+}
+
+static int ring_buffer_par_write( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	int r;
+	ring_buffer_par_region_t regions[ 2 ];
+	unsigned n;
+
+	if ( data_len < par( rb )->threshold || NULL == data ) {
+		r = par( rb )->write( rb, data, data_len );
+		goto out;
+	}
+
+	r = min( rb->capacity - rb->len, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	n = partail( rb, r, regions );
+	regions[ 0 ].src = (const uint8_t *) data;
+	regions[ 1 ].src = & ( (const uint8_t *) data )[ regions[ 0 ].len ];
+	ring_buffer_par_copy( par( rb )->pool, regions, n );
+
+	// only now that every chunk has landed
+	rb->len += r;
+
+out:
+	return r;
+}
+
+static int ring_buffer_par_send( ring_buffer_t *rb, ring_buffer_t *input, unsigned data_len ) {
+	int r;
+	ring_buffer_par_region_t dst[ 2 ];
+	ring_buffer_par_region_t regions[ 4 ];
+	unsigned nregions;
+	unsigned ndst;
+	unsigned s1;
+	unsigned off;
+	unsigned len;
+	unsigned i;
+
+	if ( data_len < par( rb )->threshold || NULL == input ) {
+		r = par( rb )->send( rb, input, data_len );
+		goto out;
+	}
+
+	r = min( min( rb->capacity - rb->len, input->len ), data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	// split the transfer wherever the input or the output wraps: at most three regions
+	ndst = partail( rb, r, dst );
+	s1 = min( (unsigned) r, input->capacity - input->head );
+	for( i = 0, off = 0, nregions = 0; i < ndst; i++ ) {
+		for( len = 0; len < dst[ i ].len; len += regions[ nregions++ ].len ) {
+			regions[ nregions ].dst = & dst[ i ].dst[ len ];
+			if ( off < s1 ) {
+				regions[ nregions ].src = & ( (const uint8_t *) input->buffer )[ input->head + off ];
+				regions[ nregions ].len = min( dst[ i ].len - len, s1 - off );
+			} else {
+				regions[ nregions ].src = & ( (const uint8_t *) input->buffer )[ off - s1 ];
+				regions[ nregions ].len = dst[ i ].len - len;
+			}
+			off += regions[ nregions ].len;
+		}
+	}
+	ring_buffer_par_copy( par( rb )->pool, regions, nregions );
+
+	rb->len += r;
+	input->skip( input, r );
+
+out:
+	return r;
+}
+
+int ring_buffer_par_init( ring_buffer_par_t *par, unsigned capacity, void *buffer, ring_buffer_par_pool_t *pool, unsigned threshold ) {
+	int r;
+
+	if ( NULL == par || NULL == pool ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_init( & par->rb, capacity, buffer );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	par->pool = pool;
+	par->threshold = 0 == threshold ? RING_BUFFER_PAR_THRESHOLD : threshold;
+
+	par->write = par->rb.write;
+	par->send = par->rb.send;
+	par->rb.write = ring_buffer_par_write;
+	par->rb.send = ring_buffer_par_send;
+
+out:
+	return r;
+}
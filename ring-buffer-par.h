@@ -0,0 +1,73 @@
+#ifndef RING_BUFFER_PAR_H_
+#define RING_BUFFER_PAR_H_
+
+#include <pthread.h>
+
+#include "ring-buffer.h"
+
+// Parallel bulk copies, for moving hundreds of MiB at a time, where one
+// core's memcpy bandwidth is the limit.
+//
+// ring_buffer_par_pool_t is a small pool of copying threads. A copy is split
+// into chunks of at least RING_BUFFER_PAR_MIN_CHUNK bytes, which the pool's
+// threads and the calling thread claim until none are left. The caller
+// returns only once every chunk has been copied.
+//
+// ring_buffer_par_t is a ring whose write() and send() copy through a pool
+// for transfers of at least threshold bytes, and directly otherwise. The
+// ring's indices are updated only after all the chunks have landed, so a
+// reader never sees a partial transfer. A pool serves one copy at a time,
+// and may be shared by several rings.
+
+#define RING_BUFFER_PAR_MAX_THREADS 64
+#define RING_BUFFER_PAR_MIN_CHUNK ( 256 * 1024 )
+// default size at and above which a parallel ring copies through its pool
+#define RING_BUFFER_PAR_THRESHOLD ( 4 << 20 )
+
+typedef struct {
+	uint8_t         *dst;
+	const uint8_t   *src;
+	size_t           len;
+} ring_buffer_par_region_t;
+
+typedef struct {
+	unsigned         nthreads;
+	pthread_t        threads[ RING_BUFFER_PAR_MAX_THREADS ];
+	pthread_mutex_t  lock;
+	pthread_cond_t   start;
+	pthread_cond_t   done;
+	// serialises callers
+	pthread_mutex_t  busy;
+	// bumped for each copy, and set to 0 to stop the threads
+	uint64_t         generation;
+	// the copy in progress: up to 4 regions, treated as one run of total bytes
+	ring_buffer_par_region_t regions[ 4 ];
+	unsigned         nregions;
+	size_t           total;
+	size_t           chunk;
+	unsigned         nchunks;
+	unsigned         next;
+	// threads done with the copy in progress
+	unsigned         idle;
+} ring_buffer_par_pool_t;
+
+// nthreads helpers, besides the calling thread; 0 makes every copy a plain memcpy
+int ring_buffer_par_pool_init( ring_buffer_par_pool_t *p, unsigned nthreads );
+void ring_buffer_par_pool_destroy( ring_buffer_par_pool_t *p );
+// copy nregions (at most 4) regions, in parallel
+void ring_buffer_par_copy( ring_buffer_par_pool_t *p, const ring_buffer_par_region_t *regions, unsigned nregions );
+void ring_buffer_par_memcpy( ring_buffer_par_pool_t *p, void *dst, const void *src, size_t len );
+
+typedef struct {
+	ring_buffer_t    rb;
+	ring_buffer_par_pool_t *pool;
+	unsigned         threshold;
+	// the operations being wrapped
+	int            (*write)( ring_buffer_t *rb, void *data, unsigned data_len );
+	int            (*send)( ring_buffer_t *rb, ring_buffer_t *input, unsigned data_len );
+} ring_buffer_par_t;
+
+// threshold 0 selects RING_BUFFER_PAR_THRESHOLD
+int ring_buffer_par_init( ring_buffer_par_t *par, unsigned capacity, void *buffer, ring_buffer_par_pool_t *pool, unsigned threshold );
+
+#endif /* RING_BUFFER_PAR_H_ */
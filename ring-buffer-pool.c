@@ -0,0 +1,201 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ring-buffer-pool.h"
+
+static inline unsigned poolstride( unsigned size ) {
+	return ( size + RING_BUFFER_POOL_ALIGN - 1 ) & ~( RING_BUFFER_POOL_ALIGN - 1 );
+}
+
+// the slot index of obj, or -1 when it is not the start of a slot
+static inline int64_t poolslot( uint8_t *objects, unsigned stride, unsigned nobjects, void *obj ) {
+	uintptr_t off;
+	int64_t r;
+
+	r = -1;
+	if ( (uint8_t *) obj < objects ) {
+		goto out;
+	}
+	off = (uint8_t *) obj - objects;
+	if ( 0 != off % stride || off / stride >= nobjects ) {
+		goto out;
+	}
+	r = off / stride;
+
+out:
+	return r;
+}
+
+size_t ring_buffer_pool_footprint( unsigned size, unsigned nobjects ) {
+	return (size_t) poolstride( size ) * nobjects + (size_t) nobjects * sizeof( uint32_t );
+}
+
+/*###########################################################################
+  #                            LOCKED
+  ###########################################################################*/
+
+int ring_buffer_pool_init( ring_buffer_pool_t *p, unsigned size, unsigned nobjects, void *slab ) {
+	int r;
+	uint32_t i;
+
+	if ( NULL == p || NULL == slab || 0 == size || 0 == nobjects || 0 != (uintptr_t) slab % RING_BUFFER_POOL_ALIGN ) {
+		r = -1;
+		goto out;
+	}
+
+	p->stride = poolstride( size );
+	p->nobjects = nobjects;
+	p->objects = (uint8_t *) slab;
+	r = ring_buffer_init( & p->rb, nobjects * sizeof( uint32_t ), & p->objects[ (size_t) p->stride * nobjects ] );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	for( i = 0; i < nobjects; i++ ) {
+		p->rb.write( & p->rb, & i, sizeof( i ) );
+	}
+
+out:
+	return r;
+}
+
+void *ring_buffer_pool_alloc( ring_buffer_pool_t *p ) {
+	void *r;
+	uint32_t i;
+
+	r = NULL;
+	if ( NULL == p ) {
+		goto out;
+	}
+
+	if ( sizeof( i ) != p->rb.read( & p->rb, & i, sizeof( i ) ) ) {
+		goto out;
+	}
+	r = & p->objects[ (size_t) i * p->stride ];
+
+out:
+	return r;
+}
+
+int ring_buffer_pool_free( ring_buffer_pool_t *p, void *obj ) {
+	int r;
+	int64_t slot;
+	uint32_t i;
+
+	if ( NULL == p ) {
+		r = -1;
+		goto out;
+	}
+
+	slot = poolslot( p->objects, p->stride, p->nobjects, obj );
+	if ( -1 == slot ) {
+		r = -1;
+		goto out;
+	}
+
+	i = slot;
+	r = sizeof( i ) == p->rb.write( & p->rb, & i, sizeof( i ) ) ? EXIT_SUCCESS : -1;
+
+out:
+	return r;
+}
+
+unsigned ring_buffer_pool_available( ring_buffer_pool_t *p ) {
+	return NULL == p ? 0 : p->rb.size( & p->rb ) / sizeof( uint32_t );
+}
+
+/*###########################################################################
+  #                            SPSC
+  ###########################################################################*/
+
+int ring_buffer_pool_spsc_init( ring_buffer_pool_spsc_t *p, unsigned size, unsigned nobjects, void *slab ) {
+	int r;
+	uint32_t i;
+
+	if ( NULL == p || NULL == slab || 0 == size || 0 == nobjects || 0 != (uintptr_t) slab % RING_BUFFER_POOL_ALIGN ) {
+		r = -1;
+		goto out;
+	}
+
+	p->stride = poolstride( size );
+	p->nobjects = nobjects;
+	p->objects = (uint8_t *) slab;
+	p->slots = (uint32_t *) & p->objects[ (size_t) p->stride * nobjects ];
+	for( i = 0; i < nobjects; i++ ) {
+		p->slots[ i ] = i;
+	}
+	p->head = 0;
+	p->tail = nobjects;
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+void *ring_buffer_pool_spsc_alloc( ring_buffer_pool_spsc_t *p ) {
+	void *r;
+	uint64_t head;
+	uint32_t i;
+
+	r = NULL;
+	if ( NULL == p ) {
+		goto out;
+	}
+
+	head = p->head;
+	// pairs with the release in free, so that the index, and the object's last use, are visible
+	if ( head == __atomic_load_n( & p->tail, __ATOMIC_ACQUIRE ) ) {
+		goto out;
+	}
+	i = p->slots[ head % p->nobjects ];
+	// the index has been read, so the freeing thread may reuse its entry
+	__atomic_store_n( & p->head, head + 1, __ATOMIC_RELEASE );
+	r = & p->objects[ (size_t) i * p->stride ];
+
+out:
+	return r;
+}
+
+int ring_buffer_pool_spsc_free( ring_buffer_pool_spsc_t *p, void *obj ) {
+	int r;
+	int64_t slot;
+	uint64_t tail;
+
+	if ( NULL == p ) {
+		r = -1;
+		goto out;
+	}
+
+	slot = poolslot( p->objects, p->stride, p->nobjects, obj );
+	tail = p->tail;
+	if ( -1 == slot || tail - __atomic_load_n( & p->head, __ATOMIC_ACQUIRE ) >= p->nobjects ) {
+		r = -1;
+		goto out;
+	}
+
+	p->slots[ tail % p->nobjects ] = slot;
+	__atomic_store_n( & p->tail, tail + 1, __ATOMIC_RELEASE );
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+unsigned ring_buffer_pool_spsc_available( ring_buffer_pool_spsc_t *p ) {
+	unsigned r;
+	uint64_t head;
+	uint64_t tail;
+
+	r = 0;
+	if ( NULL == p ) {
+		goto out;
+	}
+
+	head = __atomic_load_n( & p->head, __ATOMIC_ACQUIRE );
+	tail = __atomic_load_n( & p->tail, __ATOMIC_ACQUIRE );
+	r = tail - head;
+
+out:
+	return r;
+}
@@ -0,0 +1,63 @@
+#ifndef RING_BUFFER_POOL_H_
+#define RING_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "ring-buffer.h"
+
+// A pool of fixed-size objects, for recycling messages without malloc. The
+// free list is a ring of 32-bit slot indices: allocating reads one index from
+// the ring and releasing writes it back, both O(1).
+//
+// Objects and the index ring share one slab, which must be
+// ring_buffer_pool_footprint( size, nobjects ) bytes, aligned to
+// RING_BUFFER_POOL_ALIGN. Each object is at the start of a slot of size
+// bytes, rounded up to RING_BUFFER_POOL_ALIGN.
+//
+// ring_buffer_pool_t keeps its free list in a ring_buffer_t, and like one
+// needs a lock when shared. ring_buffer_pool_spsc_t needs none when exactly
+// one thread allocates and exactly one thread frees.
+
+#define RING_BUFFER_POOL_ALIGN 16
+#define RING_BUFFER_POOL_CACHELINE 64
+
+typedef struct {
+	// of free slot indices
+	ring_buffer_t    rb;
+	unsigned         stride;
+	unsigned         nobjects;
+	uint8_t         *objects;
+} ring_buffer_pool_t;
+
+typedef struct {
+	unsigned         stride;
+	unsigned         nobjects;
+	uint8_t         *objects;
+	uint32_t        *slots;
+	// the number of slots ever allocated; written only by the allocating thread
+	uint64_t         head __attribute__(( aligned( RING_BUFFER_POOL_CACHELINE ) ));
+	// the number of slots ever freed, plus nobjects; written only by the freeing thread
+	uint64_t         tail __attribute__(( aligned( RING_BUFFER_POOL_CACHELINE ) ));
+} ring_buffer_pool_spsc_t;
+
+size_t ring_buffer_pool_footprint( unsigned size, unsigned nobjects );
+
+int ring_buffer_pool_init( ring_buffer_pool_t *p, unsigned size, unsigned nobjects, void *slab );
+// returns NULL when every object is in use
+void *ring_buffer_pool_alloc( ring_buffer_pool_t *p );
+// returns -1 for an object that is not from the pool, or when all objects are already free
+int ring_buffer_pool_free( ring_buffer_pool_t *p, void *obj );
+// the number of free objects
+unsigned ring_buffer_pool_available( ring_buffer_pool_t *p );
+
+int ring_buffer_pool_spsc_init( ring_buffer_pool_spsc_t *p, unsigned size, unsigned nobjects, void *slab );
+// allocating thread only
+void *ring_buffer_pool_spsc_alloc( ring_buffer_pool_spsc_t *p );
+// freeing thread only
+int ring_buffer_pool_spsc_free( ring_buffer_pool_spsc_t *p, void *obj );
+// a snapshot, exact only when the pool is quiescent
+unsigned ring_buffer_pool_spsc_available( ring_buffer_pool_spsc_t *p );
+
+#endif /* RING_BUFFER_POOL_H_ */
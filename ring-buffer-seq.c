@@ -0,0 +1,88 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring-buffer-seq.h"
+
+#include "minmax.h"
+
+static inline ring_buffer_seq_t *seq( ring_buffer_t *rb ) {
+	return RING_BUFFER_CONTAINER( rb, ring_buffer_seq_t, rb );
+}
+
+// the counter is only ever written by the thread that owns the ring
+static void seqbegin( ring_buffer_t *rb, unsigned op ) {
+	ring_buffer_seq_t *s = seq( rb );
+	__atomic_store_n( & s->seq, s->seq + 1, __ATOMIC_RELAXED );
+	// the odd count is visible before any change to the ring
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+static void seqend( ring_buffer_t *rb, unsigned op, unsigned data_len, unsigned before, int result ) {
+	ring_buffer_seq_t *s = seq( rb );
+	__atomic_store_n( & s->seq, s->seq + 1, __ATOMIC_RELEASE );
+}
+
+int ring_buffer_seq_init( ring_buffer_seq_t *s, unsigned capacity, void *buffer ) {
+	int r;
+
+	if ( NULL == s ) {
+		r = -1;
+		goto out;
+	}
+
+	// everything but peek() may change the ring
+	r = ring_buffer_wrap_init( (ring_buffer_wrap_t *) s, capacity, buffer, RING_BUFFER_OPS_LEN | RING_BUFFER_OP( RING_BUFFER_OP_REALIGN ), seqbegin, seqend );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	s->seq = 0;
+
+out:
+	return r;
+}
+
+int ring_buffer_seq_snapshot( ring_buffer_seq_t *s, void *data, unsigned data_len, unsigned tries ) {
+	int r;
+	unsigned i;
+	unsigned s0;
+	unsigned head;
+	unsigned len;
+	unsigned t1;
+
+	if ( NULL == s || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	for( i = 0; 0 == tries || i < tries; i++ ) {
+		s0 = __atomic_load_n( & s->seq, __ATOMIC_ACQUIRE );
+		if ( s0 & 1 ) {
+			continue;
+		}
+
+		head = __atomic_load_n( & s->rb.head, __ATOMIC_RELAXED );
+		len = __atomic_load_n( & s->rb.len, __ATOMIC_RELAXED );
+		// torn indices may be nonsense; never let them take the copy out of bounds
+		if ( head >= s->rb.capacity || len > s->rb.capacity ) {
+			continue;
+		}
+
+		r = min( len, data_len );
+		t1 = min( (unsigned) r, s->rb.capacity - head );
+		memcpy( data, & ( (uint8_t *) s->rb.buffer )[ head ], t1 );
+		memcpy( & ( (uint8_t *) data )[ t1 ], s->rb.buffer, r - t1 );
+
+		// no load above may be satisfied after the counter is read again
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+		if ( s0 == __atomic_load_n( & s->seq, __ATOMIC_RELAXED ) ) {
+			goto out;
+		}
+	}
+
+	r = -EAGAIN;
+
+out:
+	return r;
+}
@@ -0,0 +1,35 @@
+#ifndef RING_BUFFER_SEQ_H_
+#define RING_BUFFER_SEQ_H_
+
+#include <errno.h>
+
+#include "ring-buffer-wrap.h"
+
+// A ring that observer threads can copy without taking the lock that its
+// producer and consumer share. Each wrapped operation makes a sequence counter
+// odd before it touches the ring and even again afterwards, which costs the
+// writer two stores and no waiting. ring_buffer_seq_snapshot() copies the live
+// bytes and retries whenever the counter was odd or moved during the copy, so
+// the copy it returns is always one the ring really held. Any number of
+// observers may snapshot concurrently.
+//
+// The operations that change the ring (write, read, send, skip, commit, reset
+// and realign) bump the counter, once per outermost call even when one
+// operation calls another, and also when the ring is the input of another
+// ring's send(), which consumes it with skip(). The free functions end with
+// skip() or commit(), which bump it in turn, but they move their data before
+// that, outside the odd window, so a snapshot taken meanwhile sees the bytes
+// only once they are live.
+
+typedef struct {
+	RING_BUFFER_WRAP_FIELDS
+	unsigned         seq;
+} ring_buffer_seq_t;
+
+int ring_buffer_seq_init( ring_buffer_seq_t *s, unsigned capacity, void *buffer );
+
+// copy up to data_len live bytes, from the head, as of a single instant.
+// returns the number of bytes copied, or -EAGAIN after tries torn attempts (0 for no limit)
+int ring_buffer_seq_snapshot( ring_buffer_seq_t *s, void *data, unsigned data_len, unsigned tries );
+
+#endif /* RING_BUFFER_SEQ_H_ */
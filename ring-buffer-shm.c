@@ -0,0 +1,441 @@
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "ring-buffer-shm.h"
+
+#include "minmax.h"
+
+enum {
+	SHM_SIDE_NONE,
+	SHM_SIDE_ATTACHED,
+	SHM_SIDE_GONE,
+};
+
+// how often a sleeping side wakes up to check whether its peer is still alive
+#define SHM_LIVENESS_POLL_MS 10
+
+static inline uint8_t *shmdata( ring_buffer_shm_t *rb ) {
+	return (uint8_t *) rb + rb->data_offset;
+}
+
+static inline unsigned shmsize( ring_buffer_shm_t *rb ) {
+	return __atomic_load_n( & rb->tail, __ATOMIC_SEQ_CST ) - __atomic_load_n( & rb->head, __ATOMIC_SEQ_CST );
+}
+
+static int shmfutex( uint32_t *addr, int op, uint32_t val, const struct timespec *ts ) {
+	return syscall( SYS_futex, addr, op, val, ts, NULL, 0 );
+}
+
+static void shmring( uint32_t *seq, uint32_t *waiting ) {
+	if ( __atomic_load_n( waiting, __ATOMIC_SEQ_CST ) ) {
+		__atomic_fetch_add( seq, 1, __ATOMIC_SEQ_CST );
+		shmfutex( seq, FUTEX_WAKE, INT32_MAX, NULL );
+	}
+}
+
+static int shm_init_lock( pthread_mutex_t *lock ) {
+	int r;
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init( & attr );
+	pthread_mutexattr_setpshared( & attr, PTHREAD_PROCESS_SHARED );
+	pthread_mutexattr_setrobust( & attr, PTHREAD_MUTEX_ROBUST );
+	pthread_mutexattr_settype( & attr, PTHREAD_MUTEX_ERRORCHECK );
+	r = pthread_mutex_init( lock, & attr );
+	pthread_mutexattr_destroy( & attr );
+
+	return 0 == r ? EXIT_SUCCESS : -1;
+}
+
+size_t ring_buffer_shm_footprint( unsigned capacity ) {
+	size_t hdr;
+	hdr = ( sizeof( ring_buffer_shm_t ) + RING_BUFFER_SHM_CACHELINE - 1 ) & ~( (size_t) RING_BUFFER_SHM_CACHELINE - 1 );
+	return hdr + capacity;
+}
+
+int ring_buffer_shm_init( void *mem, unsigned capacity ) {
+	int r;
+	ring_buffer_shm_t *rb;
+
+	if ( NULL == mem || 0 == capacity ) {
+		r = -1;
+		goto out;
+	}
+
+	rb = (ring_buffer_shm_t *) mem;
+	memset( rb, 0, sizeof( *rb ) );
+
+	rb->capacity = capacity;
+	rb->data_offset = ring_buffer_shm_footprint( 0 );
+
+	if ( EXIT_SUCCESS != shm_init_lock( & rb->producer_lock ) || EXIT_SUCCESS != shm_init_lock( & rb->consumer_lock ) ) {
+		r = -1;
+		goto out;
+	}
+
+	// publish the magic last so that a racing mapper never sees a half-formatted ring
+	__atomic_store_n( & rb->magic, RING_BUFFER_SHM_MAGIC, __ATOMIC_RELEASE );
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_shm_create( const char *name, unsigned capacity ) {
+	int r;
+	int fd;
+	size_t sz;
+	void *mem;
+
+	fd = -1;
+
+	if ( 0 == capacity ) {
+		r = -1;
+		goto out;
+	}
+
+	if ( NULL == name ) {
+		fd = memfd_create( "ring-buffer-shm", MFD_CLOEXEC );
+	} else {
+		fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 );
+	}
+	if ( -1 == fd ) {
+		r = -1;
+		goto out;
+	}
+
+	sz = ring_buffer_shm_footprint( capacity );
+	if ( -1 == ftruncate( fd, sz ) ) {
+		r = -1;
+		goto out;
+	}
+
+	mem = mmap( NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	if ( MAP_FAILED == mem ) {
+		r = -1;
+		goto out;
+	}
+	r = ring_buffer_shm_init( mem, capacity );
+	munmap( mem, sz );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	r = fd;
+
+out:
+	if ( -1 == r && -1 != fd ) {
+		close( fd );
+		if ( NULL != name ) {
+			shm_unlink( name );
+		}
+	}
+	return r;
+}
+
+ring_buffer_shm_t *ring_buffer_shm_map( int fd ) {
+	ring_buffer_shm_t *r;
+	struct stat st;
+	void *mem;
+
+	r = NULL;
+
+	if ( -1 == fstat( fd, & st ) || (size_t) st.st_size < ring_buffer_shm_footprint( 0 ) ) {
+		goto out;
+	}
+
+	mem = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	if ( MAP_FAILED == mem ) {
+		goto out;
+	}
+
+	r = (ring_buffer_shm_t *) mem;
+	if (
+		RING_BUFFER_SHM_MAGIC != __atomic_load_n( & r->magic, __ATOMIC_ACQUIRE )
+		|| ring_buffer_shm_footprint( r->capacity ) > (size_t) st.st_size
+	) {
+		munmap( mem, st.st_size );
+		r = NULL;
+	}
+
+out:
+	return r;
+}
+
+void ring_buffer_shm_unmap( ring_buffer_shm_t *rb ) {
+	if ( NULL == rb ) {
+		goto out;
+	}
+	munmap( rb, ring_buffer_shm_footprint( rb->capacity ) );
+out:
+	return;
+}
+
+static int shm_attach( pthread_mutex_t *lock, uint32_t *state ) {
+	int r;
+
+	r = pthread_mutex_lock( lock );
+	if ( EOWNERDEAD == r ) {
+		// a previous holder died; take over its side
+		pthread_mutex_consistent( lock );
+		r = 0;
+	}
+	if ( 0 != r ) {
+		r = -1;
+		goto out;
+	}
+
+	__atomic_store_n( state, SHM_SIDE_ATTACHED, __ATOMIC_SEQ_CST );
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_shm_attach_producer( ring_buffer_shm_t *rb ) {
+	if ( NULL == rb ) {
+		return -1;
+	}
+	return shm_attach( & rb->producer_lock, & rb->producer_state );
+}
+
+int ring_buffer_shm_attach_consumer( ring_buffer_shm_t *rb ) {
+	if ( NULL == rb ) {
+		return -1;
+	}
+	return shm_attach( & rb->consumer_lock, & rb->consumer_state );
+}
+
+void ring_buffer_shm_detach( ring_buffer_shm_t *rb ) {
+
+	if ( NULL == rb ) {
+		goto out;
+	}
+
+	// an error-checking mutex only unlocks for its owner, which is how we know our side(s)
+	if ( 0 == pthread_mutex_unlock( & rb->producer_lock ) ) {
+		__atomic_store_n( & rb->producer_state, SHM_SIDE_GONE, __ATOMIC_SEQ_CST );
+		__atomic_fetch_add( & rb->data_seq, 1, __ATOMIC_SEQ_CST );
+		shmfutex( & rb->data_seq, FUTEX_WAKE, INT32_MAX, NULL );
+	}
+	if ( 0 == pthread_mutex_unlock( & rb->consumer_lock ) ) {
+		__atomic_store_n( & rb->consumer_state, SHM_SIDE_GONE, __ATOMIC_SEQ_CST );
+		__atomic_fetch_add( & rb->space_seq, 1, __ATOMIC_SEQ_CST );
+		shmfutex( & rb->space_seq, FUTEX_WAKE, INT32_MAX, NULL );
+	}
+
+out:
+	return;
+}
+
+// true once the side guarded by lock / state has detached or died
+static int shm_gone( pthread_mutex_t *lock, uint32_t *state ) {
+	int r;
+
+	switch( __atomic_load_n( state, __ATOMIC_SEQ_CST ) ) {
+
+	case SHM_SIDE_NONE:
+		r = 0;
+		break;
+
+	case SHM_SIDE_ATTACHED:
+		r = pthread_mutex_trylock( lock );
+		if ( EBUSY == r || EDEADLK == r ) {
+			// held by someone else, or by the calling thread itself
+			r = 0;
+			break;
+		}
+		if ( EOWNERDEAD == r ) {
+			pthread_mutex_consistent( lock );
+		}
+		// either the holder died, or it is detaching right now
+		__atomic_store_n( state, SHM_SIDE_GONE, __ATOMIC_SEQ_CST );
+		pthread_mutex_unlock( lock );
+		r = 1;
+		break;
+
+	default:
+		r = 1;
+		break;
+	}
+
+	return r;
+}
+
+int ring_buffer_shm_write( ring_buffer_shm_t *rb, const void *data, unsigned data_len ) {
+	int r;
+	uint64_t tail;
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	tail = rb->tail;
+	r = rb->capacity - (unsigned)( tail - __atomic_load_n( & rb->head, __ATOMIC_ACQUIRE ) );
+	r = min( (unsigned) r, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = tail % rb->capacity;
+	t1 = min( (unsigned) r, rb->capacity - pos );
+	memcpy( & shmdata( rb )[ pos ], data, t1 );
+	memcpy( & shmdata( rb )[ 0 ], & ( (const uint8_t *) data )[ t1 ], r - t1 );
+
+	// seq_cst orders the publish before reading the consumer's waiting flag
+	__atomic_store_n( & rb->tail, tail + r, __ATOMIC_SEQ_CST );
+	shmring( & rb->data_seq, & rb->consumer_waiting );
+
+out:
+	return r;
+}
+
+int ring_buffer_shm_read( ring_buffer_shm_t *rb, void *data, unsigned data_len ) {
+	int r;
+	uint64_t head;
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	head = rb->head;
+	r = (unsigned)( __atomic_load_n( & rb->tail, __ATOMIC_ACQUIRE ) - head );
+	r = min( (unsigned) r, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = head % rb->capacity;
+	t1 = min( (unsigned) r, rb->capacity - pos );
+	memcpy( data, & shmdata( rb )[ pos ], t1 );
+	memcpy( & ( (uint8_t *) data )[ t1 ], & shmdata( rb )[ 0 ], r - t1 );
+
+	__atomic_store_n( & rb->head, head + r, __ATOMIC_SEQ_CST );
+	shmring( & rb->space_seq, & rb->producer_waiting );
+
+out:
+	return r;
+}
+
+unsigned ring_buffer_shm_size( ring_buffer_shm_t *rb ) {
+	if ( NULL == rb ) {
+		return 0;
+	}
+	return shmsize( rb );
+}
+
+unsigned ring_buffer_shm_available( ring_buffer_shm_t *rb ) {
+	if ( NULL == rb ) {
+		return 0;
+	}
+	return rb->capacity - shmsize( rb );
+}
+
+static int64_t shm_now_ms( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, & ts );
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int shm_wait( ring_buffer_shm_t *rb, int readable, int timeout_ms ) {
+	int r;
+	uint32_t *seq;
+	uint32_t *waiting;
+	pthread_mutex_t *peer_lock;
+	uint32_t *peer_state;
+	uint32_t seq_val;
+	int64_t deadline;
+	int64_t slice;
+	struct timespec ts;
+
+	if ( NULL == rb ) {
+		r = -1;
+		goto out;
+	}
+
+	if ( readable ) {
+		seq = & rb->data_seq;
+		waiting = & rb->consumer_waiting;
+		peer_lock = & rb->producer_lock;
+		peer_state = & rb->producer_state;
+	} else {
+		seq = & rb->space_seq;
+		waiting = & rb->producer_waiting;
+		peer_lock = & rb->consumer_lock;
+		peer_state = & rb->consumer_state;
+	}
+
+	deadline = timeout_ms < 0 ? INT64_MAX : shm_now_ms() + timeout_ms;
+
+	for( ;; ) {
+
+		if ( ! readable && shm_gone( peer_lock, peer_state ) ) {
+			// nobody will ever read what we write
+			r = -EPIPE;
+			break;
+		}
+
+		r = readable ? ring_buffer_shm_size( rb ) : ring_buffer_shm_available( rb );
+		if ( r > 0 ) {
+			break;
+		}
+
+		if ( readable && shm_gone( peer_lock, peer_state ) ) {
+			// anything published before the producer left has been drained
+			r = ring_buffer_shm_size( rb );
+			r = 0 == r ? -EPIPE : r;
+			break;
+		}
+
+		slice = deadline - shm_now_ms();
+		if ( slice <= 0 ) {
+			r = 0;
+			break;
+		}
+		slice = min( slice, SHM_LIVENESS_POLL_MS );
+
+		seq_val = __atomic_load_n( seq, __ATOMIC_SEQ_CST );
+		__atomic_store_n( waiting, 1, __ATOMIC_SEQ_CST );
+
+		// recheck after raising the flag, so that a peer which missed it has already published
+		r = readable ? ring_buffer_shm_size( rb ) : ring_buffer_shm_available( rb );
+		if ( 0 == r ) {
+			ts.tv_sec = slice / 1000;
+			ts.tv_nsec = ( slice % 1000 ) * 1000000;
+			shmfutex( seq, FUTEX_WAIT, seq_val, & ts );
+		}
+
+		__atomic_store_n( waiting, 0, __ATOMIC_SEQ_CST );
+	}
+
+out:
+	return r;
+}
+
+int ring_buffer_shm_wait_readable( ring_buffer_shm_t *rb, int timeout_ms ) {
+	return shm_wait( rb, 1, timeout_ms );
+}
+
+int ring_buffer_shm_wait_writable( ring_buffer_shm_t *rb, int timeout_ms ) {
+	return shm_wait( rb, 0, timeout_ms );
+}
@@ -0,0 +1,76 @@
+#ifndef RING_BUFFER_SHM_H_
+#define RING_BUFFER_SHM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+// A single-producer / single-consumer byte ring for passing data between
+// processes. The whole ring, header included, lives in one shared mapping and
+// holds no pointers, so each process may map it at a different address.
+
+#define RING_BUFFER_SHM_MAGIC 0x52425348 // 'RBSH'
+#define RING_BUFFER_SHM_CACHELINE 64
+
+struct _ring_buffer_shm;
+typedef struct _ring_buffer_shm ring_buffer_shm_t;
+
+struct _ring_buffer_shm {
+	uint32_t         magic;
+	uint32_t         capacity;
+	// offset of the data area from the start of this header
+	uint32_t         data_offset;
+	uint32_t         reserved;
+
+	// written by the producer
+	uint64_t         tail __attribute__(( aligned( RING_BUFFER_SHM_CACHELINE ) ));
+	// doorbell that the consumer sleeps on
+	uint32_t         data_seq;
+	uint32_t         producer_state;
+	uint32_t         producer_waiting;
+
+	// written by the consumer
+	uint64_t         head __attribute__(( aligned( RING_BUFFER_SHM_CACHELINE ) ));
+	// doorbell that the producer sleeps on
+	uint32_t         space_seq;
+	uint32_t         consumer_state;
+	uint32_t         consumer_waiting;
+
+	// robust, process-shared locks held by each attached side for as long as
+	// it lives; the kernel releases them with EOWNERDEAD if the holder dies
+	pthread_mutex_t  producer_lock __attribute__(( aligned( RING_BUFFER_SHM_CACHELINE ) ));
+	pthread_mutex_t  consumer_lock;
+};
+
+// the number of bytes a ring of the given capacity occupies in shared memory
+size_t ring_buffer_shm_footprint( unsigned capacity );
+// format a ring in the memory at mem, which must be ring_buffer_shm_footprint() bytes
+int ring_buffer_shm_init( void *mem, unsigned capacity );
+
+// create and format a shared memory object; anonymous (memfd) if name is NULL. returns the fd
+int ring_buffer_shm_create( const char *name, unsigned capacity );
+// map a formatted ring from a shared memory fd
+ring_buffer_shm_t *ring_buffer_shm_map( int fd );
+void ring_buffer_shm_unmap( ring_buffer_shm_t *rb );
+
+// claim a side of the ring for the calling thread; its exit is seen by the peer as a hang-up
+int ring_buffer_shm_attach_producer( ring_buffer_shm_t *rb );
+int ring_buffer_shm_attach_consumer( ring_buffer_shm_t *rb );
+// release whichever sides the calling thread has claimed
+void ring_buffer_shm_detach( ring_buffer_shm_t *rb );
+
+// non-blocking; return the number of bytes transferred
+int ring_buffer_shm_write( ring_buffer_shm_t *rb, const void *data, unsigned data_len );
+int ring_buffer_shm_read( ring_buffer_shm_t *rb, void *data, unsigned data_len );
+
+unsigned ring_buffer_shm_size( ring_buffer_shm_t *rb );
+unsigned ring_buffer_shm_available( ring_buffer_shm_t *rb );
+
+// sleep until data (or space) is present, for at most timeout_ms (-1 is forever).
+// return the number of bytes readable (or writable), 0 on timeout, or -EPIPE
+// once the peer has detached or died and nothing more can happen
+int ring_buffer_shm_wait_readable( ring_buffer_shm_t *rb, int timeout_ms );
+int ring_buffer_shm_wait_writable( ring_buffer_shm_t *rb, int timeout_ms );
+
+#endif /* RING_BUFFER_SHM_H_ */
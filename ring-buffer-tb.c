@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ring-buffer-tb.h"
+
+static inline uint8_t *tbslot( ring_buffer_tb_t *tb, unsigned i ) {
+	return & tb->buffer[ (size_t) i * tb->size ];
+}
+
+int ring_buffer_tb_init( ring_buffer_tb_t *tb, unsigned size, void *buffer ) {
+	int r;
+
+	if ( NULL == tb || NULL == buffer || 0 == size ) {
+		r = -1;
+		goto out;
+	}
+
+	tb->size = size;
+	tb->buffer = (uint8_t *) buffer;
+	tb->back = 0;
+	tb->middle = 1;
+	tb->front = 2;
+	tb->valid = 0;
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+void *ring_buffer_tb_back( ring_buffer_tb_t *tb ) {
+	return NULL == tb ? NULL : tbslot( tb, tb->back );
+}
+
+void ring_buffer_tb_publish( ring_buffer_tb_t *tb ) {
+	if ( NULL == tb ) {
+		goto out;
+	}
+	// release the back slot's contents; acquire the slot handed back, which the reader may just have finished with
+	tb->back = __atomic_exchange_n( & tb->middle, tb->back | RING_BUFFER_TB_FRESH, __ATOMIC_ACQ_REL ) & ~RING_BUFFER_TB_FRESH;
+out:
+	return;
+}
+
+int ring_buffer_tb_write( ring_buffer_tb_t *tb, const void *data ) {
+	int r;
+
+	if ( NULL == tb || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	memcpy( tbslot( tb, tb->back ), data, tb->size );
+	ring_buffer_tb_publish( tb );
+	r = tb->size;
+
+out:
+	return r;
+}
+
+const void *ring_buffer_tb_latest( ring_buffer_tb_t *tb, int *fresh ) {
+	const void *r;
+	int f;
+
+	r = NULL;
+	f = 0;
+	if ( NULL == tb ) {
+		goto out;
+	}
+
+	if ( __atomic_load_n( & tb->middle, __ATOMIC_RELAXED ) & RING_BUFFER_TB_FRESH ) {
+		// acquire the published contents; release the slot handed back
+		tb->front = __atomic_exchange_n( & tb->middle, tb->front, __ATOMIC_ACQ_REL ) & ~RING_BUFFER_TB_FRESH;
+		tb->valid = 1;
+		f = 1;
+	}
+	if ( tb->valid ) {
+		r = tbslot( tb, tb->front );
+	}
+
+out:
+	if ( NULL != fresh ) {
+		*fresh = f;
+	}
+	return r;
+}
+
+int ring_buffer_tb_read( ring_buffer_tb_t *tb, void *data ) {
+	int r;
+	const void *latest;
+	int fresh;
+
+	if ( NULL == tb || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	latest = ring_buffer_tb_latest( tb, & fresh );
+	r = 0;
+	if ( fresh ) {
+		memcpy( data, latest, tb->size );
+		r = tb->size;
+	}
+
+out:
+	return r;
+}
@@ -0,0 +1,54 @@
+#ifndef RING_BUFFER_TB_H_
+#define RING_BUFFER_TB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+
+// A triple-buffered mailbox holding only the latest value, for publishing
+// state such as configuration or quote snapshots, where a ring would make the
+// reader drain stale entries and stall the writer when full.
+//
+// Of three fixed-size slots in caller storage, the writer owns one, the
+// reader owns another, and the third holds the most recently published
+// value. Publishing and taking the latest value are each a single atomic
+// exchange, so the writer never waits on the reader, and the reader never
+// sees a value that is only partly written. One writer and one reader only.
+
+#define RING_BUFFER_TB_CACHELINE 64
+
+// Each side's private state is on its own cache line, as is the slot they
+// exchange, so that neither side's stores invalidate a line the other reads.
+typedef struct {
+	// read-only once initialised
+	unsigned         size;
+	uint8_t         *buffer;
+	// the slot the writer is filling
+	unsigned         back __attribute__(( aligned( RING_BUFFER_TB_CACHELINE ) ));
+	// the slot the reader holds, and whether it has taken a value into it yet
+	unsigned         front __attribute__(( aligned( RING_BUFFER_TB_CACHELINE ) ));
+	int              valid;
+	// the published slot, with RING_BUFFER_TB_FRESH set until the reader takes it
+	uint32_t         middle __attribute__(( aligned( RING_BUFFER_TB_CACHELINE ) ));
+} ring_buffer_tb_t;
+
+#define RING_BUFFER_TB_FRESH 0x4
+
+// buffer must hold 3 * size bytes
+int ring_buffer_tb_init( ring_buffer_tb_t *tb, unsigned size, void *buffer );
+
+// writer side: the slot to fill in place, then publish it
+void *ring_buffer_tb_back( ring_buffer_tb_t *tb );
+void ring_buffer_tb_publish( ring_buffer_tb_t *tb );
+// copy size bytes into the back slot, and publish them. returns size
+int ring_buffer_tb_write( ring_buffer_tb_t *tb, const void *data );
+
+// reader side: the latest value, valid until the next call on the reader
+// side, or NULL when nothing has been published yet. when fresh is not NULL,
+// it is set to 1 if the value was published since the previous call, else 0
+const void *ring_buffer_tb_latest( ring_buffer_tb_t *tb, int *fresh );
+// copy the latest value to data when it is newer than the last one read.
+// returns size, or 0 when there is nothing newer
+int ring_buffer_tb_read( ring_buffer_tb_t *tb, void *data );
+
+#endif /* RING_BUFFER_TB_H_ */
@@ -0,0 +1,170 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ring-buffer-trace.h"
+
+#include "minmax.h"
+
+static inline ring_buffer_trace_t *trace( ring_buffer_t *rb ) {
+	return RING_BUFFER_CONTAINER( rb, ring_buffer_trace_t, rb );
+}
+
+static inline uint64_t tracenow( void ) {
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, & now );
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*###########################################################################
+  #                            RECORDING
+  ###########################################################################*/
+
+static void tracebegin( ring_buffer_t *rb, unsigned op ) {
+	trace( rb )->ns = tracenow();
+}
+
+// operations that the base ring makes on itself, e.g. send() realigning, are
+// part of the outer one, and not recorded
+static void tracerec( ring_buffer_t *rb, unsigned op, unsigned data_len, unsigned before, int result ) {
+	ring_buffer_trace_t *t = trace( rb );
+	ring_buffer_trace_rec_t rec;
+
+	rec.ns = t->ns - t->start;
+	rec.size = data_len;
+	rec.result = result;
+	rec.op = op;
+	fwrite( & rec, sizeof( rec ), 1, t->out );
+}
+
+int ring_buffer_trace_init( ring_buffer_trace_t *t, unsigned capacity, void *buffer, FILE *out ) {
+	int r;
+	ring_buffer_trace_header_t h;
+
+	if ( NULL == t || NULL == out ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_wrap_init( (ring_buffer_wrap_t *) t, capacity, buffer, RING_BUFFER_OPS_ALL, tracebegin, tracerec );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	memset( & h, 0, sizeof( h ) );
+	h.magic = RING_BUFFER_TRACE_MAGIC;
+	h.version = RING_BUFFER_TRACE_VERSION;
+	h.capacity = capacity;
+	if ( 1 != fwrite( & h, sizeof( h ), 1, out ) ) {
+		r = -1;
+		goto out;
+	}
+
+	t->out = out;
+	t->start = tracenow();
+
+out:
+	return r;
+}
+
+int ring_buffer_trace_flush( ring_buffer_trace_t *t ) {
+	return NULL == t ? -1 : fflush( t->out );
+}
+
+/*###########################################################################
+  #                            REPLAY
+  ###########################################################################*/
+
+// wait until ns after start: sleep through long gaps, and spin through the rest
+static void tracewait( uint64_t start, uint64_t ns ) {
+	struct timespec ts;
+	uint64_t now;
+
+	for( now = tracenow(); now - start < ns; now = tracenow() ) {
+		if ( ns - ( now - start ) > 200000 ) {
+			ts.tv_sec = 0;
+			ts.tv_nsec = ns - ( now - start ) - 100000;
+			ts.tv_nsec = ts.tv_nsec > 999999999 ? 999999999 : ts.tv_nsec;
+			nanosleep( & ts, NULL );
+		}
+	}
+}
+
+int ring_buffer_trace_replay( FILE *in, ring_buffer_t *rb, int paced, ring_buffer_trace_stats_t *stats ) {
+	int r;
+	int res;
+	ring_buffer_trace_header_t h;
+	ring_buffer_trace_rec_t rec;
+	ring_buffer_t input;
+	uint8_t *scratch;
+	unsigned scratch_len;
+	uint64_t start;
+	uint64_t t0;
+
+	scratch = NULL;
+
+	if ( NULL == in || NULL == rb || NULL == stats ) {
+		r = -1;
+		goto out;
+	}
+
+	if ( 0 != fseek( in, 0, SEEK_SET ) || 1 != fread( & h, sizeof( h ), 1, in ) || RING_BUFFER_TRACE_MAGIC != h.magic || 0 == h.version || h.version > RING_BUFFER_TRACE_VERSION ) {
+		r = -1;
+		goto out;
+	}
+
+	// operand buffer, then storage for the input to send(). no single
+	// operation moves more than rb holds, so that is all either one needs,
+	// whatever sizes were recorded
+	scratch_len = rb->capacity + 1;
+	scratch = malloc( 2 * (size_t) scratch_len );
+	if ( NULL == scratch ) {
+		r = -1;
+		goto out;
+	}
+	memset( scratch, 0xa5, 2 * (size_t) scratch_len );
+
+	memset( stats->ops, 0, sizeof( stats->ops ) );
+	stats->bytes = 0;
+	stats->mismatches = 0;
+
+	start = tracenow();
+	for( r = 0; 1 == fread( & rec, sizeof( rec ), 1, in ); r++ ) {
+		if ( rec.op >= RING_BUFFER_TRACE_NOPS ) {
+			break;
+		}
+		if ( RING_BUFFER_TRACE_SEND == rec.op ) {
+			ring_buffer_init( & input, scratch_len, & scratch[ scratch_len ] );
+			input.len = min( rec.size, scratch_len );
+		}
+		if ( paced ) {
+			tracewait( start, rec.ns );
+		}
+
+		res = 0;
+		t0 = tracenow();
+		switch( rec.op ) {
+		case RING_BUFFER_TRACE_PEEK: res = rb->peek( rb, scratch, rec.size ); break;
+		case RING_BUFFER_TRACE_READ: res = rb->read( rb, scratch, rec.size ); break;
+		case RING_BUFFER_TRACE_WRITE: res = rb->write( rb, scratch, rec.size ); break;
+		case RING_BUFFER_TRACE_SEND: res = rb->send( rb, & input, rec.size ); break;
+		case RING_BUFFER_TRACE_SKIP: res = rb->skip( rb, rec.size ); break;
+		case RING_BUFFER_TRACE_RESET: rb->reset( rb ); break;
+		case RING_BUFFER_TRACE_REALIGN: rb->realign( rb ); break;
+		case RING_BUFFER_TRACE_COMMIT: res = rb->commit( rb, rec.size ); break;
+		}
+		if ( NULL != stats->latency[ rec.op ] ) {
+			histogram_record( stats->latency[ rec.op ], tracenow() - t0 );
+		}
+
+		stats->ops[ rec.op ]++;
+		stats->bytes += res > 0 ? res : 0;
+		stats->mismatches += res != rec.result;
+	}
+	stats->elapsed_ns = tracenow() - start;
+
+out:
+	free( scratch );
+	return r;
+}
@@ -0,0 +1,86 @@
+#ifndef RING_BUFFER_TRACE_H_
+#define RING_BUFFER_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ring-buffer-wrap.h"
+#include "histogram.h"
+
+// Capture and replay of the operations made on a ring, so that a production
+// mix of sizes and timing can be re-run offline against other backends.
+//
+// ring_buffer_trace_t wraps every operation on a ring except size() and
+// available(), and appends one record per call to a binary file: a
+// ring_buffer_trace_header_t followed by ring_buffer_trace_rec_t's, in host
+// byte order. The free ring_buffer_*() readers and writers appear as the
+// skip() or commit() that they end with.
+//
+// ring_buffer_trace_replay() re-executes such a file against any ring,
+// timing each operation. Data written during replay is filler, and send()
+// is fed from a scratch ring, since the trace holds sizes, not contents.
+
+#define RING_BUFFER_TRACE_MAGIC 0x52425452 // 'RBTR'
+// version 2 added commit; version 1 traces are still replayed
+#define RING_BUFFER_TRACE_VERSION 2
+
+// recorded as is, so the values must not change
+enum {
+	RING_BUFFER_TRACE_PEEK = RING_BUFFER_OP_PEEK,
+	RING_BUFFER_TRACE_READ = RING_BUFFER_OP_READ,
+	RING_BUFFER_TRACE_WRITE = RING_BUFFER_OP_WRITE,
+	RING_BUFFER_TRACE_SEND = RING_BUFFER_OP_SEND,
+	RING_BUFFER_TRACE_SKIP = RING_BUFFER_OP_SKIP,
+	RING_BUFFER_TRACE_RESET = RING_BUFFER_OP_RESET,
+	RING_BUFFER_TRACE_REALIGN = RING_BUFFER_OP_REALIGN,
+	RING_BUFFER_TRACE_COMMIT = RING_BUFFER_OP_COMMIT,
+	RING_BUFFER_TRACE_NOPS = RING_BUFFER_NOPS,
+};
+
+typedef struct {
+	uint32_t         magic;
+	uint32_t         version;
+	// of the traced ring
+	uint32_t         capacity;
+	uint32_t         reserved;
+} ring_buffer_trace_header_t;
+
+typedef struct {
+	// since the trace began, in ns
+	uint64_t         ns;
+	uint32_t         size;
+	int32_t          result;
+	uint8_t          op;
+} __attribute__(( packed )) ring_buffer_trace_rec_t;
+
+typedef struct {
+	RING_BUFFER_WRAP_FIELDS
+	FILE            *out;
+	uint64_t         start;
+	// when the operation being recorded began
+	uint64_t         ns;
+} ring_buffer_trace_t;
+
+// writes the header to out, which stays owned by the caller
+int ring_buffer_trace_init( ring_buffer_trace_t *t, unsigned capacity, void *buffer, FILE *out );
+int ring_buffer_trace_flush( ring_buffer_trace_t *t );
+
+typedef struct {
+	// filled in by the replay
+	uint64_t         ops[ RING_BUFFER_TRACE_NOPS ];
+	// moved by peek, read, write, send, skip and commit
+	uint64_t         bytes;
+	// operations whose result differed from the one recorded
+	uint64_t         mismatches;
+	uint64_t         elapsed_ns;
+	// set by the caller, per operation; any may be NULL
+	histogram_t     *latency[ RING_BUFFER_TRACE_NOPS ];
+} ring_buffer_trace_stats_t;
+
+// replay the trace in from the start, against rb. when paced, each operation
+// waits until its recorded time; otherwise they run back to back. returns the
+// number of operations replayed, or -1 when in is not a trace or there is no
+// memory for rb's capacity
+int ring_buffer_trace_replay( FILE *in, ring_buffer_t *rb, int paced, ring_buffer_trace_stats_t *stats );
+
+#endif /* RING_BUFFER_TRACE_H_ */
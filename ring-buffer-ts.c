@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ring-buffer-ts.h"
+
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#define TS_X86
+#include <x86intrin.h>
+#endif // defined( __GNUC__ ) && defined( __x86_64__ )
+
+static inline ring_buffer_ts_t *ts( ring_buffer_t *rb ) {
+	return RING_BUFFER_CONTAINER( rb, ring_buffer_ts_t, rb );
+}
+
+static inline unsigned tsadd( unsigned a, unsigned b, unsigned n ) {
+	a += b;
+	return a >= n ? a - n : a;
+}
+
+// the length grew from before: stamp the bytes that arrived
+static void tsproduced( ring_buffer_ts_t *t, unsigned before ) {
+	ring_buffer_ts_stamp_t *s;
+
+	if ( t->rb.len <= before ) {
+		goto out;
+	}
+
+	t->written += t->rb.len - before;
+
+	if ( t->stamps_len == t->nstamps ) {
+		s = & t->stamps[ tsadd( t->stamps_head, t->stamps_len - 1, t->nstamps ) ];
+		s->end = t->written;
+		goto out;
+	}
+
+	s = & t->stamps[ tsadd( t->stamps_head, t->stamps_len, t->nstamps ) ];
+	s->end = t->written;
+	s->stamp = t->clock( t->clock_arg );
+	t->stamps_len++;
+
+out:
+	return;
+}
+
+// the length shrank from before: record every write that has now been consumed in full
+static void tsconsumed( ring_buffer_ts_t *t, unsigned before ) {
+	ring_buffer_ts_stamp_t *s;
+	uint64_t now;
+
+	if ( t->rb.len >= before ) {
+		goto out;
+	}
+
+	t->consumed += before - t->rb.len;
+
+	s = & t->stamps[ t->stamps_head ];
+	if ( 0 == t->stamps_len || (int32_t)( t->consumed - s->end ) < 0 ) {
+		goto out;
+	}
+
+	now = t->clock( t->clock_arg );
+	do {
+		histogram_record( t->hist, now - s->stamp );
+		t->stamps_head = tsadd( t->stamps_head, 1, t->nstamps );
+		t->stamps_len--;
+		s = & t->stamps[ t->stamps_head ];
+	} while( t->stamps_len > 0 && (int32_t)( t->consumed - s->end ) >= 0 );
+
+out:
+	return;
+}
+
+static void tsafter( ring_buffer_t *rb, unsigned op, unsigned data_len, unsigned before, int result ) {
+	ring_buffer_ts_t *t = ts( rb );
+
+	// discarded data was never consumed, so it is not recorded
+	if ( RING_BUFFER_OP_RESET == op ) {
+		t->stamps_head = 0;
+		t->stamps_len = 0;
+		t->written = 0;
+		t->consumed = 0;
+	} else if ( t->rb.len > before ) {
+		tsproduced( t, before );
+	} else {
+		tsconsumed( t, before );
+	}
+}
+
+uint64_t ring_buffer_ts_monotonic( void *arg ) {
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, & now );
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+uint64_t ring_buffer_ts_tsc( void *arg ) {
+#ifdef TS_X86
+	return __rdtsc();
+#else
+	return ring_buffer_ts_monotonic( arg );
+#endif // TS_X86
+}
+
+int ring_buffer_ts_init( ring_buffer_ts_t *t, unsigned capacity, void *buffer, ring_buffer_ts_stamp_t *stamps, unsigned nstamps, ring_buffer_ts_clock_fn clock, void *clock_arg, histogram_t *hist ) {
+	int r;
+
+	if ( NULL == t || NULL == stamps || 0 == nstamps || NULL == hist ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_wrap_init( (ring_buffer_wrap_t *) t, capacity, buffer, RING_BUFFER_OPS_LEN, NULL, tsafter );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	t->stamps = stamps;
+	t->nstamps = nstamps;
+	t->stamps_head = 0;
+	t->stamps_len = 0;
+	t->written = 0;
+	t->consumed = 0;
+	t->clock = NULL == clock ? ring_buffer_ts_monotonic : clock;
+	t->clock_arg = clock_arg;
+	t->hist = hist;
+
+out:
+	return r;
+}
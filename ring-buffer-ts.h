@@ -0,0 +1,52 @@
+#ifndef RING_BUFFER_TS_H_
+#define RING_BUFFER_TS_H_
+
+#include <stdint.h>
+
+#include "ring-buffer-wrap.h"
+#include "histogram.h"
+
+// A ring that measures how long its data waits to be consumed. Each write is
+// stamped with the time in a small side ring of (end position, stamp) pairs;
+// once a read or skip has consumed the last byte of a write, the time it spent
+// in the ring is recorded in a histogram. A clock read costs one call per
+// operation, not per byte or record. When the side ring is full, a write is
+// merged into the previous one and inherits its (older) stamp, so residence
+// is over- rather than under-estimated.
+//
+// The operations that change the length (write, read, send, skip, commit and
+// reset) are timed, and so are the free functions, which end with skip() or
+// commit().
+
+typedef uint64_t (*ring_buffer_ts_clock_fn)( void *arg );
+
+typedef struct {
+	// the stream position just past the write's last byte (modulo 2^32)
+	uint32_t         end;
+	uint64_t         stamp;
+} __attribute__(( packed )) ring_buffer_ts_stamp_t;
+
+typedef struct {
+	RING_BUFFER_WRAP_FIELDS
+	ring_buffer_ts_stamp_t  *stamps;
+	unsigned                 nstamps;
+	unsigned                 stamps_head;
+	unsigned                 stamps_len;
+	// stream positions, in bytes ever written and consumed
+	uint32_t                 written;
+	uint32_t                 consumed;
+	ring_buffer_ts_clock_fn  clock;
+	void                    *clock_arg;
+	// may be shared between rings
+	histogram_t             *hist;
+} ring_buffer_ts_t;
+
+// CLOCK_MONOTONIC, in ns
+uint64_t ring_buffer_ts_monotonic( void *arg );
+// the time stamp counter, in cycles, where there is one; CLOCK_MONOTONIC otherwise
+uint64_t ring_buffer_ts_tsc( void *arg );
+
+// clock NULL selects ring_buffer_ts_monotonic()
+int ring_buffer_ts_init( ring_buffer_ts_t *t, unsigned capacity, void *buffer, ring_buffer_ts_stamp_t *stamps, unsigned nstamps, ring_buffer_ts_clock_fn clock, void *clock_arg, histogram_t *hist );
+
+#endif /* RING_BUFFER_TS_H_ */
@@ -0,0 +1,43 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ring-buffer-wm.h"
+
+static inline ring_buffer_wm_t *wm( ring_buffer_t *rb ) {
+	return RING_BUFFER_CONTAINER( rb, ring_buffer_wm_t, rb );
+}
+
+// compare the length before and after an operation and report any watermark crossed
+static void wmcross( ring_buffer_t *rb, unsigned op, unsigned data_len, unsigned before, int result ) {
+	ring_buffer_wm_t *w = wm( rb );
+	unsigned after = w->rb.len;
+	if ( before < w->high && after >= w->high && NULL != w->on_high ) {
+		w->on_high( & w->rb, w->arg );
+	}
+	if ( before > w->low && after <= w->low && NULL != w->on_low ) {
+		w->on_low( & w->rb, w->arg );
+	}
+}
+
+int ring_buffer_wm_init( ring_buffer_wm_t *w, unsigned capacity, void *buffer, unsigned low, ring_buffer_wm_fn on_low, unsigned high, ring_buffer_wm_fn on_high, void *arg ) {
+	int r;
+
+	if ( NULL == w || low >= high || high > capacity ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_wrap_init( (ring_buffer_wrap_t *) w, capacity, buffer, RING_BUFFER_OPS_LEN, NULL, wmcross );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	w->low = low;
+	w->high = high;
+	w->on_low = on_low;
+	w->on_high = on_high;
+	w->arg = arg;
+
+out:
+	return r;
+}
@@ -0,0 +1,27 @@
+#ifndef RING_BUFFER_WM_H_
+#define RING_BUFFER_WM_H_
+
+#include "ring-buffer-wrap.h"
+
+// A ring with low and high watermarks, for flow control without polling.
+// on_high is called when an operation takes the length from below high to
+// high or above, and on_low when one takes it from above low to low or below.
+// Callbacks run inside the operation, after it has completed. Plain rings are
+// unaffected: the checks live in wrapped operations, not in ring-buffer.c.
+// The free functions end with skip() or commit(), so they are checked too.
+
+typedef void (*ring_buffer_wm_fn)( ring_buffer_t *rb, void *arg );
+
+typedef struct {
+	RING_BUFFER_WRAP_FIELDS
+	unsigned           low;
+	unsigned           high;
+	// either may be NULL
+	ring_buffer_wm_fn  on_low;
+	ring_buffer_wm_fn  on_high;
+	void              *arg;
+} ring_buffer_wm_t;
+
+int ring_buffer_wm_init( ring_buffer_wm_t *wm, unsigned capacity, void *buffer, unsigned low, ring_buffer_wm_fn on_low, unsigned high, ring_buffer_wm_fn on_high, void *arg );
+
+#endif /* RING_BUFFER_WM_H_ */
@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ring-buffer-wrap.h"
+
+static inline ring_buffer_wrap_t *wrap( ring_buffer_t *rb ) {
+	return RING_BUFFER_CONTAINER( rb, ring_buffer_wrap_t, rb );
+}
+
+// returns the length of the ring as the operation begins
+static inline unsigned wrapbegin( ring_buffer_wrap_t *w, unsigned op ) {
+	if ( 0 == w->depth++ && NULL != w->before ) {
+		w->before( & w->rb, op );
+	}
+	return w->rb.len;
+}
+
+static inline void wrapend( ring_buffer_wrap_t *w, unsigned op, unsigned data_len, unsigned before, int result ) {
+	if ( 0 == --w->depth && NULL != w->after ) {
+		w->after( & w->rb, op, data_len, before, result );
+	}
+}
+
+static int ring_buffer_wrap_peek( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_PEEK );
+	int r = wrap( rb )->peek( rb, data, data_len );
+	wrapend( wrap( rb ), RING_BUFFER_OP_PEEK, data_len, before, r );
+	return r;
+}
+
+static int ring_buffer_wrap_read( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_READ );
+	int r = wrap( rb )->read( rb, data, data_len );
+	wrapend( wrap( rb ), RING_BUFFER_OP_READ, data_len, before, r );
+	return r;
+}
+
+static int ring_buffer_wrap_write( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_WRITE );
+	int r = wrap( rb )->write( rb, data, data_len );
+	wrapend( wrap( rb ), RING_BUFFER_OP_WRITE, data_len, before, r );
+	return r;
+}
+
+// the input, if it is wrapped as well, sees the transfer through its own skip()
+static int ring_buffer_wrap_send( ring_buffer_t *rb, ring_buffer_t *input, unsigned data_len ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_SEND );
+	int r = wrap( rb )->send( rb, input, data_len );
+	wrapend( wrap( rb ), RING_BUFFER_OP_SEND, data_len, before, r );
+	return r;
+}
+
+static int ring_buffer_wrap_skip( ring_buffer_t *rb, unsigned data_len ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_SKIP );
+	int r = wrap( rb )->skip( rb, data_len );
+	wrapend( wrap( rb ), RING_BUFFER_OP_SKIP, data_len, before, r );
+	return r;
+}
+
+static int ring_buffer_wrap_commit( ring_buffer_t *rb, unsigned data_len ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_COMMIT );
+	int r = wrap( rb )->commit( rb, data_len );
+	wrapend( wrap( rb ), RING_BUFFER_OP_COMMIT, data_len, before, r );
+	return r;
+}
+
+static void ring_buffer_wrap_reset( ring_buffer_t *rb ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_RESET );
+	wrap( rb )->reset( rb );
+	wrapend( wrap( rb ), RING_BUFFER_OP_RESET, 0, before, 0 );
+}
+
+static void ring_buffer_wrap_realign( ring_buffer_t *rb ) {
+	unsigned before = wrapbegin( wrap( rb ), RING_BUFFER_OP_REALIGN );
+	wrap( rb )->realign( rb );
+	wrapend( wrap( rb ), RING_BUFFER_OP_REALIGN, 0, before, 0 );
+}
+
+int ring_buffer_wrap_init( ring_buffer_wrap_t *w, unsigned capacity, void *buffer, unsigned ops, ring_buffer_wrap_before_fn before, ring_buffer_wrap_after_fn after ) {
+	int r;
+
+	if ( NULL == w ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_init( & w->rb, capacity, buffer );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	w->before = before;
+	w->after = after;
+	w->depth = 0;
+
+	w->peek = w->rb.peek;
+	w->read = w->rb.read;
+	w->write = w->rb.write;
+	w->send = w->rb.send;
+	w->skip = w->rb.skip;
+	w->commit = w->rb.commit;
+	w->reset = w->rb.reset;
+	w->realign = w->rb.realign;
+
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_PEEK ) ) {
+		w->rb.peek = ring_buffer_wrap_peek;
+	}
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_READ ) ) {
+		w->rb.read = ring_buffer_wrap_read;
+	}
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_WRITE ) ) {
+		w->rb.write = ring_buffer_wrap_write;
+	}
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_SEND ) ) {
+		w->rb.send = ring_buffer_wrap_send;
+	}
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_SKIP ) ) {
+		w->rb.skip = ring_buffer_wrap_skip;
+	}
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_COMMIT ) ) {
+		w->rb.commit = ring_buffer_wrap_commit;
+	}
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_RESET ) ) {
+		w->rb.reset = ring_buffer_wrap_reset;
+	}
+	if ( ops & RING_BUFFER_OP( RING_BUFFER_OP_REALIGN ) ) {
+		w->rb.realign = ring_buffer_wrap_realign;
+	}
+
+out:
+	return r;
+}
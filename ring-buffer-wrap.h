@@ -0,0 +1,66 @@
+#ifndef RING_BUFFER_WRAP_H_
+#define RING_BUFFER_WRAP_H_
+
+#include "ring-buffer.h"
+
+// The common part of rings that observe their own operations, such as
+// ring_buffer_evt_t or ring_buffer_seq_t. ring_buffer_wrap_init() saves the
+// operations of a plain ring and replaces those selected with wrappers that
+// call before() ahead of the saved operation and after() once it returns.
+// Only the outermost call is reported: when an operation calls another on the
+// same ring, e.g. send() realigning its output, the inner one runs unobserved,
+// as part of the outer one.
+//
+// A decorator's structure starts with RING_BUFFER_WRAP_FIELDS, so that it can
+// be passed as a ring_buffer_wrap_t, and its rb member stays the handle that
+// callers use.
+
+enum {
+	RING_BUFFER_OP_PEEK,
+	RING_BUFFER_OP_READ,
+	RING_BUFFER_OP_WRITE,
+	RING_BUFFER_OP_SEND,
+	RING_BUFFER_OP_SKIP,
+	RING_BUFFER_OP_RESET,
+	RING_BUFFER_OP_REALIGN,
+	RING_BUFFER_OP_COMMIT,
+	RING_BUFFER_NOPS,
+};
+
+#define RING_BUFFER_OP( op ) ( 1u << ( op ) )
+
+#define RING_BUFFER_OPS_ALL ( RING_BUFFER_OP( RING_BUFFER_NOPS ) - 1 )
+// the operations that change the ring's length
+#define RING_BUFFER_OPS_LEN ( RING_BUFFER_OP( RING_BUFFER_OP_READ ) | RING_BUFFER_OP( RING_BUFFER_OP_WRITE ) | RING_BUFFER_OP( RING_BUFFER_OP_SEND ) | RING_BUFFER_OP( RING_BUFFER_OP_SKIP ) | RING_BUFFER_OP( RING_BUFFER_OP_RESET ) | RING_BUFFER_OP( RING_BUFFER_OP_COMMIT ) )
+
+// op is one of RING_BUFFER_OP_*. after() is also given the operation's
+// data_len, the ring's length when it began, and its result; data_len and
+// result are 0 for reset and realign
+typedef void (*ring_buffer_wrap_before_fn)( ring_buffer_t *rb, unsigned op );
+typedef void (*ring_buffer_wrap_after_fn)( ring_buffer_t *rb, unsigned op, unsigned data_len, unsigned before, int result );
+
+#define RING_BUFFER_WRAP_FIELDS \
+	ring_buffer_t                rb; \
+	/* the operations being wrapped */ \
+	int                        (*peek)( ring_buffer_t *rb, void *data, unsigned data_len ); \
+	int                        (*read)( ring_buffer_t *rb, void *data, unsigned data_len ); \
+	int                        (*write)( ring_buffer_t *rb, void *data, unsigned data_len ); \
+	int                        (*send)( ring_buffer_t *rb, ring_buffer_t *input, unsigned data_len ); \
+	int                        (*skip)( ring_buffer_t *rb, unsigned data_len ); \
+	int                        (*commit)( ring_buffer_t *rb, unsigned data_len ); \
+	void                       (*reset)( ring_buffer_t *rb ); \
+	void                       (*realign)( ring_buffer_t *rb ); \
+	/* either may be NULL */ \
+	ring_buffer_wrap_before_fn   before; \
+	ring_buffer_wrap_after_fn    after; \
+	/* wrapped calls in progress; only the outermost is reported */ \
+	unsigned                     depth;
+
+typedef struct {
+	RING_BUFFER_WRAP_FIELDS
+} ring_buffer_wrap_t;
+
+// initialise w->rb as a plain ring, then wrap the operations in ops, a mask of RING_BUFFER_OP()s
+int ring_buffer_wrap_init( ring_buffer_wrap_t *w, unsigned capacity, void *buffer, unsigned ops, ring_buffer_wrap_before_fn before, ring_buffer_wrap_after_fn after );
+
+#endif /* RING_BUFFER_WRAP_H_ */
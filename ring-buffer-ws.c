@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ring-buffer-ws.h"
+
+static inline void **wsslot( ring_buffer_ws_t *ws, int64_t i ) {
+	return & ws->buffer[ (uint64_t) i % ws->capacity ];
+}
+
+int ring_buffer_ws_init( ring_buffer_ws_t *ws, unsigned capacity, void **buffer ) {
+	int r;
+
+	if ( NULL == ws || NULL == buffer || 0 == capacity ) {
+		r = -1;
+		goto out;
+	}
+
+	ws->capacity = capacity;
+	ws->buffer = buffer;
+	ws->top = 0;
+	ws->bottom = 0;
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_ws_push( ring_buffer_ws_t *ws, void *item ) {
+	int r;
+	int64_t b;
+	int64_t t;
+
+	if ( NULL == ws ) {
+		r = -1;
+		goto out;
+	}
+
+	b = __atomic_load_n( & ws->bottom, __ATOMIC_RELAXED );
+	t = __atomic_load_n( & ws->top, __ATOMIC_ACQUIRE );
+	if ( b - t >= (int64_t) ws->capacity ) {
+		r = -1;
+		goto out;
+	}
+
+	__atomic_store_n( wsslot( ws, b ), item, __ATOMIC_RELAXED );
+	// a thief that sees the new bottom also sees the item
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+	__atomic_store_n( & ws->bottom, b + 1, __ATOMIC_RELAXED );
+
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_ws_pop( ring_buffer_ws_t *ws, void **item ) {
+	int r;
+	int64_t b;
+	int64_t t;
+	void *x;
+
+	if ( NULL == ws || NULL == item ) {
+		r = -1;
+		goto out;
+	}
+
+	// reserve the bottom element before looking at top, so that a thief
+	// either sees the reservation or is seen by us
+	b = __atomic_load_n( & ws->bottom, __ATOMIC_RELAXED ) - 1;
+	__atomic_store_n( & ws->bottom, b, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_SEQ_CST );
+	t = __atomic_load_n( & ws->top, __ATOMIC_RELAXED );
+
+	if ( t > b ) {
+		// empty
+		__atomic_store_n( & ws->bottom, b + 1, __ATOMIC_RELAXED );
+		r = -1;
+		goto out;
+	}
+
+	x = __atomic_load_n( wsslot( ws, b ), __ATOMIC_RELAXED );
+	r = EXIT_SUCCESS;
+	if ( t == b ) {
+		// the last element: race the thieves for it
+		if ( ! __atomic_compare_exchange_n( & ws->top, & t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ) ) {
+			r = -1;
+		}
+		__atomic_store_n( & ws->bottom, b + 1, __ATOMIC_RELAXED );
+	}
+	if ( EXIT_SUCCESS == r ) {
+		*item = x;
+	}
+
+out:
+	return r;
+}
+
+int ring_buffer_ws_steal( ring_buffer_ws_t *ws, void **item ) {
+	int r;
+	int64_t b;
+	int64_t t;
+	void *x;
+
+	if ( NULL == ws || NULL == item ) {
+		r = -1;
+		goto out;
+	}
+
+	t = __atomic_load_n( & ws->top, __ATOMIC_ACQUIRE );
+	__atomic_thread_fence( __ATOMIC_SEQ_CST );
+	b = __atomic_load_n( & ws->bottom, __ATOMIC_ACQUIRE );
+	if ( t >= b ) {
+		r = -1;
+		goto out;
+	}
+
+	// read before claiming: once top moves, the owner may overwrite the slot
+	x = __atomic_load_n( wsslot( ws, t ), __ATOMIC_RELAXED );
+	if ( ! __atomic_compare_exchange_n( & ws->top, & t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ) ) {
+		r = -EAGAIN;
+		goto out;
+	}
+
+	*item = x;
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+unsigned ring_buffer_ws_size( ring_buffer_ws_t *ws ) {
+	unsigned r;
+	int64_t b;
+	int64_t t;
+
+	r = 0;
+	if ( NULL == ws ) {
+		goto out;
+	}
+
+	b = __atomic_load_n( & ws->bottom, __ATOMIC_RELAXED );
+	t = __atomic_load_n( & ws->top, __ATOMIC_RELAXED );
+	r = b > t ? b - t : 0;
+
+out:
+	return r;
+}
@@ -0,0 +1,43 @@
+#ifndef RING_BUFFER_WS_H_
+#define RING_BUFFER_WS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+
+// A fixed-capacity Chase-Lev work-stealing deque of pointers, after Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013).
+// The owning thread pushes and pops at the bottom, like a stack; any other
+// thread may steal from the top, lock-free. Storage is supplied by the
+// caller, as for ring_buffer_t, and may be declared together with the
+// header using RING_BUFFER_WS_DECL_CONTIG().
+
+#define RING_BUFFER_WS_CACHELINE 64
+
+typedef struct {
+	unsigned         capacity;
+	void           **buffer;
+	// the next element to be stolen; written by thieves, and by the owner when taking the last element
+	int64_t          top __attribute__(( aligned( RING_BUFFER_WS_CACHELINE ) ));
+	// one past the owner's last element; written only by the owner
+	int64_t          bottom __attribute__(( aligned( RING_BUFFER_WS_CACHELINE ) ));
+} ring_buffer_ws_t;
+
+#define RING_BUFFER_WS_DECL_CONTIG( cap, name ) \
+uint8_t name ## _buffer[ sizeof( ring_buffer_ws_t ) + ( cap ) * sizeof( void * ) ] __attribute__(( aligned( RING_BUFFER_WS_CACHELINE ) ))
+
+#define RING_BUFFER_WS_CONTIG_HANDLE( name ) ( (ring_buffer_ws_t *) name ## _buffer )
+#define RING_BUFFER_WS_CONTIG_BUFFER( name ) ( (void **)( name ## _buffer + sizeof( ring_buffer_ws_t ) ) )
+
+int ring_buffer_ws_init( ring_buffer_ws_t *ws, unsigned capacity, void **buffer );
+
+// owner only. returns -1 when full
+int ring_buffer_ws_push( ring_buffer_ws_t *ws, void *item );
+// owner only: the most recently pushed item. returns -1 when empty
+int ring_buffer_ws_pop( ring_buffer_ws_t *ws, void **item );
+// any thread: the least recently pushed item. returns -1 when empty, or -EAGAIN after losing a race, which is worth retrying
+int ring_buffer_ws_steal( ring_buffer_ws_t *ws, void **item );
+// a snapshot, exact only when the deque is quiescent
+unsigned ring_buffer_ws_size( ring_buffer_ws_t *ws );
+
+#endif /* RING_BUFFER_WS_H_ */
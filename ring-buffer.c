@@ -8,6 +8,13 @@
 
 #include "array-utils.h"
 
+#include "crc32c.h"
+
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#define RB_X86
+#include <immintrin.h>
+#endif // defined( __GNUC__ ) && defined( __x86_64__ )
+
 // same as ring_buffer_available()
 static inline unsigned rbavail( ring_buffer_t *rb ) {
 	unsigned r;
@@ -43,7 +50,6 @@ static int      ring_buffer_peek( ring_buffer_t *rb, void *data, unsigned data_l
 static int      ring_buffer_read( ring_buffer_t *rb, void *data, unsigned data_len );
 static int      ring_buffer_write( ring_buffer_t *rb, void *data, unsigned data_len );
 static int      ring_buffer_send( ring_buffer_t *out, ring_buffer_t *in, unsigned data_len );
-static int      ring_buffer_skip( ring_buffer_t *rb, unsigned data_len );
 static unsigned ring_buffer_size( ring_buffer_t *rb );
 static unsigned ring_buffer_available( ring_buffer_t *rb );
 static void     ring_buffer_reset( ring_buffer_t *rb );
@@ -65,7 +71,8 @@ int ring_buffer_init( ring_buffer_t *rb, unsigned capacity, void *buffer ) {
 	rb->read = ring_buffer_read;
 	rb->write = ring_buffer_write;
 	rb->send = ring_buffer_send;
-	rb->skip = ring_buffer_skip;
+	rb->skip = ring_buffer_plain_skip;
+	rb->commit = ring_buffer_plain_commit;
 	rb->size = ring_buffer_size;
 	rb->available = ring_buffer_available;
 	rb->reset = ring_buffer_reset;
@@ -109,7 +116,7 @@ static int ring_buffer_read( ring_buffer_t *rb, void *data, unsigned data_len )
 	int r;
 	r = ring_buffer_peek( rb, data, data_len );
 	if ( r > 0 ) {
-		ring_buffer_skip( rb, r );
+		ring_buffer_plain_skip( rb, r );
 	}
 	return r;
 }
@@ -149,9 +156,9 @@ static int ring_buffer_send( ring_buffer_t *out, ring_buffer_t *in, unsigned dat
 
 	int r;
 
-	unsigned orig_head_in;
 	unsigned orig_head_out;
 	unsigned tail_out;
+	unsigned t1;
 
 	if ( NULL == out || NULL == in ) {
 		r = -1;
@@ -165,23 +172,23 @@ static int ring_buffer_send( ring_buffer_t *out, ring_buffer_t *in, unsigned dat
 	}
 
 	orig_head_out = out->head;
-	orig_head_in = in->head;
 
-	// XXX: @CF: FIXME: Realigning both buffers simplifies the op, but is not optimized
+	// XXX: @CF: FIXME: Realigning the output simplifies the op, but is not optimized
 	out->realign( out );
-	in->realign( in );
 
+	// the input is copied in place, in up to two pieces, so that it only
+	// ever changes through its own skip() below
 	tail_out = rbtail( out );
-	memcpy( & ( (uint8_t *)out->buffer )[ tail_out ], & ( (uint8_t *)in->buffer )[ 0 ], r );
+	t1 = min( (unsigned) r, in->capacity - in->head );
+	memcpy( & ( (uint8_t *)out->buffer )[ tail_out ], & ( (uint8_t *)in->buffer )[ in->head ], t1 );
+	memcpy( & ( (uint8_t *)out->buffer )[ tail_out + t1 ], & ( (uint8_t *)in->buffer )[ 0 ], r - t1 );
 
 	// update output length
 	out->len += r;
 
-	// XXX: @CF: FIXME: Realigning requires that both heads are put back where they came from
+	// XXX: @CF: FIXME: Realigning requires that the head is put back where it came from
 	array_shift_u8( out->buffer, out->capacity, orig_head_out );
 	out->head = orig_head_out;
-	array_shift_u8( in->buffer, in->capacity, orig_head_in );
-	in->head = orig_head_in;
 
 	// advance input by r
 	in->skip( in, r );
@@ -190,7 +197,7 @@ out:
 	return r;
 }
 
-static int ring_buffer_skip( ring_buffer_t *rb, unsigned data_len ) {
+int ring_buffer_plain_skip( ring_buffer_t *rb, unsigned data_len ) {
 	int r;
 
 	if ( NULL == rb ) {
@@ -211,6 +218,21 @@ out:
 	return r;
 }
 
+int ring_buffer_plain_commit( ring_buffer_t *rb, unsigned data_len ) {
+	int r;
+
+	if ( NULL == rb ) {
+		r = -1;
+		goto out;
+	}
+
+	r = min( rbavail( rb ), data_len );
+	rb->len += r;
+
+out:
+	return r;
+}
+
 static unsigned ring_buffer_size( ring_buffer_t *rb ) {
 	unsigned r;
 
@@ -233,7 +255,9 @@ static void ring_buffer_reset( ring_buffer_t *rb ) {
 	if ( NULL == rb ) {
 		goto out;
 	}
-	ring_buffer_init( rb, rb->capacity, rb->buffer );
+	// leave the operations alone, so that rings with overridden operations keep them
+	rb->head = 0;
+	rb->len = 0;
 out:
 	return;
 }
@@ -255,3 +279,948 @@ static void ring_buffer_realign( ring_buffer_t *rb ) {
 out:
 	return;
 }
+
+/*###########################################################################
+  #                            PATTERN SEARCH
+  ###########################################################################*/
+
+// the first occurrence of pat that lies entirely within p[ 0 .. n ), or NULL
+typedef const uint8_t *(*rbmemmem_fn)( const uint8_t *p, unsigned n, const uint8_t *pat, unsigned plen );
+
+static const uint8_t *rbmemmem_scalar( const uint8_t *p, unsigned n, const uint8_t *pat, unsigned plen ) {
+	const uint8_t *r;
+	const uint8_t *end;
+
+	r = NULL;
+
+	if ( plen > n ) {
+		goto out;
+	}
+
+	// memchr() is already vectorized by any libc worth using
+	for( end = p + n - plen + 1; p < end; p = r + 1 ) {
+		r = (const uint8_t *) memchr( p, pat[ 0 ], end - p );
+		if ( NULL == r || 0 == memcmp( r + 1, pat + 1, plen - 1 ) ) {
+			goto out;
+		}
+	}
+	r = NULL;
+
+out:
+	return r;
+}
+
+#ifdef RB_X86
+
+// compare the first and last byte of the pattern against 16 (or 32) candidate
+// positions at once, and only memcmp() the middle of those that match both
+
+__attribute__(( target( "sse2" ) ))
+static const uint8_t *rbmemmem_sse2( const uint8_t *p, unsigned n, const uint8_t *pat, unsigned plen ) {
+	const uint8_t *r;
+	unsigned i;
+	unsigned mask;
+	__m128i first, last, a, b;
+
+	r = NULL;
+
+	if ( plen < 2 || plen > n ) {
+		r = rbmemmem_scalar( p, n, pat, plen );
+		goto out;
+	}
+
+	first = _mm_set1_epi8( pat[ 0 ] );
+	last = _mm_set1_epi8( pat[ plen - 1 ] );
+	for( i = 0; i + plen - 1 + 16 <= n; i += 16 ) {
+		a = _mm_loadu_si128( (const __m128i *) & p[ i ] );
+		b = _mm_loadu_si128( (const __m128i *) & p[ i + plen - 1 ] );
+		mask = _mm_movemask_epi8( _mm_and_si128( _mm_cmpeq_epi8( a, first ), _mm_cmpeq_epi8( b, last ) ) );
+		for( ; 0 != mask; mask &= mask - 1 ) {
+			r = & p[ i + __builtin_ctz( mask ) ];
+			if ( 0 == memcmp( r + 1, pat + 1, plen - 2 ) ) {
+				goto out;
+			}
+		}
+	}
+	r = rbmemmem_scalar( & p[ i ], n - i, pat, plen );
+
+out:
+	return r;
+}
+
+__attribute__(( target( "avx2" ) ))
+static const uint8_t *rbmemmem_avx2( const uint8_t *p, unsigned n, const uint8_t *pat, unsigned plen ) {
+	const uint8_t *r;
+	unsigned i;
+	unsigned mask;
+	__m256i first, last, a, b;
+
+	r = NULL;
+
+	if ( plen < 2 || plen > n ) {
+		r = rbmemmem_scalar( p, n, pat, plen );
+		goto out;
+	}
+
+	first = _mm256_set1_epi8( pat[ 0 ] );
+	last = _mm256_set1_epi8( pat[ plen - 1 ] );
+	for( i = 0; i + plen - 1 + 32 <= n; i += 32 ) {
+		a = _mm256_loadu_si256( (const __m256i *) & p[ i ] );
+		b = _mm256_loadu_si256( (const __m256i *) & p[ i + plen - 1 ] );
+		mask = _mm256_movemask_epi8( _mm256_and_si256( _mm256_cmpeq_epi8( a, first ), _mm256_cmpeq_epi8( b, last ) ) );
+		for( ; 0 != mask; mask &= mask - 1 ) {
+			r = & p[ i + __builtin_ctz( mask ) ];
+			if ( 0 == memcmp( r + 1, pat + 1, plen - 2 ) ) {
+				goto out;
+			}
+		}
+	}
+	r = rbmemmem_sse2( & p[ i ], n - i, pat, plen );
+
+out:
+	return r;
+}
+
+#endif // RB_X86
+
+static const uint8_t *rbmemmem( const uint8_t *p, unsigned n, const uint8_t *pat, unsigned plen ) {
+	static rbmemmem_fn impl;
+	rbmemmem_fn fn;
+
+	fn = __atomic_load_n( & impl, __ATOMIC_RELAXED );
+	if ( NULL == fn ) {
+		fn = rbmemmem_scalar;
+#ifdef RB_X86
+		__builtin_cpu_init();
+		if ( __builtin_cpu_supports( "avx2" ) ) {
+			fn = rbmemmem_avx2;
+		} else if ( __builtin_cpu_supports( "sse2" ) ) {
+			fn = rbmemmem_sse2;
+		}
+#endif // RB_X86
+		__atomic_store_n( & impl, fn, __ATOMIC_RELAXED );
+	}
+
+	return fn( p, n, pat, plen );
+}
+
+// search the logical range [ start, end ) of the live data in place
+static int rbfind( ring_buffer_t *rb, const uint8_t *pat, unsigned plen, unsigned start, unsigned end ) {
+	int r;
+	const uint8_t *buf;
+	const uint8_t *q;
+	unsigned pos;
+	unsigned n1, n2;
+	unsigned i;
+
+	r = -1;
+
+	if ( 0 == plen || start >= end || end - start < plen ) {
+		goto out;
+	}
+
+	buf = (const uint8_t *) rb->buffer;
+	pos = ( rb->head + start ) % rb->capacity;
+	n1 = min( end - start, rb->capacity - pos );
+	n2 = end - start - n1;
+
+	// matches entirely before the wrap point
+	q = rbmemmem( & buf[ pos ], n1, pat, plen );
+	if ( NULL != q ) {
+		r = start + ( q - & buf[ pos ] );
+		goto out;
+	}
+
+	if ( 0 == n2 ) {
+		goto out;
+	}
+
+	// matches straddling the wrap point
+	for( i = n1 > plen - 1 ? n1 - ( plen - 1 ) : 0; i < n1; i++ ) {
+		if (
+			plen - ( n1 - i ) <= n2
+			&& 0 == memcmp( & buf[ pos + i ], pat, n1 - i )
+			&& 0 == memcmp( & buf[ 0 ], & pat[ n1 - i ], plen - ( n1 - i ) )
+		) {
+			r = start + i;
+			goto out;
+		}
+	}
+
+	// matches entirely after the wrap point
+	q = rbmemmem( & buf[ 0 ], n2, pat, plen );
+	if ( NULL != q ) {
+		r = start + n1 + ( q - & buf[ 0 ] );
+	}
+
+out:
+	return r;
+}
+
+int ring_buffer_find( ring_buffer_t *rb, const void *pattern, unsigned pattern_len, unsigned start ) {
+	int r;
+
+	if ( NULL == rb || NULL == pattern ) {
+		r = -1;
+		goto out;
+	}
+
+	r = rbfind( rb, (const uint8_t *) pattern, pattern_len, start, rb->len );
+
+out:
+	return r;
+}
+
+int ring_buffer_read_until( ring_buffer_t *rb, const void *delim, unsigned delim_len, void *data, unsigned data_len ) {
+	int r;
+
+	if ( NULL == rb || NULL == delim || NULL == data || 0 == delim_len ) {
+		r = -1;
+		goto out;
+	}
+
+	// a frame that cannot fit in data is not searched for past data_len
+	r = rbfind( rb, (const uint8_t *) delim, delim_len, 0, min( rb->len, data_len ) );
+	if ( -1 == r ) {
+		r = 0;
+		goto out;
+	}
+
+	r = rb->read( rb, data, r + delim_len );
+
+out:
+	return r;
+}
+
+/*###########################################################################
+  #                            CHECKSUMMING COPIES
+  ###########################################################################*/
+
+int ring_buffer_write_crc32c( ring_buffer_t *rb, void *data, unsigned data_len, uint32_t *crc ) {
+	int r;
+	unsigned tail;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data || NULL == crc ) {
+		r = -1;
+		goto out;
+	}
+
+	r = min( rbavail( rb ), data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	tail = rbtail( rb );
+	t1 = min( (unsigned) r, rb->capacity - tail );
+	*crc = crc32c_copy( *crc, & ( (uint8_t *)rb->buffer )[ tail ], data, t1 );
+	*crc = crc32c_copy( *crc, & ( (uint8_t *)rb->buffer )[ 0 ], & ( (uint8_t *) data )[ t1 ], r - t1 );
+
+	rb->commit( rb, r );
+
+out:
+	return r;
+}
+
+int ring_buffer_read_crc32c( ring_buffer_t *rb, void *data, unsigned data_len, uint32_t *crc ) {
+	int r;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data || NULL == crc ) {
+		r = -1;
+		goto out;
+	}
+
+	r = min( rb->len, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	t1 = min( (unsigned) r, rb->capacity - rb->head );
+	*crc = crc32c_copy( *crc, data, & ( (uint8_t *)rb->buffer )[ rb->head ], t1 );
+	*crc = crc32c_copy( *crc, & ( (uint8_t *) data )[ t1 ], & ( (uint8_t *)rb->buffer )[ 0 ], r - t1 );
+
+	rb->skip( rb, r );
+
+out:
+	return r;
+}
+
+uint32_t ring_buffer_crc32c( ring_buffer_t *rb, uint32_t crc, unsigned offset, unsigned len ) {
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == rb || offset >= rb->len ) {
+		goto out;
+	}
+
+	len = min( len, rb->len - offset );
+	pos = ( rb->head + offset ) % rb->capacity;
+	t1 = min( len, rb->capacity - pos );
+	crc = crc32c( crc, & ( (uint8_t *)rb->buffer )[ pos ], t1 );
+	crc = crc32c( crc, & ( (uint8_t *)rb->buffer )[ 0 ], len - t1 );
+
+out:
+	return crc;
+}
+
+/*###########################################################################
+  #                            SCATTER / GATHER
+  ###########################################################################*/
+
+// the total length of an iovec array, or -1 if it is invalid
+static long rbiovlen( const struct iovec *iov, int iovcnt ) {
+	long r;
+	int i;
+
+	if ( iovcnt < 0 || ( iovcnt > 0 && NULL == iov ) ) {
+		r = -1;
+		goto out;
+	}
+
+	for( r = 0, i = 0; i < iovcnt; i++ ) {
+		if ( NULL == iov[ i ].iov_base && 0 != iov[ i ].iov_len ) {
+			r = -1;
+			goto out;
+		}
+		r += iov[ i ].iov_len;
+	}
+
+out:
+	return r;
+}
+
+int ring_buffer_writev( ring_buffer_t *rb, const struct iovec *iov, int iovcnt, int all_or_nothing ) {
+	int r;
+	long total;
+	unsigned pos;
+	unsigned left;
+	unsigned n;
+	unsigned t1;
+	int i;
+
+	total = rbiovlen( iov, iovcnt );
+	if ( NULL == rb || -1 == total ) {
+		r = -1;
+		goto out;
+	}
+
+	r = min( (unsigned long) rbavail( rb ), (unsigned long) total );
+	if ( 0 == r || ( all_or_nothing && r < total ) ) {
+		r = 0;
+		goto out;
+	}
+
+	pos = rbtail( rb );
+	for( i = 0, left = r; left > 0; i++ ) {
+		// an empty fragment may well have a NULL base
+		if ( 0 == iov[ i ].iov_len ) {
+			continue;
+		}
+		n = min( left, iov[ i ].iov_len );
+		t1 = min( n, rb->capacity - pos );
+		memcpy( & ( (uint8_t *)rb->buffer )[ pos ], iov[ i ].iov_base, t1 );
+		if ( t1 < n ) {
+			memcpy( & ( (uint8_t *)rb->buffer )[ 0 ], & ( (uint8_t *) iov[ i ].iov_base )[ t1 ], n - t1 );
+		}
+		pos = t1 < n ? n - t1 : pos + n;
+		left -= n;
+	}
+
+	rb->commit( rb, r );
+
+out:
+	return r;
+}
+
+int ring_buffer_readv( ring_buffer_t *rb, const struct iovec *iov, int iovcnt, int all_or_nothing ) {
+	int r;
+	long total;
+	unsigned pos;
+	unsigned left;
+	unsigned n;
+	unsigned t1;
+	int i;
+
+	total = rbiovlen( iov, iovcnt );
+	if ( NULL == rb || -1 == total ) {
+		r = -1;
+		goto out;
+	}
+
+	r = min( (unsigned long) rb->len, (unsigned long) total );
+	if ( 0 == r || ( all_or_nothing && r < total ) ) {
+		r = 0;
+		goto out;
+	}
+
+	pos = rb->head;
+	for( i = 0, left = r; left > 0; i++ ) {
+		// an empty fragment may well have a NULL base
+		if ( 0 == iov[ i ].iov_len ) {
+			continue;
+		}
+		n = min( left, iov[ i ].iov_len );
+		t1 = min( n, rb->capacity - pos );
+		memcpy( iov[ i ].iov_base, & ( (uint8_t *)rb->buffer )[ pos ], t1 );
+		if ( t1 < n ) {
+			memcpy( & ( (uint8_t *) iov[ i ].iov_base )[ t1 ], & ( (uint8_t *)rb->buffer )[ 0 ], n - t1 );
+		}
+		pos = t1 < n ? n - t1 : pos + n;
+		left -= n;
+	}
+
+	rb->skip( rb, r );
+
+out:
+	return r;
+}
+
+/*###########################################################################
+  #                            STREAMING COPIES
+  ###########################################################################*/
+
+#define RB_CACHELINE 64
+
+// copy without pulling the destination into the cache. the caller must issue
+// rbstream_fence() before publishing the data to another thread
+static void rbcopy_nt( void *dst, const void *src, unsigned n ) {
+#ifdef RB_X86
+	uint8_t *d;
+	const uint8_t *s;
+	unsigned t;
+
+	d = (uint8_t *) dst;
+	s = (const uint8_t *) src;
+
+	// streaming stores need an aligned destination
+	t = min( n, ( RB_CACHELINE - ( (uintptr_t) d & ( RB_CACHELINE - 1 ) ) ) & ( RB_CACHELINE - 1 ) );
+	memcpy( d, s, t );
+	d += t;
+	s += t;
+	n -= t;
+
+	for( ; n >= RB_CACHELINE; n -= RB_CACHELINE, d += RB_CACHELINE, s += RB_CACHELINE ) {
+		_mm_stream_si128( (__m128i *) & d[ 0 ], _mm_loadu_si128( (const __m128i *) & s[ 0 ] ) );
+		_mm_stream_si128( (__m128i *) & d[ 16 ], _mm_loadu_si128( (const __m128i *) & s[ 16 ] ) );
+		_mm_stream_si128( (__m128i *) & d[ 32 ], _mm_loadu_si128( (const __m128i *) & s[ 32 ] ) );
+		_mm_stream_si128( (__m128i *) & d[ 48 ], _mm_loadu_si128( (const __m128i *) & s[ 48 ] ) );
+	}
+
+	memcpy( d, s, n );
+#else
+	memcpy( dst, src, n );
+#endif // RB_X86
+}
+
+// order streaming stores before any later store, e.g. the one that publishes them
+static inline void rbstream_fence( void ) {
+#ifdef RB_X86
+	_mm_sfence();
+#endif // RB_X86
+}
+
+// an ordinary copy that prefetches the source prefetch bytes ahead
+static void rbcopy_prefetch( void *dst, const void *src, unsigned n, unsigned prefetch ) {
+	uint8_t *d;
+	const uint8_t *s;
+	unsigned i;
+	unsigned t;
+
+	d = (uint8_t *) dst;
+	s = (const uint8_t *) src;
+
+	for( i = 0; i < n; i += t ) {
+		if ( i + prefetch < n ) {
+			__builtin_prefetch( & s[ i + prefetch ], 0, 0 );
+		}
+		t = min( n - i, RB_CACHELINE );
+		memcpy( & d[ i ], & s[ i ], t );
+	}
+}
+
+int ring_buffer_write_nt( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	int r;
+	unsigned tail;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	r = min( rbavail( rb ), data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	tail = rbtail( rb );
+	t1 = min( (unsigned) r, rb->capacity - tail );
+	rbcopy_nt( & ( (uint8_t *)rb->buffer )[ tail ], data, t1 );
+	rbcopy_nt( & ( (uint8_t *)rb->buffer )[ 0 ], & ( (uint8_t *) data )[ t1 ], r - t1 );
+	rbstream_fence();
+
+	rb->commit( rb, r );
+
+out:
+	return r;
+}
+
+int ring_buffer_read_prefetch( ring_buffer_t *rb, void *data, unsigned data_len, unsigned prefetch ) {
+	int r;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	r = min( rb->len, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	prefetch = 0 == prefetch ? RING_BUFFER_STREAM_PREFETCH : prefetch;
+	t1 = min( (unsigned) r, rb->capacity - rb->head );
+	rbcopy_prefetch( data, & ( (uint8_t *)rb->buffer )[ rb->head ], t1, prefetch );
+	rbcopy_prefetch( & ( (uint8_t *) data )[ t1 ], & ( (uint8_t *)rb->buffer )[ 0 ], r - t1, prefetch );
+
+	rb->skip( rb, r );
+
+out:
+	return r;
+}
+
+static int ring_buffer_stream_write( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	ring_buffer_stream_t *s = RING_BUFFER_CONTAINER( rb, ring_buffer_stream_t, rb );
+	if ( data_len >= s->threshold ) {
+		return ring_buffer_write_nt( rb, data, data_len );
+	}
+	return ring_buffer_write( rb, data, data_len );
+}
+
+static int ring_buffer_stream_read( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	ring_buffer_stream_t *s = RING_BUFFER_CONTAINER( rb, ring_buffer_stream_t, rb );
+	if ( data_len >= s->threshold && 0 != s->prefetch ) {
+		return ring_buffer_read_prefetch( rb, data, data_len, s->prefetch );
+	}
+	return ring_buffer_read( rb, data, data_len );
+}
+
+int ring_buffer_stream_init( ring_buffer_stream_t *s, unsigned capacity, void *buffer, unsigned threshold, unsigned prefetch ) {
+	int r;
+
+	if ( NULL == s ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_init( & s->rb, capacity, buffer );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+
+	s->threshold = 0 == threshold ? RING_BUFFER_STREAM_THRESHOLD : threshold;
+	s->prefetch = prefetch;
+
+	s->rb.write = ring_buffer_stream_write;
+	s->rb.read = ring_buffer_stream_read;
+
+out:
+	return r;
+}
+
+/*###########################################################################
+  #                            ENCODING
+  ###########################################################################*/
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define rble( _bits, x ) ( x )
+#define rbbe( _bits, x ) __builtin_bswap ## _bits( x )
+#else
+#define rble( _bits, x ) __builtin_bswap ## _bits( x )
+#define rbbe( _bits, x ) ( x )
+#endif
+
+// the index of the element offset past the head, for offset <= capacity
+static inline unsigned rbpos( ring_buffer_t *rb, unsigned offset ) {
+	unsigned r = rb->head + offset;
+	return r >= rb->capacity ? r - rb->capacity : r;
+}
+
+// copy n bytes in at the encoder's position. for a constant n, the
+// non-wrapping case inlines to a single unaligned store
+static inline int rbput( ring_buffer_codec_t *c, const void *data, unsigned n ) {
+	int r;
+	unsigned pos;
+	unsigned t1;
+	uint8_t *buf;
+
+	if ( c->error || n > rbavail( c->rb ) - c->pos ) {
+		c->error = 1;
+		r = -1;
+		goto out;
+	}
+
+	buf = c->rb->buffer;
+	pos = rbpos( c->rb, c->rb->len + c->pos );
+	if ( pos + n <= c->rb->capacity ) {
+		memcpy( & buf[ pos ], data, n );
+	} else {
+		t1 = c->rb->capacity - pos;
+		memcpy( & buf[ pos ], data, t1 );
+		memcpy( & buf[ 0 ], & ( (const uint8_t *) data )[ t1 ], n - t1 );
+	}
+	c->pos += n;
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+// copy n bytes out from the decoder's position, without advancing it
+static inline int rbget( ring_buffer_codec_t *c, void *data, unsigned n ) {
+	int r;
+	unsigned pos;
+	unsigned t1;
+	uint8_t *buf;
+
+	if ( c->error || n > c->rb->len - c->pos ) {
+		c->error = 1;
+		r = -1;
+		goto out;
+	}
+
+	buf = c->rb->buffer;
+	pos = rbpos( c->rb, c->pos );
+	if ( pos + n <= c->rb->capacity ) {
+		memcpy( data, & buf[ pos ], n );
+	} else {
+		t1 = c->rb->capacity - pos;
+		memcpy( data, & buf[ pos ], t1 );
+		memcpy( & ( (uint8_t *) data )[ t1 ], & buf[ 0 ], n - t1 );
+	}
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+#define RING_BUFFER_PUT( _bits, _endian ) \
+int ring_buffer_put_u ## _bits ## _endian( ring_buffer_codec_t *c, uint ## _bits ## _t v ) { \
+	int r; \
+	if ( NULL == c ) { \
+		r = -1; \
+		goto out; \
+	} \
+	v = rb ## _endian( _bits, v ); \
+	r = rbput( c, & v, sizeof( v ) ); \
+out: \
+	return r; \
+}
+
+#define RING_BUFFER_GET( _bits, _endian ) \
+int ring_buffer_get_u ## _bits ## _endian( ring_buffer_codec_t *c, uint ## _bits ## _t *v ) { \
+	int r; \
+	uint ## _bits ## _t x; \
+	if ( NULL == c || NULL == v ) { \
+		r = -1; \
+		goto out; \
+	} \
+	r = rbget( c, & x, sizeof( x ) ); \
+	if ( EXIT_SUCCESS == r ) { \
+		*v = rb ## _endian( _bits, x ); \
+		c->pos += sizeof( x ); \
+	} \
+out: \
+	return r; \
+}
+
+RING_BUFFER_PUT( 16, le );
+RING_BUFFER_PUT( 32, le );
+RING_BUFFER_PUT( 64, le );
+RING_BUFFER_PUT( 16, be );
+RING_BUFFER_PUT( 32, be );
+RING_BUFFER_PUT( 64, be );
+
+RING_BUFFER_GET( 16, le );
+RING_BUFFER_GET( 32, le );
+RING_BUFFER_GET( 64, le );
+RING_BUFFER_GET( 16, be );
+RING_BUFFER_GET( 32, be );
+RING_BUFFER_GET( 64, be );
+
+int ring_buffer_encode_begin( ring_buffer_codec_t *c, ring_buffer_t *rb ) {
+	int r;
+
+	if ( NULL == c || NULL == rb ) {
+		r = -1;
+		goto out;
+	}
+
+	c->rb = rb;
+	c->pos = 0;
+	c->error = 0;
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_encode_commit( ring_buffer_codec_t *c ) {
+	int r;
+
+	if ( NULL == c || c->error ) {
+		r = -1;
+		goto out;
+	}
+
+	c->rb->commit( c->rb, c->pos );
+	r = c->pos;
+	c->pos = 0;
+
+out:
+	return r;
+}
+
+int ring_buffer_decode_begin( ring_buffer_codec_t *c, ring_buffer_t *rb ) {
+	return ring_buffer_encode_begin( c, rb );
+}
+
+int ring_buffer_decode_commit( ring_buffer_codec_t *c ) {
+	int r;
+
+	if ( NULL == c || c->error ) {
+		r = -1;
+		goto out;
+	}
+
+	c->rb->skip( c->rb, c->pos );
+	r = c->pos;
+	c->pos = 0;
+
+out:
+	return r;
+}
+
+int ring_buffer_put_varint( ring_buffer_codec_t *c, uint64_t v ) {
+	int r;
+	uint8_t tmp[ 10 ];
+	unsigned n;
+
+	if ( NULL == c ) {
+		r = -1;
+		goto out;
+	}
+
+	for( n = 0; v > 0x7f; n++, v >>= 7 ) {
+		tmp[ n ] = 0x80 | ( v & 0x7f );
+	}
+	tmp[ n++ ] = v;
+	r = rbput( c, tmp, n );
+
+out:
+	return r;
+}
+
+int ring_buffer_get_varint( ring_buffer_codec_t *c, uint64_t *v ) {
+	int r;
+	uint64_t x;
+	unsigned i;
+	uint8_t b;
+
+	if ( NULL == c || NULL == v || c->error ) {
+		r = -1;
+		goto out;
+	}
+
+	for( i = 0, x = 0; ; i++ ) {
+		// incomplete
+		if ( c->pos + i >= c->rb->len ) {
+			c->error = 1;
+			r = -1;
+			goto out;
+		}
+		b = ( (uint8_t *) c->rb->buffer )[ rbpos( c->rb, c->pos + i ) ];
+		// the 10th byte holds bit 63 alone, and must be the last
+		if ( 9 == i && b > 1 ) {
+			c->error = 1;
+			r = -1;
+			goto out;
+		}
+		x |= (uint64_t)( b & 0x7f ) << ( 7 * i );
+		if ( ! ( b & 0x80 ) ) {
+			break;
+		}
+	}
+
+	*v = x;
+	c->pos += i + 1;
+	r = EXIT_SUCCESS;
+
+out:
+	return r;
+}
+
+int ring_buffer_put_bytes( ring_buffer_codec_t *c, const void *data, unsigned data_len ) {
+	int r;
+
+	if ( NULL == c || ( NULL == data && 0 != data_len ) ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_put_varint( c, data_len );
+	if ( EXIT_SUCCESS != r || 0 == data_len ) {
+		goto out;
+	}
+	r = rbput( c, data, data_len );
+
+out:
+	return r;
+}
+
+int ring_buffer_get_bytes( ring_buffer_codec_t *c, void *data, unsigned data_len ) {
+	int r;
+	uint64_t len;
+
+	if ( NULL == c || ( NULL == data && 0 != data_len ) ) {
+		r = -1;
+		goto out;
+	}
+
+	r = ring_buffer_get_varint( c, & len );
+	if ( EXIT_SUCCESS != r ) {
+		goto out;
+	}
+	if ( len > data_len ) {
+		c->error = 1;
+		r = -1;
+		goto out;
+	}
+	// data may be NULL when the bytes are empty
+	if ( 0 != len ) {
+		r = rbget( c, data, len );
+		if ( EXIT_SUCCESS != r ) {
+			goto out;
+		}
+		c->pos += len;
+	}
+	r = len;
+
+out:
+	return r;
+}
+
+/*###########################################################################
+  #                            OFFSET ACCESS
+  ###########################################################################*/
+
+int ring_buffer_peek_at( ring_buffer_t *rb, unsigned offset, void *data, unsigned data_len ) {
+	int r;
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data ) {
+		r = -1;
+		goto out;
+	}
+
+	r = offset >= rb->len ? 0 : min( rb->len - offset, data_len );
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = rbpos( rb, offset );
+	t1 = min( (unsigned) r, rb->capacity - pos );
+	memcpy( data, & ( (uint8_t *)rb->buffer )[ pos ], t1 );
+	memcpy( & ( (uint8_t *) data )[ t1 ], & ( (uint8_t *)rb->buffer )[ 0 ], r - t1 );
+
+out:
+	return r;
+}
+
+int ring_buffer_patch_at( ring_buffer_t *rb, unsigned offset, const void *data, unsigned data_len ) {
+	int r;
+	unsigned pos;
+	unsigned t1;
+
+	if ( NULL == rb || NULL == data || offset > rb->len || data_len > rb->len - offset ) {
+		r = -1;
+		goto out;
+	}
+
+	r = data_len;
+	if ( 0 == r ) {
+		goto out;
+	}
+
+	pos = rbpos( rb, offset );
+	t1 = min( (unsigned) r, rb->capacity - pos );
+	memcpy( & ( (uint8_t *)rb->buffer )[ pos ], data, t1 );
+	memcpy( & ( (uint8_t *)rb->buffer )[ 0 ], & ( (const uint8_t *) data )[ t1 ], r - t1 );
+
+out:
+	return r;
+}
+
+/*###########################################################################
+  #                            POLLING
+  ###########################################################################*/
+
+// a sweep over many rings touches one header per ring, each on its own cache
+// line, so fetch them well before they are needed: the header
+// 2 * RING_BUFFER_POLL_AHEAD rings ahead, and the first line of data of the
+// ring RING_BUFFER_POLL_AHEAD ahead, whose header should have arrived by then
+int ring_buffer_poll_many( ring_buffer_t **rings, unsigned n, ring_buffer_poll_fn fn, void *arg ) {
+	int r;
+	int res;
+	unsigned i;
+	ring_buffer_t *rb;
+	struct iovec seg[ 2 ];
+	unsigned t1;
+
+	if ( NULL == rings || NULL == fn ) {
+		r = -1;
+		goto out;
+	}
+
+	for( i = 0; i < n && i < 2 * RING_BUFFER_POLL_AHEAD; i++ ) {
+		__builtin_prefetch( rings[ i ], 0, 0 );
+	}
+
+	for( i = 0, r = 0; i < n; i++ ) {
+		if ( i + 2 * RING_BUFFER_POLL_AHEAD < n ) {
+			__builtin_prefetch( rings[ i + 2 * RING_BUFFER_POLL_AHEAD ], 0, 0 );
+		}
+		if ( i + RING_BUFFER_POLL_AHEAD < n ) {
+			rb = rings[ i + RING_BUFFER_POLL_AHEAD ];
+			if ( 0 != rb->len ) {
+				__builtin_prefetch( & ( (uint8_t *) rb->buffer )[ rb->head ], 0, 0 );
+			}
+		}
+
+		rb = rings[ i ];
+		if ( 0 == rb->len ) {
+			continue;
+		}
+
+		t1 = min( rb->len, rb->capacity - rb->head );
+		seg[ 0 ].iov_base = & ( (uint8_t *) rb->buffer )[ rb->head ];
+		seg[ 0 ].iov_len = t1;
+		seg[ 1 ].iov_base = rb->buffer;
+		seg[ 1 ].iov_len = rb->len - t1;
+
+		r++;
+		res = fn( rb, seg, 0 == seg[ 1 ].iov_len ? 1 : 2, arg );
+		if ( res < 0 ) {
+			break;
+		}
+		if ( res > 0 ) {
+			rb->skip( rb, res );
+		}
+	}
+
+out:
+	return r;
+}
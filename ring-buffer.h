@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #include "packed.h"
 
@@ -29,6 +30,8 @@ PACKED_IAR struct PACKED_GNU _ring_buffer {
 	int            (*send)( ring_buffer_t *rb, ring_buffer_t *input, unsigned data_len );
 	// advance the head of the buffer, decreasing its length
 	int            (*skip)( ring_buffer_t *rb, unsigned data_len );
+	// the counterpart of skip: make data_len bytes already placed at the tail live, increasing the length
+	int            (*commit)( ring_buffer_t *rb, unsigned data_len );
 	// the length of the buffer
 	unsigned       (*size)( ring_buffer_t *rb );
 	// the length of the unused portion of the buffer
@@ -48,4 +51,226 @@ uint8_t name ## _buffer[ cap + sizeof( ring_buffer_t ) ];
 
 int ring_buffer_init( ring_buffer_t *rb, unsigned capacity, void *buffer );
 
+// a plain ring's skip() and commit(), exported so that the inline paths below
+// can tell when rb has not overridden them, and change its length in place
+int ring_buffer_plain_skip( ring_buffer_t *rb, unsigned data_len );
+int ring_buffer_plain_commit( ring_buffer_t *rb, unsigned data_len );
+
+// recover the structure that embeds a ring_buffer_t, e.g. from inside an overridden operation
+#define RING_BUFFER_CONTAINER( ptr, type, member ) ( (type *) ring_buffer_container( ptr, offsetof( type, member ) ) )
+static inline void *ring_buffer_container( ring_buffer_t *rb, size_t offset ) {
+	return (uint8_t *) rb - offset;
+}
+
+// like peek(), but starting offset bytes past the head
+int ring_buffer_peek_at( ring_buffer_t *rb, unsigned offset, void *data, unsigned data_len );
+// overwrite data_len live bytes, starting offset bytes past the head. returns -1 unless they are all live
+int ring_buffer_patch_at( ring_buffer_t *rb, unsigned offset, const void *data, unsigned data_len );
+
+// how many rings ahead ring_buffer_poll_many() prefetches each header, and, once that has arrived, the first line of data
+#define RING_BUFFER_POLL_AHEAD 8
+
+// called by ring_buffer_poll_many() for each non-empty ring, with its live
+// contents in place as one or two segments. returns the number of bytes
+// consumed, which are then skipped, or < 0 to end the sweep
+typedef int (*ring_buffer_poll_fn)( ring_buffer_t *rb, const struct iovec *seg, int nseg, void *arg );
+// sweep n rings, calling fn for those that are not empty. returns the number of calls made, or -1
+int ring_buffer_poll_many( ring_buffer_t **rings, unsigned n, ring_buffer_poll_fn fn, void *arg );
+
+// the offset (relative to the head) of the first occurrence of pattern at or after start, or -1
+int ring_buffer_find( ring_buffer_t *rb, const void *pattern, unsigned pattern_len, unsigned start );
+// read everything up to and including the first delim, provided it fits in data_len bytes; otherwise read nothing and return 0
+int ring_buffer_read_until( ring_buffer_t *rb, const void *delim, unsigned delim_len, void *data, unsigned data_len );
+
+// like write() and read(), but also fold the bytes transferred into the running CRC-32C at *crc, in the same pass
+int ring_buffer_write_crc32c( ring_buffer_t *rb, void *data, unsigned data_len, uint32_t *crc );
+int ring_buffer_read_crc32c( ring_buffer_t *rb, void *data, unsigned data_len, uint32_t *crc );
+// fold len live bytes, starting offset bytes past the head, into crc without copying them out
+uint32_t ring_buffer_crc32c( ring_buffer_t *rb, uint32_t crc, unsigned offset, unsigned len );
+
+// gather iovcnt fragments into the ring with a single availability check and a single update of its length.
+// if all_or_nothing is set and the fragments do not fit entirely, nothing is written and 0 is returned
+int ring_buffer_writev( ring_buffer_t *rb, const struct iovec *iov, int iovcnt, int all_or_nothing );
+// scatter the head of the ring into iovcnt fragments; all_or_nothing as for ring_buffer_writev()
+int ring_buffer_readv( ring_buffer_t *rb, const struct iovec *iov, int iovcnt, int all_or_nothing );
+
+// default size at and above which a streaming ring bypasses the cache
+#define RING_BUFFER_STREAM_THRESHOLD ( 256 * 1024 )
+// default read-side prefetch distance, in bytes
+#define RING_BUFFER_STREAM_PREFETCH 512
+
+// like write(), but with non-temporal stores, so that a large burst does not evict the consumer's working set
+int ring_buffer_write_nt( ring_buffer_t *rb, void *data, unsigned data_len );
+// like read(), but prefetching the ring storage prefetch bytes ahead (0 for the default distance)
+int ring_buffer_read_prefetch( ring_buffer_t *rb, void *data, unsigned data_len, unsigned prefetch );
+
+// a ring whose write() and read() switch to the calls above for transfers of at least threshold bytes
+typedef struct {
+	ring_buffer_t    rb;
+	unsigned         threshold;
+	// read-side prefetch distance in bytes, 0 to disable
+	unsigned         prefetch;
+} ring_buffer_stream_t;
+
+// threshold 0 selects RING_BUFFER_STREAM_THRESHOLD
+int ring_buffer_stream_init( ring_buffer_stream_t *s, unsigned capacity, void *buffer, unsigned threshold, unsigned prefetch );
+
+// a record being encoded in place at the tail of a ring, or decoded in place
+// from its head. puts and gets only advance pos; the ring itself changes once
+// per record, at commit. a put that does not fit, or a get that runs past the
+// live bytes (e.g. because the record is not complete yet), fails, and then so
+// does the commit, leaving the ring as it was
+typedef struct {
+	ring_buffer_t   *rb;
+	// bytes encoded or decoded so far
+	unsigned         pos;
+	int              error;
+} ring_buffer_codec_t;
+
+int ring_buffer_encode_begin( ring_buffer_codec_t *c, ring_buffer_t *rb );
+// returns the length of the record appended, or -1
+int ring_buffer_encode_commit( ring_buffer_codec_t *c );
+int ring_buffer_decode_begin( ring_buffer_codec_t *c, ring_buffer_t *rb );
+// returns the length of the record consumed, or -1
+int ring_buffer_decode_commit( ring_buffer_codec_t *c );
+
+int ring_buffer_put_u16le( ring_buffer_codec_t *c, uint16_t v );
+int ring_buffer_put_u32le( ring_buffer_codec_t *c, uint32_t v );
+int ring_buffer_put_u64le( ring_buffer_codec_t *c, uint64_t v );
+int ring_buffer_put_u16be( ring_buffer_codec_t *c, uint16_t v );
+int ring_buffer_put_u32be( ring_buffer_codec_t *c, uint32_t v );
+int ring_buffer_put_u64be( ring_buffer_codec_t *c, uint64_t v );
+// unsigned LEB128
+int ring_buffer_put_varint( ring_buffer_codec_t *c, uint64_t v );
+// a varint length, then the bytes
+int ring_buffer_put_bytes( ring_buffer_codec_t *c, const void *data, unsigned data_len );
+
+int ring_buffer_get_u16le( ring_buffer_codec_t *c, uint16_t *v );
+int ring_buffer_get_u32le( ring_buffer_codec_t *c, uint32_t *v );
+int ring_buffer_get_u64le( ring_buffer_codec_t *c, uint64_t *v );
+int ring_buffer_get_u16be( ring_buffer_codec_t *c, uint16_t *v );
+int ring_buffer_get_u32be( ring_buffer_codec_t *c, uint32_t *v );
+int ring_buffer_get_u64be( ring_buffer_codec_t *c, uint64_t *v );
+int ring_buffer_get_varint( ring_buffer_codec_t *c, uint64_t *v );
+// returns the length of the bytes, which are copied out only if they fit in data_len; otherwise it fails
+int ring_buffer_get_bytes( ring_buffer_codec_t *c, void *data, unsigned data_len );
+
+// Fast paths for small transfers, of 1 to RING_BUFFER_SMALL_MAX bytes, inlined
+// so that a call with a constant size compiles to one unaligned load or store
+// when the transfer does not wrap, and to a short byte loop when it does. They
+// are all-or-nothing, returning the size moved or 0, and do no argument
+// checks: rb must be a valid ring, and data_len must be in range. Like the
+// other free functions, they move the data themselves and then change the
+// length through rb's commit() or skip(), so that a decorator sees them; on a
+// plain ring the length is changed in place instead, without the call.
+// Fixed-size values are moved in host byte order.
+
+#define RING_BUFFER_SMALL_MAX 16
+
+static inline unsigned ring_buffer_small_tail( const ring_buffer_t *rb ) {
+	unsigned tail = rb->head + rb->len;
+	return tail >= rb->capacity ? tail - rb->capacity : tail;
+}
+
+// copy n bytes as at most two overlapping fixed-size moves, which the
+// compiler turns into plain loads and stores, instead of calling memcpy()
+static inline void ring_buffer_small_copy( uint8_t *dst, const uint8_t *src, unsigned n ) {
+	uint64_t a, b;
+	uint32_t c, d;
+	uint16_t e, f;
+
+	if ( n >= 8 ) {
+		__builtin_memcpy( & a, src, 8 );
+		__builtin_memcpy( & b, src + n - 8, 8 );
+		__builtin_memcpy( dst, & a, 8 );
+		__builtin_memcpy( dst + n - 8, & b, 8 );
+	} else if ( n >= 4 ) {
+		__builtin_memcpy( & c, src, 4 );
+		__builtin_memcpy( & d, src + n - 4, 4 );
+		__builtin_memcpy( dst, & c, 4 );
+		__builtin_memcpy( dst + n - 4, & d, 4 );
+	} else if ( n >= 2 ) {
+		__builtin_memcpy( & e, src, 2 );
+		__builtin_memcpy( & f, src + n - 2, 2 );
+		__builtin_memcpy( dst, & e, 2 );
+		__builtin_memcpy( dst + n - 2, & f, 2 );
+	} else if ( n == 1 ) {
+		*dst = *src;
+	}
+}
+
+static inline int ring_buffer_write_small( ring_buffer_t *rb, const void *data, unsigned data_len ) {
+	uint8_t *buf = (uint8_t *) rb->buffer;
+	unsigned tail;
+	unsigned pos;
+	unsigned i;
+
+	if ( __builtin_expect( rb->capacity - rb->len < data_len, 0 ) ) {
+		return 0;
+	}
+	tail = ring_buffer_small_tail( rb );
+	if ( __builtin_expect( rb->capacity - tail >= data_len, 1 ) ) {
+		ring_buffer_small_copy( & buf[ tail ], (const uint8_t *) data, data_len );
+	} else {
+		for( i = 0; i < data_len; i++ ) {
+			pos = tail + i;
+			buf[ pos >= rb->capacity ? pos - rb->capacity : pos ] = ( (const uint8_t *) data )[ i ];
+		}
+	}
+	if ( __builtin_expect( ring_buffer_plain_commit != rb->commit, 0 ) ) {
+		return rb->commit( rb, data_len );
+	}
+	rb->len += data_len;
+	return data_len;
+}
+
+static inline int ring_buffer_peek_small( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	const uint8_t *buf = (const uint8_t *) rb->buffer;
+	unsigned pos;
+	unsigned i;
+
+	if ( __builtin_expect( rb->len < data_len, 0 ) ) {
+		return 0;
+	}
+	if ( __builtin_expect( rb->capacity - rb->head >= data_len, 1 ) ) {
+		ring_buffer_small_copy( (uint8_t *) data, & buf[ rb->head ], data_len );
+	} else {
+		for( i = 0; i < data_len; i++ ) {
+			pos = rb->head + i;
+			( (uint8_t *) data )[ i ] = buf[ pos >= rb->capacity ? pos - rb->capacity : pos ];
+		}
+	}
+	return data_len;
+}
+
+static inline int ring_buffer_read_small( ring_buffer_t *rb, void *data, unsigned data_len ) {
+	int r = ring_buffer_peek_small( rb, data, data_len );
+	if ( __builtin_expect( ring_buffer_plain_skip != rb->skip, 0 ) ) {
+		return 0 == r ? 0 : rb->skip( rb, r );
+	}
+	rb->head += r;
+	rb->head = rb->head >= rb->capacity ? rb->head - rb->capacity : rb->head;
+	rb->len -= r;
+	return r;
+}
+
+#undef _decl_rb_fixed
+#define _decl_rb_fixed( _bits ) \
+	static inline int ring_buffer_write ## _bits( ring_buffer_t *rb, uint ## _bits ## _t v ) { \
+		return ring_buffer_write_small( rb, & v, sizeof( v ) ); \
+	} \
+	static inline int ring_buffer_peek ## _bits( ring_buffer_t *rb, uint ## _bits ## _t *v ) { \
+		return ring_buffer_peek_small( rb, v, sizeof( *v ) ); \
+	} \
+	static inline int ring_buffer_read ## _bits( ring_buffer_t *rb, uint ## _bits ## _t *v ) { \
+		return ring_buffer_read_small( rb, v, sizeof( *v ) ); \
+	}
+
+_decl_rb_fixed( 8 )
+_decl_rb_fixed( 16 )
+_decl_rb_fixed( 32 )
+_decl_rb_fixed( 64 )
+
+#undef _decl_rb_fixed
+
 #endif /* RING_BUFFER_H_ */
@@ -0,0 +1,328 @@
+#ifndef RING_BUFFER_HPP_
+#define RING_BUFFER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+
+#include "ring-buffer.h"
+
+}
+
+namespace ringbuffer {
+
+// Owns a ring_buffer_t and its storage. Besides the usual operations, it
+// exposes the live contents in place: as the (at most) two contiguous spans
+// that they occupy, or as a random-access range in logical order that hides
+// the wrap point, so that std:: algorithms can run without copying anything out.
+class ring {
+
+public:
+
+	template< bool Const >
+	class basic_iterator {
+
+	public:
+
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef uint8_t value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef std::conditional_t< Const, const uint8_t, uint8_t > &reference;
+		typedef std::conditional_t< Const, const uint8_t, uint8_t > *pointer;
+
+		basic_iterator() : rb( nullptr ), i( 0 ) {
+		}
+
+		basic_iterator( const ring_buffer_t *rb, difference_type i ) : rb( rb ), i( i ) {
+		}
+
+		// iterator -> const_iterator
+		operator basic_iterator< true >() const {
+			return basic_iterator< true >( rb, i );
+		}
+
+		reference operator*() const {
+			return (*this)[ 0 ];
+		}
+
+		pointer operator->() const {
+			return & (*this)[ 0 ];
+		}
+
+		reference operator[]( difference_type n ) const {
+			// i + n < len <= capacity, so one conditional subtraction replaces the modulo
+			std::size_t pos = rb->head + i + n;
+			if ( pos >= rb->capacity ) {
+				pos -= rb->capacity;
+			}
+			return static_cast< pointer >( rb->buffer )[ pos ];
+		}
+
+		basic_iterator &operator++() { ++i; return *this; }
+		basic_iterator &operator--() { --i; return *this; }
+		basic_iterator operator++( int ) { basic_iterator r = *this; ++i; return r; }
+		basic_iterator operator--( int ) { basic_iterator r = *this; --i; return r; }
+		basic_iterator &operator+=( difference_type n ) { i += n; return *this; }
+		basic_iterator &operator-=( difference_type n ) { i -= n; return *this; }
+
+		friend basic_iterator operator+( basic_iterator it, difference_type n ) { return it += n; }
+		friend basic_iterator operator+( difference_type n, basic_iterator it ) { return it += n; }
+		friend basic_iterator operator-( basic_iterator it, difference_type n ) { return it -= n; }
+		friend difference_type operator-( const basic_iterator &a, const basic_iterator &b ) { return a.i - b.i; }
+
+		friend bool operator==( const basic_iterator &a, const basic_iterator &b ) { return a.i == b.i; }
+		friend auto operator<=>( const basic_iterator &a, const basic_iterator &b ) { return a.i <=> b.i; }
+
+	private:
+
+		const ring_buffer_t *rb;
+		difference_type i;
+	};
+
+	typedef basic_iterator< false > iterator;
+	typedef basic_iterator< true > const_iterator;
+	typedef std::pair< std::span< uint8_t >, std::span< uint8_t > > segments;
+	typedef std::pair< std::span< const uint8_t >, std::span< const uint8_t > > const_segments;
+
+	explicit ring( unsigned capacity ) : storage( new uint8_t[ capacity ] ) {
+		ring_buffer_init( & rb, capacity, storage.get() );
+	}
+
+	ring( ring &&other ) noexcept : storage( std::move( other.storage ) ), rb( other.rb ) {
+		other.clear_handle();
+	}
+
+	ring &operator=( ring &&other ) noexcept {
+		if ( this != & other ) {
+			storage = std::move( other.storage );
+			rb = other.rb;
+			other.clear_handle();
+		}
+		return *this;
+	}
+
+	ring( const ring & ) = delete;
+	ring &operator=( const ring & ) = delete;
+
+	// for passing to the C API
+	ring_buffer_t *handle() { return & rb; }
+	const ring_buffer_t *handle() const { return & rb; }
+
+	unsigned capacity() const { return rb.capacity; }
+	unsigned size() const { return rb.len; }
+	unsigned available() const { return rb.capacity - rb.len; }
+	bool empty() const { return 0 == rb.len; }
+
+	int write( const void *data, unsigned n ) { return rb.write( & rb, const_cast< void * >( data ), n ); }
+	int read( void *data, unsigned n ) { return rb.read( & rb, data, n ); }
+	int peek( void *data, unsigned n ) { return rb.peek( & rb, data, n ); }
+	int skip( unsigned n ) { return rb.skip( & rb, n ); }
+	int commit( unsigned n ) { return rb.commit( & rb, n ); }
+	int send( ring &input, unsigned n ) { return rb.send( & rb, input.handle(), n ); }
+	void reset() { rb.reset( & rb ); }
+	void realign() { rb.realign( & rb ); }
+
+	// the live contents, as they lie in storage: head to the end (or the
+	// wrap point), then the start of storage. the second span may be empty
+	segments contiguous_segments() {
+		uint8_t *buf = static_cast< uint8_t * >( rb.buffer );
+		std::size_t n1 = 0 == rb.len ? 0 : std::min< std::size_t >( rb.len, rb.capacity - rb.head );
+		return segments( std::span< uint8_t >( buf + ( 0 == n1 ? 0 : rb.head ), n1 ), std::span< uint8_t >( buf, rb.len - n1 ) );
+	}
+
+	const_segments contiguous_segments() const {
+		segments s = const_cast< ring * >( this )->contiguous_segments();
+		return const_segments( s.first, s.second );
+	}
+
+	iterator begin() { return iterator( & rb, 0 ); }
+	iterator end() { return iterator( & rb, rb.len ); }
+	const_iterator begin() const { return const_iterator( & rb, 0 ); }
+	const_iterator end() const { return const_iterator( & rb, rb.len ); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	uint8_t &operator[]( std::size_t i ) { return begin()[ i ]; }
+	const uint8_t &operator[]( std::size_t i ) const { return begin()[ i ]; }
+
+private:
+
+	// leave a moved-from ring empty and zero-capacity, but still usable
+	void clear_handle() {
+		rb.capacity = 0;
+		rb.head = 0;
+		rb.len = 0;
+		rb.buffer = nullptr;
+	}
+
+	std::unique_ptr< uint8_t[] > storage;
+	ring_buffer_t rb;
+};
+
+// A ring of objects of type T, constructed in place in the ring's storage, so
+// that e.g. std::string or std::unique_ptr payloads can be queued without a
+// heap allocation per message. Elements are destroyed when popped, on reset()
+// and with the ring. The underlying byte ring holds the indices, in multiples
+// of sizeof( T ), so elements never straddle the wrap; for trivially copyable
+// T the bulk operations are plain memcpy()s through it, and it may be handed
+// to the C API.
+template< typename T >
+class typed_ring {
+
+public:
+
+	typedef T value_type;
+
+	explicit typed_ring( unsigned capacity ) : storage( std::allocator< T >().allocate( capacity ) ) {
+		ring_buffer_init( & rb, capacity * sizeof( T ), storage );
+	}
+
+	~typed_ring() {
+		release();
+	}
+
+	typed_ring( typed_ring &&other ) noexcept : storage( other.storage ), rb( other.rb ) {
+		other.clear_handle();
+	}
+
+	typed_ring &operator=( typed_ring &&other ) noexcept {
+		if ( this != & other ) {
+			release();
+			storage = other.storage;
+			rb = other.rb;
+			other.clear_handle();
+		}
+		return *this;
+	}
+
+	typed_ring( const typed_ring & ) = delete;
+	typed_ring &operator=( const typed_ring & ) = delete;
+
+	ring_buffer_t *handle() requires std::is_trivially_copyable_v< T > { return & rb; }
+
+	// in elements
+	unsigned capacity() const { return rb.capacity / sizeof( T ); }
+	unsigned size() const { return rb.len / sizeof( T ); }
+	unsigned available() const { return capacity() - size(); }
+	bool empty() const { return 0 == rb.len; }
+	bool full() const { return rb.len == rb.capacity; }
+
+	T &operator[]( unsigned i ) { return *slot( i ); }
+	const T &operator[]( unsigned i ) const { return *const_cast< typed_ring * >( this )->slot( i ); }
+	T &front() { return (*this)[ 0 ]; }
+	T &back() { return (*this)[ size() - 1 ]; }
+
+	// construct an element at the tail. returns it, or nullptr when the ring is full
+	template< typename... Args >
+	T *emplace_back( Args &&...args ) {
+		T *r = nullptr;
+		if ( full() ) {
+			goto out;
+		}
+		r = std::launder( new( slot( size() ) ) T( std::forward< Args >( args )... ) );
+		// only once the constructor has not thrown
+		rb.commit( & rb, sizeof( T ) );
+	out:
+		return r;
+	}
+
+	bool push_back( const T &item ) { return nullptr != emplace_back( item ); }
+	bool push_back( T &&item ) { return nullptr != emplace_back( std::move( item ) ); }
+
+	// move the head element into item and destroy it. returns false when the ring is empty
+	bool pop_front( T &item ) {
+		bool r = false;
+		if ( empty() ) {
+			goto out;
+		}
+		item = std::move( front() );
+		pop_front();
+		r = true;
+	out:
+		return r;
+	}
+
+	// destroy the head element, if any
+	void pop_front() {
+		if ( ! empty() ) {
+			std::destroy_at( slot( 0 ) );
+			rb.skip( & rb, sizeof( T ) );
+		}
+	}
+
+	// append up to n elements, returning the number appended
+	unsigned write( const T *items, unsigned n ) {
+		unsigned r;
+		if constexpr ( std::is_trivially_copyable_v< T > ) {
+			r = rb.write( & rb, const_cast< T * >( items ), std::min( n, available() ) * sizeof( T ) ) / sizeof( T );
+		} else {
+			for( r = 0; r < n && push_back( items[ r ] ); r++ );
+		}
+		return r;
+	}
+
+	// move out up to n elements, returning the number removed
+	unsigned read( T *items, unsigned n ) {
+		unsigned r;
+		if constexpr ( std::is_trivially_copyable_v< T > ) {
+			r = rb.read( & rb, items, std::min( n, size() ) * sizeof( T ) ) / sizeof( T );
+		} else {
+			for( r = 0; r < n && pop_front( items[ r ] ); r++ );
+		}
+		return r;
+	}
+
+	// destroy every element
+	void reset() {
+		clear();
+		rb.reset( & rb );
+	}
+
+private:
+
+	// element i from the head, which is only an object if i < size()
+	T *slot( unsigned i ) {
+		std::size_t pos = rb.head + std::size_t( i ) * sizeof( T );
+		if ( pos >= rb.capacity ) {
+			pos -= rb.capacity;
+		}
+		return std::launder( reinterpret_cast< T * >( reinterpret_cast< uint8_t * >( storage ) + pos ) );
+	}
+
+	void clear() {
+		if constexpr ( ! std::is_trivially_destructible_v< T > ) {
+			while( ! empty() ) {
+				pop_front();
+			}
+		}
+	}
+
+	void release() {
+		clear();
+		if ( nullptr != storage ) {
+			std::allocator< T >().deallocate( storage, capacity() );
+		}
+	}
+
+	void clear_handle() {
+		storage = nullptr;
+		rb.capacity = 0;
+		rb.head = 0;
+		rb.len = 0;
+		rb.buffer = nullptr;
+	}
+
+	T *storage;
+	ring_buffer_t rb;
+};
+
+} // namespace ringbuffer
+
+#endif /* RING_BUFFER_HPP_ */
@@ -0,0 +1,1681 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif // __linux__
+#include "ring-buffer.h"
+#ifdef __linux__
+#include "ring-buffer-shm.h"
+#endif // __linux__
+#include "crc32c.h"
+#include "ring-buffer-mc.h"
+#include "sample-window.h"
+#include "histogram.h"
+#include "ring-buffer-ts.h"
+#include "ring-buffer-mpsc.h"
+#include "ring-buffer-seq.h"
+#ifdef __linux__
+#include "ring-buffer-evt.h"
+#endif // __linux__
+#include "ring-buffer-trace.h"
+#include "ring-buffer-ws.h"
+#include "ring-buffer-pool.h"
+#include "ring-buffer-tb.h"
+#include "ring-buffer-par.h"
+#ifdef __linux__
+#include "ring-buffer-numa.h"
+#endif // __linux__
+
+}
+
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+static double elapsed_s( bench_clock::time_point start ) {
+	return chrono::duration< double >( bench_clock::now() - start ).count();
+}
+
+static void report( const char *bench, const char *variant, const char *metric, double value, const char *unit ) {
+	printf( "%-12s %-24s %-12s %12.2f %s\n", bench, variant, metric, value, unit );
+}
+
+// a hardware cache-miss counter for the calling thread, or -1 where perf is unavailable
+static int cache_miss_counter( void ) {
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset( & attr, 0, sizeof( attr ) );
+	attr.size = sizeof( attr );
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall( SYS_perf_event_open, & attr, 0, -1, -1, 0 );
+#else
+	return -1;
+#endif // __linux__
+}
+
+static uint64_t counter_read( int fd ) {
+	uint64_t v = 0;
+	if ( -1 == fd || sizeof( v ) != read( fd, & v, sizeof( v ) ) ) {
+		v = 0;
+	}
+	return v;
+}
+
+#ifdef __linux__
+
+//
+// Benchmarks for ring_buffer_shm_t
+//
+
+static const unsigned shm_cap = 1 << 20;
+static const unsigned shm_chunk = 64 * 1024;
+static const size_t shm_total = 256u << 20;
+static const unsigned shm_pings = 20000;
+
+static void shm_send_all( ring_buffer_shm_t *rb, const uint8_t *data, size_t n ) {
+	size_t off;
+	int r;
+	for( off = 0; off < n; off += r ) {
+		r = ring_buffer_shm_write( rb, & data[ off ], n - off );
+		if ( 0 == r ) {
+			if ( ring_buffer_shm_wait_writable( rb, -1 ) < 0 ) {
+				break;
+			}
+		}
+	}
+}
+
+static void shm_recv_all( ring_buffer_shm_t *rb, uint8_t *data, size_t n ) {
+	size_t off;
+	int r;
+	for( off = 0; off < n; off += r ) {
+		r = ring_buffer_shm_read( rb, & data[ off ], n - off );
+		if ( 0 == r ) {
+			if ( ring_buffer_shm_wait_readable( rb, -1 ) < 0 ) {
+				break;
+			}
+		}
+	}
+}
+
+static void sock_send_all( int fd, const uint8_t *data, size_t n ) {
+	size_t off;
+	ssize_t r;
+	for( off = 0; off < n; off += r ) {
+		r = write( fd, & data[ off ], n - off );
+		if ( r <= 0 ) {
+			break;
+		}
+	}
+}
+
+static void sock_recv_all( int fd, uint8_t *data, size_t n ) {
+	size_t off;
+	ssize_t r;
+	for( off = 0; off < n; off += r ) {
+		r = read( fd, & data[ off ], n - off );
+		if ( r <= 0 ) {
+			break;
+		}
+	}
+}
+
+static void bench_shm( void ) {
+	int fd[ 2 ];
+	ring_buffer_shm_t *rb[ 2 ];
+	int sv[ 2 ];
+	pid_t pid;
+	size_t off;
+	unsigned i;
+	vector< uint8_t > chunk( shm_chunk, 0x5a );
+	bench_clock::time_point start;
+	double t;
+
+	// throughput: child produces, parent consumes
+	fd[ 0 ] = ring_buffer_shm_create( NULL, shm_cap );
+	rb[ 0 ] = ring_buffer_shm_map( fd[ 0 ] );
+	start = bench_clock::now();
+	pid = fork();
+	if ( 0 == pid ) {
+		ring_buffer_shm_attach_producer( rb[ 0 ] );
+		for( off = 0; off < shm_total; off += shm_chunk ) {
+			shm_send_all( rb[ 0 ], & chunk[ 0 ], shm_chunk );
+		}
+		_exit( EXIT_SUCCESS );
+	}
+	ring_buffer_shm_attach_consumer( rb[ 0 ] );
+	for( off = 0; off < shm_total; off += shm_chunk ) {
+		shm_recv_all( rb[ 0 ], & chunk[ 0 ], shm_chunk );
+	}
+	t = elapsed_s( start );
+	waitpid( pid, NULL, 0 );
+	ring_buffer_shm_detach( rb[ 0 ] );
+	ring_buffer_shm_unmap( rb[ 0 ] );
+	close( fd[ 0 ] );
+	report( "shm", "ring_buffer_shm", "throughput", shm_total / t / ( 1 << 20 ), "MiB/s" );
+
+	socketpair( AF_UNIX, SOCK_STREAM, 0, sv );
+	start = bench_clock::now();
+	pid = fork();
+	if ( 0 == pid ) {
+		close( sv[ 0 ] );
+		for( off = 0; off < shm_total; off += shm_chunk ) {
+			sock_send_all( sv[ 1 ], & chunk[ 0 ], shm_chunk );
+		}
+		_exit( EXIT_SUCCESS );
+	}
+	close( sv[ 1 ] );
+	for( off = 0; off < shm_total; off += shm_chunk ) {
+		sock_recv_all( sv[ 0 ], & chunk[ 0 ], shm_chunk );
+	}
+	t = elapsed_s( start );
+	waitpid( pid, NULL, 0 );
+	close( sv[ 0 ] );
+	report( "shm", "socketpair", "throughput", shm_total / t / ( 1 << 20 ), "MiB/s" );
+
+	// latency: 8-byte ping-pong, ring 0 carries pings and ring 1 pongs
+	for( i = 0; i < 2; i++ ) {
+		fd[ i ] = ring_buffer_shm_create( NULL, 4096 );
+		rb[ i ] = ring_buffer_shm_map( fd[ i ] );
+	}
+	pid = fork();
+	if ( 0 == pid ) {
+		ring_buffer_shm_attach_consumer( rb[ 0 ] );
+		ring_buffer_shm_attach_producer( rb[ 1 ] );
+		for( i = 0; i < shm_pings; i++ ) {
+			shm_recv_all( rb[ 0 ], & chunk[ 0 ], 8 );
+			shm_send_all( rb[ 1 ], & chunk[ 0 ], 8 );
+		}
+		_exit( EXIT_SUCCESS );
+	}
+	ring_buffer_shm_attach_producer( rb[ 0 ] );
+	ring_buffer_shm_attach_consumer( rb[ 1 ] );
+	start = bench_clock::now();
+	for( i = 0; i < shm_pings; i++ ) {
+		shm_send_all( rb[ 0 ], & chunk[ 0 ], 8 );
+		shm_recv_all( rb[ 1 ], & chunk[ 0 ], 8 );
+	}
+	t = elapsed_s( start );
+	waitpid( pid, NULL, 0 );
+	for( i = 0; i < 2; i++ ) {
+		ring_buffer_shm_detach( rb[ i ] );
+		ring_buffer_shm_unmap( rb[ i ] );
+		close( fd[ i ] );
+	}
+	report( "shm", "ring_buffer_shm", "round-trip", t / shm_pings * 1e6, "us" );
+
+	socketpair( AF_UNIX, SOCK_STREAM, 0, sv );
+	pid = fork();
+	if ( 0 == pid ) {
+		close( sv[ 0 ] );
+		for( i = 0; i < shm_pings; i++ ) {
+			sock_recv_all( sv[ 1 ], & chunk[ 0 ], 8 );
+			sock_send_all( sv[ 1 ], & chunk[ 0 ], 8 );
+		}
+		_exit( EXIT_SUCCESS );
+	}
+	close( sv[ 1 ] );
+	start = bench_clock::now();
+	for( i = 0; i < shm_pings; i++ ) {
+		sock_send_all( sv[ 0 ], & chunk[ 0 ], 8 );
+		sock_recv_all( sv[ 0 ], & chunk[ 0 ], 8 );
+	}
+	t = elapsed_s( start );
+	waitpid( pid, NULL, 0 );
+	close( sv[ 0 ] );
+	report( "shm", "socketpair", "round-trip", t / shm_pings * 1e6, "us" );
+}
+
+#endif // __linux__
+
+//
+// Benchmarks for ring_buffer_find() and ring_buffer_read_until()
+//
+
+static const unsigned find_cap = 64 * 1024;
+static const unsigned find_rounds = 2000;
+
+// refill with '\n'-terminated lines of varying length, leaving the head mid-buffer
+static unsigned find_refill( ring_buffer_t *rb, uint8_t *line ) {
+	unsigned lines;
+	unsigned n;
+
+	rb->reset( rb );
+	rb->head = find_cap / 3;
+	for( lines = 0; ; lines++ ) {
+		n = 40 + ( lines * 37 ) % 200;
+		line[ n - 1 ] = '\n';
+		if ( rb->available( rb ) < n ) {
+			break;
+		}
+		rb->write( rb, line, n );
+		line[ n - 1 ] = 'x';
+	}
+	return lines;
+}
+
+static void bench_find( void ) {
+	vector< uint8_t > storage( find_cap );
+	vector< uint8_t > line( 512, 'x' );
+	vector< uint8_t > out( 512 );
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+	bench_clock::time_point start;
+	double t_peek, t_until;
+	size_t lines;
+	unsigned i;
+	unsigned n;
+	uint8_t *nl;
+
+	ring_buffer_init( rb, find_cap, & storage[ 0 ] );
+
+	// peek a window into a temporary buffer, scan it, then consume the line
+	t_peek = 0;
+	lines = 0;
+	for( i = 0; i < find_rounds; i++ ) {
+		lines += find_refill( rb, & line[ 0 ] );
+		start = bench_clock::now();
+		for( ;; ) {
+			n = rb->peek( rb, & out[ 0 ], out.size() );
+			nl = (uint8_t *) memchr( & out[ 0 ], '\n', n );
+			if ( NULL == nl ) {
+				break;
+			}
+			rb->skip( rb, nl - & out[ 0 ] + 1 );
+		}
+		t_peek += elapsed_s( start );
+	}
+
+	t_until = 0;
+	for( i = 0; i < find_rounds; i++ ) {
+		find_refill( rb, & line[ 0 ] );
+		start = bench_clock::now();
+		while( ring_buffer_read_until( rb, "\n", 1, & out[ 0 ], out.size() ) > 0 ) {
+		}
+		t_until += elapsed_s( start );
+	}
+
+	report( "find", "peek+memchr+skip", "per-line", t_peek / lines * 1e9, "ns" );
+	report( "find", "read_until", "per-line", t_until / lines * 1e9, "ns" );
+}
+
+//
+// Benchmarks for checksumming copies
+//
+
+static const unsigned crc_cap = 1 << 20;
+static const unsigned crc_msg = 64 * 1024;
+static const unsigned crc_msgs = 16 * 1024;
+
+static void bench_crc32c( void ) {
+	vector< uint8_t > storage( crc_cap );
+	vector< uint8_t > msg( crc_msg, 0x3c );
+	vector< uint8_t > out( crc_msg );
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+	bench_clock::time_point start;
+	uint32_t wcrc, rcrc;
+	unsigned i;
+	double t;
+
+	ring_buffer_init( rb, crc_cap, & storage[ 0 ] );
+	rb->head = crc_cap - crc_msg / 2;
+
+	// checksum, then copy: the data crosses the bus twice on each side
+	start = bench_clock::now();
+	for( i = 0; i < crc_msgs; i++ ) {
+		wcrc = crc32c( 0, & msg[ 0 ], crc_msg );
+		rb->write( rb, & msg[ 0 ], crc_msg );
+		rb->read( rb, & out[ 0 ], crc_msg );
+		rcrc = crc32c( 0, & out[ 0 ], crc_msg );
+	}
+	t = elapsed_s( start );
+	report( "crc32c", "write+crc32c", "throughput", (double) crc_msg * crc_msgs / t / ( 1 << 20 ), "MiB/s" );
+
+	start = bench_clock::now();
+	for( i = 0; i < crc_msgs; i++ ) {
+		wcrc = rcrc = 0;
+		ring_buffer_write_crc32c( rb, & msg[ 0 ], crc_msg, & wcrc );
+		ring_buffer_read_crc32c( rb, & out[ 0 ], crc_msg, & rcrc );
+	}
+	t = elapsed_s( start );
+	report( "crc32c", "write_crc32c", "throughput", (double) crc_msg * crc_msgs / t / ( 1 << 20 ), "MiB/s" );
+
+	if ( wcrc != rcrc ) {
+		printf( "crc32c mismatch\n" );
+	}
+}
+
+//
+// Benchmarks for streaming (non-temporal) copies
+//
+
+static const unsigned stream_cap = 16 << 20;
+static const unsigned stream_burst = 8 << 20;
+static const unsigned stream_ws = 256 * 1024;
+static const unsigned stream_rounds = 32;
+
+// the competing, cache-bound workload: touch every line of a small working set
+static uint64_t stream_walk( const vector< uint8_t > &ws ) {
+	uint64_t sum = 0;
+	size_t i;
+	for( i = 0; i < ws.size(); i += 64 ) {
+		sum += ws[ i ];
+	}
+	return sum;
+}
+
+static void bench_stream( void ) {
+	vector< uint8_t > storage( stream_cap );
+	vector< uint8_t > burst( stream_burst, 0x77 );
+	vector< uint8_t > ws( stream_ws, 1 );
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+	bench_clock::time_point start;
+	double t_burst, t_walk;
+	uint64_t misses;
+	uint64_t sum;
+	unsigned variant;
+	unsigned i;
+	int counter;
+
+	static const char *variants[] = { "write", "write_nt" };
+
+	ring_buffer_init( rb, stream_cap, & storage[ 0 ] );
+	counter = cache_miss_counter();
+	sum = 0;
+
+	for( variant = 0; variant < 2; variant++ ) {
+		t_burst = 0;
+		t_walk = 0;
+		misses = 0;
+		for( i = 0; i < stream_rounds; i++ ) {
+			sum += stream_walk( ws );
+
+			start = bench_clock::now();
+			if ( 0 == variant ) {
+				rb->write( rb, & burst[ 0 ], stream_burst );
+			} else {
+				ring_buffer_write_nt( rb, & burst[ 0 ], stream_burst );
+			}
+			t_burst += elapsed_s( start );
+			// the consumer will not get to this data for a while
+			rb->skip( rb, stream_burst );
+
+			misses -= counter_read( counter );
+			start = bench_clock::now();
+			sum += stream_walk( ws );
+			t_walk += elapsed_s( start );
+			misses += counter_read( counter );
+		}
+		report( "stream", variants[ variant ], "burst", (double) stream_burst * stream_rounds / t_burst / ( 1 << 20 ), "MiB/s" );
+		report( "stream", variants[ variant ], "ws-walk", t_walk / stream_rounds * 1e6, "us" );
+		if ( -1 != counter ) {
+			report( "stream", variants[ variant ], "ws-misses", (double) misses / stream_rounds, "/walk" );
+		}
+	}
+
+	if ( -1 != counter ) {
+		close( counter );
+	}
+	if ( 0 == sum ) {
+		printf( "\n" );
+	}
+}
+
+//
+// Benchmarks for ring_buffer_writev()
+//
+
+static const unsigned iov_cap = 64 * 1024;
+static const unsigned iov_frag = 24;
+static const unsigned iov_rounds = 200000;
+
+static void bench_writev( void ) {
+	vector< uint8_t > storage( iov_cap );
+	vector< uint8_t > frag( iov_frag, 0x11 );
+	struct iovec iov[ 64 ];
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+	bench_clock::time_point start;
+	unsigned nfrag;
+	unsigned i, j;
+	double t;
+	char variant[ 32 ];
+
+	ring_buffer_init( rb, iov_cap, & storage[ 0 ] );
+	for( j = 0; j < 64; j++ ) {
+		iov[ j ].iov_base = & frag[ 0 ];
+		iov[ j ].iov_len = iov_frag;
+	}
+
+	for( nfrag = 2; nfrag <= 64; nfrag *= 2 ) {
+		start = bench_clock::now();
+		for( i = 0; i < iov_rounds; i++ ) {
+			for( j = 0; j < nfrag; j++ ) {
+				rb->write( rb, & frag[ 0 ], iov_frag );
+			}
+			rb->skip( rb, nfrag * iov_frag );
+		}
+		t = elapsed_s( start );
+		snprintf( variant, sizeof( variant ), "write x%u", nfrag );
+		report( "writev", variant, "per-msg", t / iov_rounds * 1e9, "ns" );
+
+		start = bench_clock::now();
+		for( i = 0; i < iov_rounds; i++ ) {
+			ring_buffer_writev( rb, iov, nfrag, 1 );
+			rb->skip( rb, nfrag * iov_frag );
+		}
+		t = elapsed_s( start );
+		snprintf( variant, sizeof( variant ), "writev x%u", nfrag );
+		report( "writev", variant, "per-msg", t / iov_rounds * 1e9, "ns" );
+	}
+}
+
+//
+// Benchmarks for ring_buffer_mc_t
+//
+
+static const unsigned mc_cap = 256 * 1024;
+static const unsigned mc_msg = 256;
+static const uint64_t mc_total = 64 << 20;
+
+static void bench_mc( void ) {
+	unsigned nreaders;
+	unsigned i;
+	double t;
+	char variant[ 32 ];
+
+	for( nreaders = 1; nreaders <= 8; nreaders *= 2 ) {
+
+		// one ring per consumer, each written separately under its own lock
+		{
+			vector< vector< uint8_t > > storage( nreaders, vector< uint8_t >( mc_cap ) );
+			vector< ring_buffer_t > rings( nreaders );
+			vector< mutex > locks( nreaders );
+			vector< thread > readers;
+			vector< uint8_t > msg( mc_msg, 0x42 );
+			bench_clock::time_point start;
+			uint64_t sent;
+			int r;
+
+			for( i = 0; i < nreaders; i++ ) {
+				ring_buffer_init( & rings[ i ], mc_cap, & storage[ i ][ 0 ] );
+				readers.push_back( thread( [ & rings, & locks, i ]() {
+					uint8_t buf[ mc_msg ];
+					uint64_t got;
+					int r;
+					for( got = 0; got < mc_total; got += r ) {
+						locks[ i ].lock();
+						r = rings[ i ].read( & rings[ i ], buf, sizeof( buf ) );
+						locks[ i ].unlock();
+						if ( 0 == r ) {
+							this_thread::yield();
+						}
+					}
+				} ) );
+			}
+
+			start = bench_clock::now();
+			for( sent = 0; sent < mc_total; sent += mc_msg ) {
+				for( i = 0; i < nreaders; i++ ) {
+					for( ;; ) {
+						locks[ i ].lock();
+						r = rings[ i ].available( & rings[ i ] ) >= mc_msg ? rings[ i ].write( & rings[ i ], & msg[ 0 ], mc_msg ) : 0;
+						locks[ i ].unlock();
+						if ( 0 != r ) {
+							break;
+						}
+						this_thread::yield();
+					}
+				}
+			}
+			for( auto &th: readers ) {
+				th.join();
+			}
+			t = elapsed_s( start );
+			snprintf( variant, sizeof( variant ), "%u copied rings", nreaders );
+			report( "mc", variant, "fan-out", mc_total / t / ( 1 << 20 ), "MiB/s" );
+		}
+
+		// one multicast ring
+		{
+			vector< uint8_t > storage( mc_cap );
+			vector< thread > readers;
+			vector< uint8_t > msg( mc_msg, 0x42 );
+			bench_clock::time_point start;
+			ring_buffer_mc_t *mc = new ring_buffer_mc_t;
+			uint64_t sent;
+			int ids[ 8 ];
+			int r;
+
+			ring_buffer_mc_init( mc, mc_cap, & storage[ 0 ] );
+			for( i = 0; i < nreaders; i++ ) {
+				ids[ i ] = ring_buffer_mc_join( mc );
+				readers.push_back( thread( [ mc, & ids, i ]() {
+					uint8_t buf[ mc_msg ];
+					uint64_t got;
+					int r;
+					for( got = 0; got < mc_total; got += r ) {
+						r = ring_buffer_mc_read( mc, ids[ i ], buf, sizeof( buf ) );
+						if ( 0 == r ) {
+							this_thread::yield();
+						}
+					}
+				} ) );
+			}
+
+			start = bench_clock::now();
+			for( sent = 0; sent < mc_total; sent += r ) {
+				r = ring_buffer_mc_write( mc, & msg[ 0 ], mc_msg );
+				if ( 0 == r ) {
+					this_thread::yield();
+				}
+			}
+			for( auto &th: readers ) {
+				th.join();
+			}
+			t = elapsed_s( start );
+			snprintf( variant, sizeof( variant ), "multicast x%u", nreaders );
+			report( "mc", variant, "fan-out", mc_total / t / ( 1 << 20 ), "MiB/s" );
+			delete mc;
+		}
+	}
+}
+
+//
+// Benchmarks for the sample windows
+//
+
+static const unsigned sw_writes = 1 << 22;
+
+static void bench_sw( void ) {
+	unsigned caps[] = { 64, 4096, 65536 };
+	char variant[ 32 ];
+	unsigned i;
+	double t;
+
+	for( unsigned cap: caps ) {
+		sample_window_u32_t w;
+		vector< uint64_t > buffer( sample_window_u32_footprint( cap ) / sizeof( uint64_t ) + 1 );
+		vector< uint32_t > samples( sw_writes );
+		bench_clock::time_point start;
+		volatile double sink;
+		double sum;
+		uint32_t mn, mx;
+		unsigned queries;
+
+		// latency-like: mostly small, with the odd outlier
+		srand( 36 );
+		for( auto &x: samples ) {
+			x = 0 == rand() % 100 ? 100000 + rand() % 100000 : 1000 + rand() % 1000;
+		}
+		sample_window_u32_init( & w, cap, & buffer[ 0 ] );
+		snprintf( variant, sizeof( variant ), "window %u", cap );
+
+		start = bench_clock::now();
+		for( i = 0; i < sw_writes; i++ ) {
+			sample_window_u32_write( & w, samples[ i ] );
+		}
+		t = elapsed_s( start );
+		report( "sw", variant, "write", t / sw_writes * 1e9, "ns/op" );
+
+		start = bench_clock::now();
+		for( i = 0; i < sw_writes; i++ ) {
+			sample_window_u32_min( & w, & mn );
+			sample_window_u32_max( & w, & mx );
+			sink = sample_window_u32_variance( & w ) + mn + mx;
+		}
+		t = elapsed_s( start );
+		report( "sw", variant, "query", t / sw_writes * 1e9, "ns/op" );
+
+		// what each query used to cost: a pass over the whole window
+		queries = max( 1u, sw_writes / cap / 4 );
+		start = bench_clock::now();
+		for( i = 0; i < queries; i++ ) {
+			sum = 0;
+			mn = UINT32_MAX;
+			mx = 0;
+			for( unsigned j = 0; j < cap; j++ ) {
+				uint32_t x = samples[ ( i + j ) % sw_writes ];
+				sum += x;
+				mn = min( mn, x );
+				mx = max( mx, x );
+			}
+			sink = sum + mn + mx;
+		}
+		t = elapsed_s( start );
+		report( "sw", variant, "recompute", t / queries * 1e9, "ns/op" );
+		(void) sink;
+	}
+}
+
+//
+// Benchmarks for ring_buffer_ts_t
+//
+
+static const unsigned ts_cap = 64 * 1024;
+static const unsigned ts_msg = 64;
+static const unsigned ts_ops = 1 << 22;
+
+static void bench_ts( void ) {
+	static const struct {
+		const char *variant;
+		ring_buffer_ts_clock_fn clock;
+	} clocks[] = {
+		{ "plain", NULL },
+		{ "CLOCK_MONOTONIC", ring_buffer_ts_monotonic },
+		{ "tsc", ring_buffer_ts_tsc },
+	};
+	vector< uint8_t > storage( ts_cap );
+	vector< ring_buffer_ts_stamp_t > stamps( 1024 );
+	uint8_t msg[ ts_msg ] = {};
+	histogram_t *h = new histogram_t;
+	bench_clock::time_point start;
+	ring_buffer_ts_t t;
+	ring_buffer_t *rb;
+	unsigned i, j;
+	double s;
+
+	for( i = 0; i < sizeof( clocks ) / sizeof( clocks[ 0 ] ); i++ ) {
+		histogram_reset( h );
+		rb = & t.rb;
+		if ( NULL == clocks[ i ].clock ) {
+			ring_buffer_init( rb, ts_cap, & storage[ 0 ] );
+		} else {
+			ring_buffer_ts_init( & t, ts_cap, & storage[ 0 ], & stamps[ 0 ], stamps.size(), clocks[ i ].clock, NULL, h );
+		}
+
+		// keep a few messages queued, so that each read completes an older write
+		for( j = 0; j < 8; j++ ) {
+			rb->write( rb, msg, ts_msg );
+		}
+		start = bench_clock::now();
+		for( j = 0; j < ts_ops; j++ ) {
+			rb->write( rb, msg, ts_msg );
+			rb->read( rb, msg, ts_msg );
+		}
+		s = elapsed_s( start );
+		report( "ts", clocks[ i ].variant, "write+read", s / ts_ops * 1e9, "ns/op" );
+		if ( NULL != clocks[ i ].clock ) {
+			report( "ts", clocks[ i ].variant, "residence p50", histogram_percentile( h, 50 ), "ticks" );
+			report( "ts", clocks[ i ].variant, "residence p99", histogram_percentile( h, 99 ), "ticks" );
+		}
+	}
+
+	delete h;
+}
+
+//
+// Benchmarks for ring_buffer_mpsc_t
+//
+
+static const unsigned mpsc_cap = 1 << 20;
+static const unsigned mpsc_chunk = 4096;
+static const unsigned mpsc_msg = 32;
+static const unsigned mpsc_batch = 16;
+static const uint64_t mpsc_total = 1 << 21;
+
+static void bench_mpsc( void ) {
+	unsigned nproducers[] = { 1, 2, 4, 8, 16, 32, 64 };
+	char variant[ 32 ];
+	double t;
+
+	for( unsigned n: nproducers ) {
+		uint64_t each = mpsc_total / n;
+
+		// one ring behind one lock
+		{
+			vector< uint8_t > storage( mpsc_cap );
+			vector< thread > producers;
+			bench_clock::time_point start;
+			ring_buffer_t rb;
+			mutex lock;
+			uint8_t buf[ 4096 ];
+			uint64_t got;
+			int r;
+
+			ring_buffer_init( & rb, mpsc_cap, & storage[ 0 ] );
+			start = bench_clock::now();
+			for( unsigned i = 0; i < n; i++ ) {
+				producers.push_back( thread( [ & rb, & lock, each ]() {
+					uint8_t msg[ mpsc_msg ] = {};
+					int r;
+					for( uint64_t j = 0; j < each; j++ ) {
+						for( ;; ) {
+							lock.lock();
+							r = rb.write( & rb, msg, sizeof( msg ) );
+							lock.unlock();
+							if ( 0 != r ) {
+								break;
+							}
+							this_thread::yield();
+						}
+					}
+				} ) );
+			}
+			for( got = 0; got < each * n * mpsc_msg; got += r ) {
+				lock.lock();
+				r = rb.read( & rb, buf, sizeof( buf ) );
+				lock.unlock();
+				if ( 0 == r ) {
+					this_thread::yield();
+				}
+			}
+			for( auto &th: producers ) {
+				th.join();
+			}
+			t = elapsed_s( start );
+			snprintf( variant, sizeof( variant ), "locked x%u", n );
+			report( "mpsc", variant, "throughput", each * n / t / 1e6, "Mrec/s" );
+		}
+
+		{
+			vector< uint64_t > storage( mpsc_cap / sizeof( uint64_t ) );
+			vector< thread > producers;
+			bench_clock::time_point start;
+			ring_buffer_mpsc_t mpsc;
+			uint8_t buf[ 4096 ];
+			uint64_t got;
+			int r;
+
+			ring_buffer_mpsc_init( & mpsc, mpsc_cap, & storage[ 0 ], mpsc_chunk );
+			start = bench_clock::now();
+			for( unsigned i = 0; i < n; i++ ) {
+				producers.push_back( thread( [ & mpsc, each ]() {
+					ring_buffer_mpsc_producer_t p;
+					uint8_t msg[ mpsc_msg ] = {};
+					ring_buffer_mpsc_producer_init( & p, & mpsc );
+					for( uint64_t j = 0; j < each; j++ ) {
+						while( 0 == ring_buffer_mpsc_write( & p, msg, sizeof( msg ) ) ) {
+							this_thread::yield();
+						}
+						if ( 0 == ( j + 1 ) % mpsc_batch ) {
+							ring_buffer_mpsc_publish( & p );
+						}
+					}
+					ring_buffer_mpsc_flush( & p );
+				} ) );
+			}
+			for( got = 0; got < each * n * mpsc_msg; got += r ) {
+				r = ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) );
+				if ( 0 == r ) {
+					this_thread::yield();
+				}
+			}
+			for( auto &th: producers ) {
+				th.join();
+			}
+			t = elapsed_s( start );
+			snprintf( variant, sizeof( variant ), "mpsc x%u", n );
+			report( "mpsc", variant, "throughput", each * n / t / 1e6, "Mrec/s" );
+		}
+	}
+}
+
+//
+// Benchmarks for trace replay
+//
+
+static const unsigned trace_cap = 64 * 1024;
+static const unsigned trace_ops = 200000;
+
+// a packet-like mix: small and MTU-sized writes, drained by larger reads,
+// with the odd peek-then-skip and send
+static void trace_capture( FILE *f ) {
+	vector< uint8_t > storage( trace_cap ), in_storage( 4096 ), buf( 4096 );
+	ring_buffer_trace_t t;
+	ring_buffer_t in;
+	ring_buffer_t *rb = & t.rb;
+	unsigned i, n;
+
+	ring_buffer_trace_init( & t, trace_cap, & storage[ 0 ], f );
+	ring_buffer_init( & in, in_storage.size(), & in_storage[ 0 ] );
+	srand( 40 );
+	for( i = 0; i < trace_ops; i++ ) {
+		n = rand() % 100;
+		if ( n < 50 ) {
+			rb->write( rb, & buf[ 0 ], 0 == rand() % 4 ? 1500 : 16 + rand() % 240 );
+		} else if ( n < 85 ) {
+			rb->read( rb, & buf[ 0 ], 256 + rand() % 3840 );
+		} else if ( n < 95 ) {
+			rb->peek( rb, & buf[ 0 ], 64 );
+			rb->skip( rb, 64 );
+		} else {
+			in.reset( & in );
+			in.len = 512;
+			rb->send( rb, & in, 512 );
+		}
+	}
+	ring_buffer_trace_flush( & t );
+}
+
+static void bench_trace( void ) {
+	const char *path = getenv( "RB_TRACE" );
+	ring_buffer_trace_header_t h;
+	vector< uint8_t > storage;
+	ring_buffer_trace_stats_t stats = {};
+	histogram_t *lat[ 2 ] = { new histogram_t, new histogram_t };
+	histogram_t *ts_hist = new histogram_t;
+	vector< ring_buffer_ts_stamp_t > stamps( 1024 );
+	ring_buffer_stream_t stream;
+	ring_buffer_seq_t seq;
+#ifdef __linux__
+	ring_buffer_evt_t evt;
+#endif // __linux__
+	ring_buffer_ts_t ts;
+	ring_buffer_t plain;
+	ring_buffer_t *rb;
+	FILE *f;
+	int n;
+
+	// replay RB_TRACE if given, or a synthetic capture
+	f = NULL != path ? fopen( path, "rb" ) : tmpfile();
+	if ( NULL == f ) {
+		perror( path );
+		goto out;
+	}
+	if ( NULL == path ) {
+		trace_capture( f );
+	}
+	rewind( f );
+	if ( 1 != fread( & h, sizeof( h ), 1, f ) ) {
+		goto close;
+	}
+	storage.resize( h.capacity );
+
+	stats.latency[ RING_BUFFER_TRACE_WRITE ] = lat[ 0 ];
+	stats.latency[ RING_BUFFER_TRACE_READ ] = lat[ 1 ];
+	for( const char *backend: {
+		"plain", "stream", "seq",
+#ifdef __linux__
+		"evt",
+#endif // __linux__
+		"ts",
+	} ) {
+		if ( 0 == strcmp( "plain", backend ) ) {
+			ring_buffer_init( & plain, h.capacity, & storage[ 0 ] );
+			rb = & plain;
+		} else if ( 0 == strcmp( "stream", backend ) ) {
+			ring_buffer_stream_init( & stream, h.capacity, & storage[ 0 ], 0, RING_BUFFER_STREAM_PREFETCH );
+			rb = & stream.rb;
+		} else if ( 0 == strcmp( "seq", backend ) ) {
+			ring_buffer_seq_init( & seq, h.capacity, & storage[ 0 ] );
+			rb = & seq.rb;
+#ifdef __linux__
+		} else if ( 0 == strcmp( "evt", backend ) ) {
+			ring_buffer_evt_init( & evt, h.capacity, & storage[ 0 ], -1, -1, 0 );
+			rb = & evt.rb;
+#endif // __linux__
+		} else {
+			histogram_reset( ts_hist );
+			ring_buffer_ts_init( & ts, h.capacity, & storage[ 0 ], & stamps[ 0 ], stamps.size(), NULL, NULL, ts_hist );
+			rb = & ts.rb;
+		}
+		histogram_reset( lat[ 0 ] );
+		histogram_reset( lat[ 1 ] );
+
+		n = ring_buffer_trace_replay( f, rb, 0, & stats );
+		if ( n < 0 ) {
+			goto close;
+		}
+		report( "trace", backend, "throughput", n / ( stats.elapsed_ns / 1e9 ) / 1e6, "Mops/s" );
+		report( "trace", backend, "bytes", stats.bytes / ( stats.elapsed_ns / 1e9 ) / ( 1 << 20 ), "MiB/s" );
+		report( "trace", backend, "write p50", histogram_percentile( lat[ 0 ], 50 ), "ns" );
+		report( "trace", backend, "write p99", histogram_percentile( lat[ 0 ], 99 ), "ns" );
+		report( "trace", backend, "read p50", histogram_percentile( lat[ 1 ], 50 ), "ns" );
+		report( "trace", backend, "read p99", histogram_percentile( lat[ 1 ], 99 ), "ns" );
+		report( "trace", backend, "mismatches", stats.mismatches, "ops" );
+	}
+
+close:
+	fclose( f );
+out:
+	delete lat[ 0 ];
+	delete lat[ 1 ];
+	delete ts_hist;
+}
+
+//
+// Benchmarks for ring_buffer_ws_t
+//
+
+static const uintptr_t ws_fib = 36;
+// below which a task is computed serially rather than split
+static const uintptr_t ws_cutoff = 20;
+static const unsigned ws_cap = 256;
+
+static uint64_t ws_serial( uintptr_t n ) {
+	return n < 2 ? n : ws_serial( n - 1 ) + ws_serial( n - 2 );
+}
+
+// fib( n ) as a tree of tasks, one per call above the cutoff. each worker
+// runs its own deque depth first, and steals breadth first from a random
+// victim when it runs dry
+static uint64_t ws_parallel( uintptr_t n, unsigned nworkers, uint64_t *steals ) {
+	vector< vector< uint8_t > > storage( nworkers );
+	vector< ring_buffer_ws_t * > deques( nworkers );
+	vector< uint64_t > sums( nworkers );
+	vector< uint64_t > stolen( nworkers );
+	vector< thread > workers;
+	atomic< uint64_t > pending( 1 );
+	uint64_t r;
+
+	for( unsigned i = 0; i < nworkers; i++ ) {
+		storage[ i ].resize( sizeof( ring_buffer_ws_t ) + ws_cap * sizeof( void * ) + RING_BUFFER_WS_CACHELINE );
+		deques[ i ] = (ring_buffer_ws_t *)( ( (uintptr_t) & storage[ i ][ 0 ] + RING_BUFFER_WS_CACHELINE - 1 ) & ~( (uintptr_t) RING_BUFFER_WS_CACHELINE - 1 ) );
+		ring_buffer_ws_init( deques[ i ], ws_cap, (void **)( deques[ i ] + 1 ) );
+	}
+	ring_buffer_ws_push( deques[ 0 ], (void *) n );
+
+	for( unsigned i = 0; i < nworkers; i++ ) {
+		workers.push_back( thread( [ &, i ]() {
+			ring_buffer_ws_t *ws = deques[ i ];
+			unsigned seed = i + 1;
+			uint64_t sum = 0;
+			void *task;
+			uintptr_t k;
+
+			while( 0 != pending.load( memory_order_acquire ) ) {
+				if ( EXIT_SUCCESS != ring_buffer_ws_pop( ws, & task ) ) {
+					if ( 1 == nworkers || EXIT_SUCCESS != ring_buffer_ws_steal( deques[ rand_r( & seed ) % nworkers ], & task ) ) {
+						this_thread::yield();
+						continue;
+					}
+					stolen[ i ]++;
+				}
+				k = (uintptr_t) task;
+				if ( k >= ws_cutoff ) {
+					pending.fetch_add( 2, memory_order_relaxed );
+					if ( EXIT_SUCCESS != ring_buffer_ws_push( ws, (void *)( k - 2 ) ) ) {
+						sum += ws_serial( k - 2 );
+						pending.fetch_sub( 1, memory_order_release );
+					}
+					if ( EXIT_SUCCESS != ring_buffer_ws_push( ws, (void *)( k - 1 ) ) ) {
+						sum += ws_serial( k - 1 );
+						pending.fetch_sub( 1, memory_order_release );
+					}
+				} else {
+					sum += ws_serial( k );
+				}
+				pending.fetch_sub( 1, memory_order_release );
+			}
+			sums[ i ] = sum;
+		} ) );
+	}
+	for( auto &th: workers ) {
+		th.join();
+	}
+
+	r = 0;
+	*steals = 0;
+	for( unsigned i = 0; i < nworkers; i++ ) {
+		r += sums[ i ];
+		*steals += stolen[ i ];
+	}
+	return r;
+}
+
+static void bench_ws( void ) {
+	unsigned ncpus = max( 1u, thread::hardware_concurrency() );
+	bench_clock::time_point start;
+	char variant[ 32 ];
+	uint64_t expect;
+	uint64_t got;
+	uint64_t steals;
+	double serial;
+	double t;
+
+	start = bench_clock::now();
+	expect = ws_serial( ws_fib );
+	serial = elapsed_s( start );
+	report( "ws", "serial", "time", serial * 1e3, "ms" );
+
+	// powers of two, then every core
+	for( unsigned n = 1; ; n = min( 2 * n, ncpus ) ) {
+		start = bench_clock::now();
+		got = ws_parallel( ws_fib, n, & steals );
+		t = elapsed_s( start );
+		if ( got != expect ) {
+			fprintf( stderr, "ws: fib( %u ) was %llu, not %llu\n", (unsigned) ws_fib, (unsigned long long) got, (unsigned long long) expect );
+		}
+		snprintf( variant, sizeof( variant ), "deque x%u", n );
+		report( "ws", variant, "time", t * 1e3, "ms" );
+		report( "ws", variant, "speedup", serial / t, "x" );
+		report( "ws", variant, "steals", steals, "" );
+		if ( n == ncpus ) {
+			break;
+		}
+	}
+}
+
+//
+// Benchmarks for ring_buffer_pool_t
+//
+
+static const unsigned pool_objects = 1024;
+static const unsigned pool_size = 256;
+static const unsigned pool_batch = 64;
+static const uint64_t pool_ops = 1 << 22;
+
+// the usual alternative: an intrusive free list behind a lock
+struct pool_freelist {
+	struct node {
+		node *next;
+	};
+	vector< uint8_t > slab;
+	node *head;
+	mutex lock;
+
+	pool_freelist() : slab( pool_objects * pool_size ), head( NULL ) {
+		for( unsigned i = 0; i < pool_objects; i++ ) {
+			release( & slab[ i * pool_size ] );
+		}
+	}
+	void *alloc() {
+		lock_guard< mutex > g( lock );
+		node *n = head;
+		if ( NULL != n ) {
+			head = n->next;
+		}
+		return n;
+	}
+	void release( void *obj ) {
+		lock_guard< mutex > g( lock );
+		node *n = (node *) obj;
+		n->next = head;
+		head = n;
+	}
+};
+
+// carries allocated objects from the allocating thread to the freeing one
+struct pool_handoff {
+	void *slots[ pool_objects ];
+	atomic< uint64_t > head;
+	atomic< uint64_t > tail;
+
+	pool_handoff() : head( 0 ), tail( 0 ) {}
+	bool push( void *obj ) {
+		uint64_t t = tail.load( memory_order_relaxed );
+		if ( t - head.load( memory_order_acquire ) == pool_objects ) {
+			return false;
+		}
+		slots[ t % pool_objects ] = obj;
+		tail.store( t + 1, memory_order_release );
+		return true;
+	}
+	void *pop() {
+		uint64_t h = head.load( memory_order_relaxed );
+		if ( h == tail.load( memory_order_acquire ) ) {
+			return NULL;
+		}
+		void *obj = slots[ h % pool_objects ];
+		head.store( h + 1, memory_order_release );
+		return obj;
+	}
+};
+
+// alloc and free pool_ops objects, pool_batch at a time, on one thread
+template< typename Alloc, typename Free >
+static void pool_churn( const char *variant, Alloc alloc, Free release ) {
+	void *objs[ pool_batch ];
+	bench_clock::time_point start;
+	double t;
+
+	start = bench_clock::now();
+	for( uint64_t i = 0; i < pool_ops; i += pool_batch ) {
+		for( unsigned j = 0; j < pool_batch; j++ ) {
+			objs[ j ] = alloc();
+			*(volatile uint8_t *) objs[ j ] = j;
+		}
+		for( unsigned j = 0; j < pool_batch; j++ ) {
+			release( objs[ j ] );
+		}
+	}
+	t = elapsed_s( start );
+	report( "pool", variant, "alloc+free", t * 1e9 / pool_ops, "ns" );
+}
+
+// alloc on this thread, and free on another
+template< typename Alloc, typename Free >
+static void pool_cross( const char *variant, Alloc alloc, Free release ) {
+	pool_handoff *q = new pool_handoff;
+	bench_clock::time_point start;
+	double t;
+	void *obj;
+
+	start = bench_clock::now();
+	thread freer( [ q, release ]() {
+		void *obj;
+		for( uint64_t i = 0; i < pool_ops; ) {
+			obj = q->pop();
+			if ( NULL == obj ) {
+				this_thread::yield();
+				continue;
+			}
+			release( obj );
+			i++;
+		}
+	} );
+	for( uint64_t i = 0; i < pool_ops; ) {
+		obj = alloc();
+		if ( NULL == obj ) {
+			this_thread::yield();
+			continue;
+		}
+		*(volatile uint8_t *) obj = i;
+		while( ! q->push( obj ) ) {
+			this_thread::yield();
+		}
+		i++;
+	}
+	freer.join();
+	t = elapsed_s( start );
+	report( "pool", variant, "alloc+free", t * 1e9 / pool_ops, "ns" );
+	delete q;
+}
+
+static void bench_pool( void ) {
+	pool_freelist fl;
+	vector< uint8_t > slab( ring_buffer_pool_footprint( pool_size, pool_objects ) + RING_BUFFER_POOL_ALIGN );
+	uint8_t *aligned = (uint8_t *)( ( (uintptr_t) & slab[ 0 ] + RING_BUFFER_POOL_ALIGN - 1 ) & ~( (uintptr_t) RING_BUFFER_POOL_ALIGN - 1 ) );
+	ring_buffer_pool_t p;
+	ring_buffer_pool_spsc_t sp;
+	mutex lock;
+
+	pool_churn( "malloc", []() { return malloc( pool_size ); }, []( void *obj ) { free( obj ); } );
+	pool_churn( "freelist+mutex", [ & ]() { return fl.alloc(); }, [ & ]( void *obj ) { fl.release( obj ); } );
+	ring_buffer_pool_init( & p, pool_size, pool_objects, aligned );
+	pool_churn( "pool", [ & ]() { return ring_buffer_pool_alloc( & p ); }, [ & ]( void *obj ) { ring_buffer_pool_free( & p, obj ); } );
+	ring_buffer_pool_spsc_init( & sp, pool_size, pool_objects, aligned );
+	pool_churn( "pool_spsc", [ & ]() { return ring_buffer_pool_spsc_alloc( & sp ); }, [ & ]( void *obj ) { ring_buffer_pool_spsc_free( & sp, obj ); } );
+
+	pool_cross( "malloc xthread", []() { return malloc( pool_size ); }, []( void *obj ) { free( obj ); } );
+	pool_cross( "freelist+mutex xthread", [ & ]() { return fl.alloc(); }, [ & ]( void *obj ) { fl.release( obj ); } );
+	ring_buffer_pool_init( & p, pool_size, pool_objects, aligned );
+	pool_cross( "pool+mutex xthread", [ & ]() {
+		lock_guard< mutex > g( lock );
+		return ring_buffer_pool_alloc( & p );
+	}, [ & ]( void *obj ) {
+		lock_guard< mutex > g( lock );
+		ring_buffer_pool_free( & p, obj );
+	} );
+	ring_buffer_pool_spsc_init( & sp, pool_size, pool_objects, aligned );
+	pool_cross( "pool_spsc xthread", [ & ]() { return ring_buffer_pool_spsc_alloc( & sp ); }, [ & ]( void *obj ) { ring_buffer_pool_spsc_free( & sp, obj ); } );
+}
+
+//
+// Benchmarks for ring_buffer_tb_t
+//
+
+static const unsigned tb_msg = 64;
+static const uint64_t tb_updates = 1 << 16;
+// between updates, so that the reader gets to run even on a single core
+static const uint64_t tb_interval_ns = 5000;
+
+static uint64_t tb_now( void ) {
+	return chrono::duration_cast< chrono::nanoseconds >( bench_clock::now().time_since_epoch() ).count();
+}
+
+// the writer publishes tb_updates stamped values, one every tb_interval_ns,
+// while the reader polls for the latest. publish is the writer's cost per
+// update, and age how old each value is when the reader first sees it
+template< typename Publish, typename Take >
+static void tb_run( const char *variant, Publish publish, Take take ) {
+	histogram_t *h = new histogram_t;
+	atomic< bool > done( false );
+	uint64_t seen;
+	uint64_t msg[ tb_msg / sizeof( uint64_t ) ] = {};
+	uint64_t next;
+	uint64_t busy;
+
+	histogram_reset( h );
+	thread reader( [ & ]() {
+		uint64_t v[ tb_msg / sizeof( uint64_t ) ];
+		while( ! done.load( memory_order_acquire ) ) {
+			if ( take( v ) ) {
+				histogram_record( h, tb_now() - v[ 0 ] );
+			} else {
+				this_thread::yield();
+			}
+		}
+	} );
+
+	busy = 0;
+	next = tb_now();
+	for( uint64_t i = 0; i < tb_updates; i++ ) {
+		while( tb_now() < next ) {
+			this_thread::yield();
+		}
+		msg[ 0 ] = tb_now();
+		msg[ 1 ] = i;
+		publish( msg );
+		busy += tb_now() - msg[ 0 ];
+		next = msg[ 0 ] + tb_interval_ns;
+	}
+	done.store( true, memory_order_release );
+	reader.join();
+	seen = histogram_count( h );
+
+	report( "tb", variant, "publish", (double) busy / tb_updates, "ns" );
+	report( "tb", variant, "age p50", histogram_percentile( h, 50 ), "ns" );
+	report( "tb", variant, "age p99", histogram_percentile( h, 99 ), "ns" );
+	report( "tb", variant, "seen", 100.0 * seen / tb_updates, "%" );
+	delete h;
+}
+
+static void bench_tb( void ) {
+	uint8_t storage[ 3 * tb_msg ];
+	ring_buffer_tb_t tb;
+	ring_buffer_t rb;
+	mutex lock;
+
+	ring_buffer_tb_init( & tb, tb_msg, storage );
+	tb_run( "triple buffer", [ & ]( uint64_t *msg ) {
+		ring_buffer_tb_write( & tb, msg );
+	}, [ & ]( uint64_t *v ) {
+		return 0 != ring_buffer_tb_read( & tb, v );
+	} );
+
+	// a one-message ring that the writer overwrites, dropping the stale value
+	ring_buffer_init( & rb, tb_msg, storage );
+	tb_run( "ring1 overwrite", [ & ]( uint64_t *msg ) {
+		lock_guard< mutex > g( lock );
+		if ( 0 == rb.available( & rb ) ) {
+			rb.skip( & rb, tb_msg );
+		}
+		rb.write( & rb, msg, tb_msg );
+	}, [ & ]( uint64_t *v ) {
+		lock_guard< mutex > g( lock );
+		return 0 != rb.read( & rb, v, tb_msg );
+	} );
+
+	// a one-message ring that the writer waits on until the reader drains it
+	ring_buffer_init( & rb, tb_msg, storage );
+	tb_run( "ring1 blocking", [ & ]( uint64_t *msg ) {
+		for( ;; ) {
+			{
+				lock_guard< mutex > g( lock );
+				if ( 0 != rb.write( & rb, msg, tb_msg ) ) {
+					break;
+				}
+			}
+			this_thread::yield();
+		}
+	}, [ & ]( uint64_t *v ) {
+		lock_guard< mutex > g( lock );
+		return 0 != rb.read( & rb, v, tb_msg );
+	} );
+}
+
+//
+// Benchmarks for ring_buffer_par_t
+//
+
+static const unsigned par_cap = 256 << 20;
+static const unsigned par_rounds = 8;
+
+static void bench_par( void ) {
+	unsigned ncpus = max( 1u, thread::hardware_concurrency() );
+	vector< uint8_t > src( par_cap, 0x5a );
+	vector< uint8_t > storage( par_cap );
+	vector< uint8_t > in_storage( par_cap );
+	bench_clock::time_point start;
+	ring_buffer_par_pool_t pool;
+	ring_buffer_par_t par;
+	ring_buffer_t in;
+	char variant[ 32 ];
+	double t;
+
+	start = bench_clock::now();
+	for( unsigned i = 0; i < par_rounds; i++ ) {
+		memcpy( & storage[ 0 ], & src[ 0 ], par_cap );
+	}
+	t = elapsed_s( start );
+	report( "par", "memcpy", "bandwidth", (double) par_cap * par_rounds / t / ( 1 << 30 ), "GiB/s" );
+
+	// the calling thread copies too, so n threads means n - 1 helpers
+	for( unsigned n = 1; ; n = min( 2 * n, ncpus ) ) {
+		ring_buffer_par_pool_init( & pool, n - 1 );
+		ring_buffer_par_init( & par, par_cap, & storage[ 0 ], & pool, 0 );
+		ring_buffer_init( & in, par_cap, & in_storage[ 0 ] );
+
+		start = bench_clock::now();
+		for( unsigned i = 0; i < par_rounds; i++ ) {
+			// start mid-ring, so that the copy wraps
+			par.rb.head = par_cap / 3;
+			par.rb.len = 0;
+			par.rb.write( & par.rb, & src[ 0 ], par_cap );
+		}
+		t = elapsed_s( start );
+		snprintf( variant, sizeof( variant ), "write x%u", n );
+		report( "par", variant, "bandwidth", (double) par_cap * par_rounds / t / ( 1 << 30 ), "GiB/s" );
+
+		t = 0;
+		for( unsigned i = 0; i < par_rounds; i++ ) {
+			in.head = par_cap / 2;
+			in.len = par_cap;
+			par.rb.head = par_cap / 3;
+			par.rb.len = 0;
+			start = bench_clock::now();
+			par.rb.send( & par.rb, & in, par_cap );
+			t += elapsed_s( start );
+		}
+		snprintf( variant, sizeof( variant ), "send x%u", n );
+		report( "par", variant, "bandwidth", (double) par_cap * par_rounds / t / ( 1 << 30 ), "GiB/s" );
+
+		ring_buffer_par_pool_destroy( & pool );
+		if ( n == ncpus ) {
+			break;
+		}
+	}
+}
+
+//
+// Benchmarks for the small-transfer fast paths
+//
+
+// odd, so that transfers wrap now and then
+static const unsigned small_cap = 4099;
+static const unsigned small_ops = 1 << 24;
+
+template< typename Write, typename Read >
+static void small_run( const char *variant, unsigned n, Write write, Read read ) {
+	vector< uint8_t > storage( small_cap );
+	uint8_t msg[ RING_BUFFER_SMALL_MAX ] = {};
+	uint8_t out[ RING_BUFFER_SMALL_MAX ] = {};
+	bench_clock::time_point start;
+	ring_buffer_t rb;
+	uint64_t sink = 0;
+	char name[ 32 ];
+	double t;
+
+	ring_buffer_init( & rb, small_cap, & storage[ 0 ] );
+	// keep some data queued, as a busy ring would
+	for( unsigned i = 0; i < 64; i++ ) {
+		write( & rb, msg, n );
+	}
+	start = bench_clock::now();
+	for( unsigned i = 0; i < small_ops; i++ ) {
+		msg[ 0 ] = i;
+		write( & rb, msg, n );
+		read( & rb, out, n );
+		sink += out[ 0 ];
+	}
+	t = elapsed_s( start );
+	snprintf( name, sizeof( name ), "%s %u", variant, n );
+	report( "small", name, "write+read", t / small_ops * 1e9, "ns" );
+	*(volatile uint64_t *) & sink = sink;
+}
+
+static void bench_small( void ) {
+	unsigned sizes[] = { 1, 2, 4, 8, 12, 16 };
+
+	for( unsigned n: sizes ) {
+		small_run( "ops", n, []( ring_buffer_t *rb, uint8_t *msg, unsigned n ) {
+			rb->write( rb, msg, n );
+		}, []( ring_buffer_t *rb, uint8_t *out, unsigned n ) {
+			rb->read( rb, out, n );
+		} );
+		small_run( "small", n, []( ring_buffer_t *rb, uint8_t *msg, unsigned n ) {
+			ring_buffer_write_small( rb, msg, n );
+		}, []( ring_buffer_t *rb, uint8_t *out, unsigned n ) {
+			ring_buffer_read_small( rb, out, n );
+		} );
+	}
+
+	// the size is a constant, as it would be at a typical call site
+	small_run( "fixed", 1, []( ring_buffer_t *rb, uint8_t *msg, unsigned ) {
+		ring_buffer_write8( rb, msg[ 0 ] );
+	}, []( ring_buffer_t *rb, uint8_t *out, unsigned ) {
+		ring_buffer_read8( rb, out );
+	} );
+	small_run( "fixed", 2, []( ring_buffer_t *rb, uint8_t *msg, unsigned ) {
+		uint16_t v;
+		memcpy( & v, msg, sizeof( v ) );
+		ring_buffer_write16( rb, v );
+	}, []( ring_buffer_t *rb, uint8_t *out, unsigned ) {
+		uint16_t v = 0;
+		ring_buffer_read16( rb, & v );
+		memcpy( out, & v, sizeof( v ) );
+	} );
+	small_run( "fixed", 4, []( ring_buffer_t *rb, uint8_t *msg, unsigned ) {
+		uint32_t v;
+		memcpy( & v, msg, sizeof( v ) );
+		ring_buffer_write32( rb, v );
+	}, []( ring_buffer_t *rb, uint8_t *out, unsigned ) {
+		uint32_t v = 0;
+		ring_buffer_read32( rb, & v );
+		memcpy( out, & v, sizeof( v ) );
+	} );
+	small_run( "fixed", 8, []( ring_buffer_t *rb, uint8_t *msg, unsigned ) {
+		uint64_t v;
+		memcpy( & v, msg, sizeof( v ) );
+		ring_buffer_write64( rb, v );
+	}, []( ring_buffer_t *rb, uint8_t *out, unsigned ) {
+		uint64_t v = 0;
+		ring_buffer_read64( rb, & v );
+		memcpy( out, & v, sizeof( v ) );
+	} );
+}
+
+//
+// Benchmarks for ring_buffer_poll_many()
+//
+
+static const unsigned poll_rings = 10000;
+// each ring's header and storage on its own pages, as separately allocated connections would be
+static const unsigned poll_stride = 4096 + 192;
+static const unsigned poll_cap = 512;
+static const unsigned poll_sweeps = 50;
+
+static int poll_consume( ring_buffer_t *rb, const struct iovec *seg, int nseg, void *arg ) {
+	*(uint64_t *) arg += ( (const uint8_t *) seg[ 0 ].iov_base )[ 0 ];
+	return seg[ 0 ].iov_len + ( 2 == nseg ? seg[ 1 ].iov_len : 0 );
+}
+
+static void bench_poll( void ) {
+	unsigned percents[] = { 1, 10, 100 };
+	vector< uint8_t > arena( (size_t) poll_rings * poll_stride );
+	vector< ring_buffer_t * > rings( poll_rings );
+	vector< uint8_t > evict( 64 << 20 );
+	bench_clock::time_point start;
+	uint8_t msg[ 64 ] = { 1 };
+	uint8_t buf[ poll_cap ];
+	uint64_t sink = 0;
+	char variant[ 32 ];
+	ring_buffer_t *rb;
+	double naive;
+	double batched;
+	unsigned seed;
+
+	for( unsigned i = 0; i < poll_rings; i++ ) {
+		rings[ i ] = (ring_buffer_t *) & arena[ (size_t) i * poll_stride ];
+		ring_buffer_init( rings[ i ], poll_cap, rings[ i ] + 1 );
+	}
+
+	for( unsigned pct: percents ) {
+		naive = 0;
+		batched = 0;
+		for( unsigned sweep = 0; sweep < 2 * poll_sweeps; sweep++ ) {
+			// the same rings become busy for both loops
+			seed = sweep / 2 + 1;
+			for( unsigned i = 0; i < poll_rings; i++ ) {
+				if ( (unsigned) rand_r( & seed ) % 100 < pct ) {
+					rings[ i ]->write( rings[ i ], msg, sizeof( msg ) );
+				}
+			}
+			// start each sweep with cold caches, as after a tick's worth of other work
+			memset( & evict[ 0 ], sweep, evict.size() );
+
+			start = bench_clock::now();
+			if ( 0 == sweep % 2 ) {
+				for( unsigned i = 0; i < poll_rings; i++ ) {
+					rb = rings[ i ];
+					if ( 0 != rb->size( rb ) ) {
+						sink += buf[ rb->read( rb, buf, sizeof( buf ) ) - 1 ];
+					}
+				}
+				naive += elapsed_s( start );
+			} else {
+				ring_buffer_poll_many( & rings[ 0 ], poll_rings, poll_consume, & sink );
+				batched += elapsed_s( start );
+			}
+		}
+		snprintf( variant, sizeof( variant ), "naive %u%% busy", pct );
+		report( "poll", variant, "sweep", naive / poll_sweeps * 1e6, "us" );
+		snprintf( variant, sizeof( variant ), "poll_many %u%% busy", pct );
+		report( "poll", variant, "sweep", batched / poll_sweeps * 1e6, "us" );
+	}
+	*(volatile uint64_t *) & sink = sink;
+}
+
+#ifdef __linux__
+
+//
+// Benchmarks for ring_buffer_numa_spsc_t
+//
+
+static const unsigned numa_cap = 1 << 20;
+static const unsigned numa_msg = 256;
+static const uint64_t numa_total = 4ULL << 30;
+
+static void numa_pin( int cpu ) {
+	cpu_set_t set;
+	CPU_ZERO( & set );
+	CPU_SET( cpu, & set );
+	pthread_setaffinity_np( pthread_self(), sizeof( set ), & set );
+}
+
+static void bench_numa( void ) {
+	int ncpus = max( 1u, thread::hardware_concurrency() );
+	// as far apart as the machine allows, which on a two-socket box usually means different nodes
+	int pcpu = 0;
+	int ccpu = ncpus - 1;
+	int pnode = ring_buffer_numa_node_of_cpu( pcpu );
+	int cnode = ring_buffer_numa_node_of_cpu( ccpu );
+	static const struct {
+		const char *variant;
+		// whether the storage is on the consumer's node, and whether each index is on its writer's
+		bool storage_at_consumer;
+		bool split;
+	} variants[] = {
+		{ "all at producer", false, false },
+		{ "storage at consumer", true, false },
+		{ "split indices", false, true },
+		{ "both", true, true },
+	};
+	bench_clock::time_point start;
+	ring_buffer_numa_spsc_t s;
+	uint8_t *storage;
+	double t;
+
+	printf( "numa: %d nodes; producer on cpu %d (node %d), consumer on cpu %d (node %d)\n", ring_buffer_numa_nodes(), pcpu, pnode, ccpu, cnode );
+
+	for( auto &v: variants ) {
+		storage = (uint8_t *) ring_buffer_numa_alloc( numa_cap, v.storage_at_consumer ? cnode : pnode );
+		ring_buffer_numa_spsc_init( & s, numa_cap, storage, pnode, v.split ? cnode : pnode );
+
+		start = bench_clock::now();
+		thread producer( [ & s, pcpu ]() {
+			uint8_t msg[ numa_msg ] = {};
+			numa_pin( pcpu );
+			for( uint64_t sent = 0; sent < numa_total; ) {
+				int r = ring_buffer_numa_spsc_write( & s, msg, sizeof( msg ) );
+				if ( 0 == r ) {
+					this_thread::yield();
+				}
+				sent += r;
+			}
+		} );
+		thread consumer( [ & s, ccpu ]() {
+			uint8_t buf[ 4096 ];
+			numa_pin( ccpu );
+			for( uint64_t got = 0; got < numa_total; ) {
+				int r = ring_buffer_numa_spsc_read( & s, buf, sizeof( buf ) );
+				if ( 0 == r ) {
+					this_thread::yield();
+				}
+				got += r;
+			}
+		} );
+		producer.join();
+		consumer.join();
+		t = elapsed_s( start );
+		report( "numa", v.variant, "throughput", numa_total / t / ( 1 << 30 ), "GiB/s" );
+
+		ring_buffer_numa_spsc_destroy( & s );
+		ring_buffer_numa_free( storage, numa_cap );
+	}
+}
+
+#endif // __linux__
+
+//
+// Driver
+//
+
+static const struct {
+	const char *name;
+	void (*fn)( void );
+} benches[] = {
+#ifdef __linux__
+	{ "shm", bench_shm },
+#endif // __linux__
+	{ "find", bench_find },
+	{ "crc32c", bench_crc32c },
+	{ "stream", bench_stream },
+	{ "writev", bench_writev },
+	{ "mc", bench_mc },
+	{ "sw", bench_sw },
+	{ "ts", bench_ts },
+	{ "mpsc", bench_mpsc },
+	{ "trace", bench_trace },
+	{ "ws", bench_ws },
+	{ "pool", bench_pool },
+	{ "tb", bench_tb },
+	{ "par", bench_par },
+	{ "small", bench_small },
+	{ "poll", bench_poll },
+#ifdef __linux__
+	{ "numa", bench_numa },
+#endif // __linux__
+};
+
+int main( int argc, char *argv[] ) {
+	unsigned i;
+	int j;
+	bool run;
+
+	for( i = 0; i < sizeof( benches ) / sizeof( benches[ 0 ] ); i++ ) {
+		run = argc < 2;
+		for( j = 1; j < argc; j++ ) {
+			run |= 0 == strcmp( argv[ j ], benches[ i ].name );
+		}
+		if ( run ) {
+			benches[ i ].fn();
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
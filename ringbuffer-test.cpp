@@ -1,6 +1,13 @@
 #include "gtest/gtest.h"
 
 #include <algorithm>
+#include <cmath>
+#include <coroutine>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 extern "C" {
 
@@ -9,10 +16,40 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif // __linux__
 #include "ring-buffer.h"
+#ifdef __linux__
+#include "ring-buffer-shm.h"
+#endif // __linux__
+#include "crc32c.h"
+#include "ring-buffer-mc.h"
+#ifdef __linux__
+#include "ring-buffer-evt.h"
+#endif // __linux__
+#include "ring-buffer-wm.h"
+#include "sample-window.h"
+#include "ring-buffer-seq.h"
+#include "histogram.h"
+#include "ring-buffer-ts.h"
+#include "ring-buffer-mpsc.h"
+#include "ring-buffer-trace.h"
+#include "ring-buffer-ws.h"
+#include "ring-buffer-pool.h"
+#include "ring-buffer-tb.h"
+#include "ring-buffer-par.h"
+#ifdef __linux__
+#include "ring-buffer-numa.h"
+#endif // __linux__
 
 }
 
+#include "ring-buffer.hpp"
+#include "ring-buffer-async.hpp"
+
 using namespace std;
 
 class RingBufferTest : public ::testing::Test {
@@ -78,6 +115,7 @@ static void ring_buffer_valid_after_init( ring_buffer_t *rb, unsigned expected_c
 	ASSERT_NE( (void *)NULL, rb->read );
 	ASSERT_NE( (void *)NULL, rb->write );
 	ASSERT_NE( (void *)NULL, rb->skip );
+	ASSERT_NE( (void *)NULL, rb->commit );
 	ASSERT_NE( (void *)NULL, rb->size );
 	ASSERT_NE( (void *)NULL, rb->available );
 	ASSERT_NE( (void *)NULL, rb->reset );
@@ -630,6 +668,27 @@ TEST_F( RingBufferTest, RingBufferSkipTestMoreThanCap ) {
 	}
 }
 
+//
+// Tests for ring_buffer_t::commit()
+//
+
+// commit up to the space available, whatever the head
+TEST_F( RingBufferTest, RingBufferCommit ) {
+	unsigned avail;
+	int i;
+	for( i = 0; i < n; i++ ) {
+		rb[ i ].head = cap[ i ] / 2;
+		rb[ i ].len = cap[ i ] / 4;
+		avail = cap[ i ] - rb[ i ].len;
+		EXPECT_EQ( 0, rb[ i ].commit( & rb[ i ], 0 ) );
+		EXPECT_EQ( 0 == avail ? 0 : 1, rb[ i ].commit( & rb[ i ], 1 ) );
+		EXPECT_EQ( 0 == avail ? 0 : (int)avail - 1, rb[ i ].commit( & rb[ i ], cap[ i ] + 1 ) );
+		EXPECT_EQ( cap[ i ] / 2, rb[ i ].head );
+		EXPECT_EQ( cap[ i ], rb[ i ].len );
+	}
+	EXPECT_EQ( -1, rb[ 0 ].commit( NULL, 1 ) );
+}
+
 //
 // Tests for ring_buffer_t::size()
 //
@@ -826,3 +885,2959 @@ TEST_F( RingBufferTest, RingBufferRealignHalf ) {
 		_do_realign_test( &rb[ i ], rb[ i ].capacity / 2 );
 	}
 }
+
+#ifdef __linux__
+
+//
+// Tests for ring_buffer_shm_t
+//
+
+class RingBufferShmTest : public ::testing::Test {
+
+public:
+
+	static const unsigned cap = 4096;
+	int fd;
+	ring_buffer_shm_t *rb;
+
+	virtual void SetUp() {
+		fd = ring_buffer_shm_create( NULL, cap );
+		ASSERT_NE( -1, fd );
+		rb = ring_buffer_shm_map( fd );
+		ASSERT_NE( (void *)NULL, rb );
+	}
+
+	virtual void TearDown() {
+		ring_buffer_shm_detach( rb );
+		ring_buffer_shm_unmap( rb );
+		close( fd );
+	}
+};
+
+const unsigned RingBufferShmTest::cap;
+
+TEST_F( RingBufferShmTest, RingBufferShmInit ) {
+	EXPECT_EQ( cap, rb->capacity );
+	EXPECT_EQ( 0U, ring_buffer_shm_size( rb ) );
+	EXPECT_EQ( cap, ring_buffer_shm_available( rb ) );
+	EXPECT_EQ( 0U, rb->data_offset % RING_BUFFER_SHM_CACHELINE );
+	EXPECT_EQ( -1, ring_buffer_shm_init( NULL, cap ) );
+	EXPECT_EQ( (void *)NULL, ring_buffer_shm_map( -1 ) );
+}
+
+// a second mapping of the same fd lives at another address but sees the same ring
+TEST_F( RingBufferShmTest, RingBufferShmPositionIndependent ) {
+	static const uint8_t expected_val[] = { 1, 2, 3, 4, 5, };
+	uint8_t actual_val[ sizeof( expected_val ) ];
+	ring_buffer_shm_t *other;
+
+	other = ring_buffer_shm_map( fd );
+	ASSERT_NE( (void *)NULL, other );
+	EXPECT_NE( (void *)rb, (void *)other );
+
+	EXPECT_EQ( (int)sizeof( expected_val ), ring_buffer_shm_write( rb, expected_val, sizeof( expected_val ) ) );
+	EXPECT_EQ( (int)sizeof( expected_val ), ring_buffer_shm_read( other, actual_val, sizeof( actual_val ) ) );
+	EXPECT_EQ( 0, memcmp( expected_val, actual_val, sizeof( expected_val ) ) );
+	EXPECT_EQ( 0U, ring_buffer_shm_size( rb ) );
+
+	ring_buffer_shm_unmap( other );
+}
+
+// partial writes and reads across the wrap point
+TEST_F( RingBufferShmTest, RingBufferShmWrap ) {
+	uint8_t in[ cap ];
+	uint8_t out[ cap ];
+	unsigned i;
+
+	for( i = 0; i < cap; i++ ) {
+		in[ i ] = i * 7;
+	}
+
+	EXPECT_EQ( (int)cap - 100, ring_buffer_shm_write( rb, in, cap - 100 ) );
+	EXPECT_EQ( (int)cap - 100, ring_buffer_shm_read( rb, out, cap ) );
+	EXPECT_EQ( (int)cap, ring_buffer_shm_write( rb, in, cap + 1 ) );
+	EXPECT_EQ( 0, ring_buffer_shm_write( rb, in, 1 ) );
+	EXPECT_EQ( 0U, ring_buffer_shm_available( rb ) );
+	EXPECT_EQ( (int)cap, ring_buffer_shm_read( rb, out, cap ) );
+	EXPECT_EQ( 0, memcmp( in, out, cap ) );
+	EXPECT_EQ( 0, ring_buffer_shm_wait_readable( rb, 0 ) );
+}
+
+// a forked producer streams a pattern through the ring several times its capacity
+TEST_F( RingBufferShmTest, RingBufferShmFork ) {
+	static const unsigned total = 64 * cap;
+	uint8_t buf[ 1000 ];
+	unsigned off;
+	unsigned i;
+	int r;
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	ASSERT_NE( -1, pid );
+	if ( 0 == pid ) {
+		ring_buffer_shm_attach_producer( rb );
+		for( off = 0; off < total; ) {
+			for( i = 0; i < sizeof( buf ); i++ ) {
+				buf[ i ] = ( off + i ) % 251;
+			}
+			r = ring_buffer_shm_write( rb, buf, std::min( (unsigned) sizeof( buf ), total - off ) );
+			if ( 0 == r && ring_buffer_shm_wait_writable( rb, 1000 ) <= 0 ) {
+				_exit( EXIT_FAILURE );
+			}
+			off += r;
+		}
+		ring_buffer_shm_detach( rb );
+		_exit( EXIT_SUCCESS );
+	}
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_shm_attach_consumer( rb ) );
+	for( off = 0; ; ) {
+		r = ring_buffer_shm_wait_readable( rb, 5000 );
+		if ( r <= 0 ) {
+			break;
+		}
+		r = ring_buffer_shm_read( rb, buf, sizeof( buf ) );
+		for( i = 0; i < (unsigned) r; i++ ) {
+			ASSERT_EQ( ( off + i ) % 251, buf[ i ] );
+		}
+		off += r;
+	}
+
+	// the producer detached cleanly after sending everything
+	EXPECT_EQ( -EPIPE, r );
+	EXPECT_EQ( total, off );
+	ASSERT_EQ( pid, waitpid( pid, & status, 0 ) );
+	EXPECT_TRUE( WIFEXITED( status ) && EXIT_SUCCESS == WEXITSTATUS( status ) );
+}
+
+// a producer that dies without detaching is noticed by the sleeping consumer
+TEST_F( RingBufferShmTest, RingBufferShmPeerDied ) {
+	static const uint8_t last_words[] = { 0xde, 0xad, };
+	uint8_t buf[ sizeof( last_words ) ];
+	char c;
+	// kills and reaps the child, and closes the pipe, however the test ends,
+	// so that a failed ASSERT does not leave the child behind in pause()
+	struct reaper {
+		pid_t pid;
+		int pipefd[ 2 ];
+		~reaper() {
+			if ( pid > 0 ) {
+				kill( pid, SIGKILL );
+				waitpid( pid, NULL, 0 );
+			}
+			for( int fd: pipefd ) {
+				if ( -1 != fd ) {
+					close( fd );
+				}
+			}
+		}
+	} child = { -1, { -1, -1 } };
+	int *pipefd = child.pipefd;
+	pid_t pid;
+
+	ASSERT_EQ( 0, pipe( pipefd ) );
+	pid = fork();
+	ASSERT_NE( -1, pid );
+	if ( 0 == pid ) {
+		ring_buffer_shm_attach_producer( rb );
+		ring_buffer_shm_write( rb, last_words, sizeof( last_words ) );
+		c = 0;
+		write( pipefd[ 1 ], & c, 1 );
+		// wait to be killed
+		for( ;; ) {
+			pause();
+		}
+	}
+	child.pid = pid;
+
+	ASSERT_EQ( 1, read( pipefd[ 0 ], & c, 1 ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_shm_attach_consumer( rb ) );
+	EXPECT_EQ( 0, ring_buffer_shm_wait_readable( rb, 0 ) - (int)sizeof( last_words ) );
+
+	// no reaping: a zombie still counts as dead
+	kill( pid, SIGKILL );
+
+	// data published before the death is still delivered, then the hang-up
+	EXPECT_EQ( (int)sizeof( last_words ), ring_buffer_shm_read( rb, buf, sizeof( buf ) ) );
+	EXPECT_EQ( -EPIPE, ring_buffer_shm_wait_readable( rb, 5000 ) );
+
+	// the dead producer's side can be taken over
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_shm_attach_producer( rb ) );
+	EXPECT_EQ( (int)cap, ring_buffer_shm_wait_writable( rb, 0 ) );
+
+	// and the consumer going away is reported to the producer as well
+	ring_buffer_shm_detach( rb );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_shm_attach_producer( rb ) );
+	EXPECT_EQ( -EPIPE, ring_buffer_shm_wait_writable( rb, 0 ) );
+}
+
+#endif // __linux__
+
+//
+// Tests for ring_buffer_find() and ring_buffer_read_until()
+//
+
+// place data in a ring such that it starts at head, wrapping if necessary
+static void fill_at( ring_buffer_t *rb, unsigned head, const void *data, unsigned data_len ) {
+	rb->reset( rb );
+	rb->head = head;
+	ASSERT_EQ( (int)data_len, rb->write( rb, (void *)data, data_len ) );
+}
+
+TEST_F( RingBufferTest, RingBufferFindWrap ) {
+	static const char text[] = "GET / HTTP/1.1\r\nHost: x\r\n\r\n";
+	static const unsigned text_len = sizeof( text ) - 1;
+	uint8_t storage[ 32 ];
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+	unsigned head;
+
+	ring_buffer_init( rb, sizeof( storage ), storage );
+
+	// every possible head, so the wrap point falls inside, before and after each match
+	for( head = 0; head < sizeof( storage ); head++ ) {
+		fill_at( rb, head, text, text_len );
+		EXPECT_EQ( 14, ring_buffer_find( rb, "\r\n", 2, 0 ) );
+		EXPECT_EQ( 23, ring_buffer_find( rb, "\r\n", 2, 15 ) );
+		EXPECT_EQ( 23, ring_buffer_find( rb, "\r\n\r\n", 4, 0 ) );
+		EXPECT_EQ( 0, ring_buffer_find( rb, "G", 1, 0 ) );
+		EXPECT_EQ( 26, ring_buffer_find( rb, "\n", 1, 25 ) );
+		EXPECT_EQ( -1, ring_buffer_find( rb, "\n", 1, 27 ) );
+		EXPECT_EQ( -1, ring_buffer_find( rb, "HTTP/2", 6, 0 ) );
+		EXPECT_EQ( -1, ring_buffer_find( rb, text, text_len + 1, 0 ) );
+		EXPECT_EQ( 0, ring_buffer_find( rb, text, text_len, 0 ) );
+	}
+
+	EXPECT_EQ( -1, ring_buffer_find( NULL, "x", 1, 0 ) );
+	EXPECT_EQ( -1, ring_buffer_find( rb, NULL, 1, 0 ) );
+	EXPECT_EQ( -1, ring_buffer_find( rb, "x", 0, 0 ) );
+}
+
+// compare against std::search over a copy, with buffers long enough for the vector kernels
+TEST_F( RingBufferTest, RingBufferFindRandom ) {
+	uint8_t storage[ 300 ];
+	uint8_t copy[ sizeof( storage ) ];
+	uint8_t pat[ 5 ];
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+	unsigned trial;
+	unsigned len;
+	unsigned plen;
+	unsigned start;
+	unsigned i;
+	int expected_r;
+	int actual_r;
+
+	ring_buffer_init( rb, sizeof( storage ), storage );
+	srand( 42 );
+
+	for( trial = 0; trial < 2000; trial++ ) {
+		len = rand() % ( sizeof( storage ) + 1 );
+		for( i = 0; i < len; i++ ) {
+			// a small alphabet so that matches are plentiful
+			copy[ i ] = 'a' + rand() % 3;
+		}
+		fill_at( rb, rand() % sizeof( storage ), copy, len );
+		plen = 1 + rand() % sizeof( pat );
+		for( i = 0; i < plen; i++ ) {
+			pat[ i ] = 'a' + rand() % 3;
+		}
+		start = rand() % ( len + 1 );
+
+		uint8_t *it = std::search( & copy[ start ], & copy[ len ], pat, & pat[ plen ] );
+		expected_r = & copy[ len ] == it ? -1 : it - copy;
+		actual_r = ring_buffer_find( rb, pat, plen, start );
+		ASSERT_EQ( expected_r, actual_r );
+	}
+}
+
+TEST_F( RingBufferTest, RingBufferReadUntil ) {
+	static const char text[] = "one\r\ntwo\r\nthree";
+	static const unsigned text_len = sizeof( text ) - 1;
+	uint8_t storage[ 16 ];
+	char actual_val[ 16 ];
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+
+	ring_buffer_init( rb, sizeof( storage ), storage );
+	fill_at( rb, 12, text, text_len );
+
+	// the frame does not fit in the output
+	EXPECT_EQ( 0, ring_buffer_read_until( rb, "\r\n", 2, actual_val, 4 ) );
+	EXPECT_EQ( text_len, rb->len );
+
+	EXPECT_EQ( 5, ring_buffer_read_until( rb, "\r\n", 2, actual_val, sizeof( actual_val ) ) );
+	EXPECT_EQ( 0, memcmp( "one\r\n", actual_val, 5 ) );
+	EXPECT_EQ( 5, ring_buffer_read_until( rb, "\r\n", 2, actual_val, 5 ) );
+	EXPECT_EQ( 0, memcmp( "two\r\n", actual_val, 5 ) );
+
+	// incomplete frame
+	EXPECT_EQ( 0, ring_buffer_read_until( rb, "\r\n", 2, actual_val, sizeof( actual_val ) ) );
+	EXPECT_EQ( 5U, rb->len );
+
+	EXPECT_EQ( -1, ring_buffer_read_until( rb, "\r\n", 2, NULL, 1 ) );
+	EXPECT_EQ( -1, ring_buffer_read_until( NULL, "\r\n", 2, actual_val, 1 ) );
+}
+
+//
+// Tests for CRC-32C
+//
+
+// bit-at-a-time reference
+static uint32_t crc32c_ref( uint32_t crc, const uint8_t *p, size_t len ) {
+	unsigned j;
+	crc = ~crc;
+	for( ; len > 0; len--, p++ ) {
+		crc ^= *p;
+		for( j = 0; j < 8; j++ ) {
+			crc = ( crc >> 1 ) ^ ( 0x82f63b78 & -( crc & 1 ) );
+		}
+	}
+	return ~crc;
+}
+
+TEST( Crc32cTest, Crc32cCheckValue ) {
+	static const char check[] = "123456789";
+	EXPECT_EQ( 0xe3069283, crc32c( 0, check, 9 ) );
+	EXPECT_EQ( 0xe3069283, crc32c( crc32c( 0, check, 4 ), & check[ 4 ], 5 ) );
+	EXPECT_EQ( 0U, crc32c( 0, NULL, 0 ) );
+	// the fallback, even where the CPU has an instruction for it
+	EXPECT_EQ( 0xe3069283, crc32c_sw( 0, check, 9 ) );
+	EXPECT_EQ( 0xe3069283, crc32c_sw( crc32c_sw( 0, check, 4 ), & check[ 4 ], 5 ) );
+	EXPECT_EQ( 0U, crc32c_sw( 0, NULL, 0 ) );
+}
+
+TEST( Crc32cTest, Crc32cCopy ) {
+	uint8_t src[ 100 ];
+	uint8_t dst[ 100 ];
+	unsigned off;
+	unsigned len;
+	unsigned i;
+
+	for( i = 0; i < sizeof( src ); i++ ) {
+		src[ i ] = i * 31 + 7;
+	}
+
+	// every alignment and tail length
+	for( off = 0; off < 8; off++ ) {
+		for( len = 0; off + len <= sizeof( src ); len++ ) {
+			memset( dst, 0, sizeof( dst ) );
+			EXPECT_EQ( crc32c_ref( 0, & src[ off ], len ), crc32c_copy( 0, & dst[ off ], & src[ off ], len ) );
+			EXPECT_EQ( 0, memcmp( & src[ off ], & dst[ off ], len ) );
+			EXPECT_EQ( crc32c_ref( 0, & src[ off ], len ), crc32c( 0, & src[ off ], len ) );
+
+			memset( dst, 0, sizeof( dst ) );
+			EXPECT_EQ( crc32c_ref( 0, & src[ off ], len ), crc32c_copy_sw( 0, & dst[ off ], & src[ off ], len ) );
+			EXPECT_EQ( 0, memcmp( & src[ off ], & dst[ off ], len ) );
+			EXPECT_EQ( crc32c_ref( 0, & src[ off ], len ), crc32c_sw( 0, & src[ off ], len ) );
+		}
+	}
+}
+
+TEST_F( RingBufferTest, RingBufferCrc32cWrap ) {
+	uint8_t in[ 11 ];
+	uint8_t out[ 11 ];
+	uint32_t wcrc;
+	uint32_t rcrc;
+	unsigned head;
+	unsigned i;
+	ring_buffer_t *r = & rb[ 3 ];
+
+	for( i = 0; i < sizeof( in ); i++ ) {
+		in[ i ] = 0xa0 + i;
+	}
+
+	for( head = 0; head < r->capacity; head++ ) {
+		r->reset( r );
+		r->head = head;
+
+		wcrc = 0;
+		EXPECT_EQ( 4, ring_buffer_write_crc32c( r, in, 4, & wcrc ) );
+		EXPECT_EQ( 7, ring_buffer_write_crc32c( r, & in[ 4 ], 8, & wcrc ) );
+		EXPECT_EQ( 0, ring_buffer_write_crc32c( r, in, 1, & wcrc ) );
+		EXPECT_EQ( crc32c_ref( 0, in, 11 ), wcrc );
+
+		// checksum of the live contents, in place
+		EXPECT_EQ( wcrc, ring_buffer_crc32c( r, 0, 0, (unsigned)-1 ) );
+		EXPECT_EQ( crc32c_ref( 0, & in[ 3 ], 5 ), ring_buffer_crc32c( r, 0, 3, 5 ) );
+
+		rcrc = 0;
+		EXPECT_EQ( 11, ring_buffer_read_crc32c( r, out, sizeof( out ), & rcrc ) );
+		EXPECT_EQ( wcrc, rcrc );
+		EXPECT_EQ( 0, memcmp( in, out, sizeof( in ) ) );
+		EXPECT_EQ( 0U, r->len );
+		EXPECT_EQ( 0U, ring_buffer_crc32c( r, 0, 0, 1 ) );
+	}
+
+	EXPECT_EQ( -1, ring_buffer_write_crc32c( r, in, 1, NULL ) );
+	EXPECT_EQ( -1, ring_buffer_read_crc32c( NULL, out, 1, & rcrc ) );
+}
+
+//
+// Tests for streaming (non-temporal) copies
+//
+
+TEST_F( RingBufferTest, RingBufferWriteNtWrap ) {
+	static const unsigned cap = 1000;
+	uint8_t storage[ cap + 1 ];
+	uint8_t in[ cap ];
+	uint8_t out[ cap ];
+	ring_buffer_t _r;
+	ring_buffer_t *r = &_r;
+	unsigned head;
+	unsigned len;
+	unsigned i;
+
+	for( i = 0; i < cap; i++ ) {
+		in[ i ] = i * 3 + 1;
+	}
+
+	// misaligned storage, and heads that put the wrap at every alignment
+	ring_buffer_init( r, cap, & storage[ 1 ] );
+	for( head = 0; head < cap; head += 37 ) {
+		for( len = 0; len <= cap; len += 131 ) {
+			r->reset( r );
+			r->head = head;
+			EXPECT_EQ( (int)len, ring_buffer_write_nt( r, in, len ) );
+			EXPECT_EQ( len, r->len );
+			memset( out, 0, sizeof( out ) );
+			EXPECT_EQ( (int)len, ring_buffer_read_prefetch( r, out, cap, 0 ) );
+			EXPECT_EQ( 0U, r->len );
+			EXPECT_EQ( 0, memcmp( in, out, len ) );
+		}
+	}
+
+	EXPECT_EQ( -1, ring_buffer_write_nt( NULL, in, 1 ) );
+	EXPECT_EQ( -1, ring_buffer_read_prefetch( r, NULL, 1, 0 ) );
+}
+
+TEST_F( RingBufferTest, RingBufferStreamInit ) {
+	static const unsigned cap = 256;
+	uint8_t storage[ cap ];
+	uint8_t in[ cap ];
+	uint8_t out[ cap ];
+	ring_buffer_stream_t s;
+	ring_buffer_t *r = & s.rb;
+	unsigned i;
+
+	for( i = 0; i < cap; i++ ) {
+		in[ i ] = ~i;
+	}
+
+	EXPECT_EQ( -1, ring_buffer_stream_init( NULL, cap, storage, 0, 0 ) );
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_stream_init( & s, cap, storage, 0, 0 ) );
+	EXPECT_EQ( (unsigned)RING_BUFFER_STREAM_THRESHOLD, s.threshold );
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_stream_init( & s, cap, storage, 64, 128 ) );
+	ring_buffer_valid_after_init( r, cap );
+	r->head = 200;
+
+	// below and above the threshold
+	EXPECT_EQ( 10, r->write( r, in, 10 ) );
+	EXPECT_EQ( 100, r->write( r, & in[ 10 ], 100 ) );
+	EXPECT_EQ( 10, r->read( r, out, 10 ) );
+	EXPECT_EQ( 100, r->read( r, & out[ 10 ], 100 ) );
+	EXPECT_EQ( 0, memcmp( in, out, 110 ) );
+
+	// reset must not undo the streaming operations
+	r->reset( r );
+	EXPECT_EQ( 0U, r->len );
+	EXPECT_EQ( 0U, r->head );
+	EXPECT_EQ( s.rb.write, r->write );
+	EXPECT_NE( rb[ 0 ].write, r->write );
+}
+
+//
+// Tests for ring_buffer_writev() and ring_buffer_readv()
+//
+
+TEST_F( RingBufferTest, RingBufferWritevReadv ) {
+	static const unsigned cap = 32;
+	uint8_t storage[ cap ];
+	uint8_t hdr[ 3 ] = { 1, 2, 3, };
+	uint8_t body[ 20 ];
+	uint8_t trailer[ 5 ] = { 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, };
+	uint8_t expected_val[ sizeof( hdr ) + sizeof( body ) + sizeof( trailer ) ];
+	uint8_t actual_val[ sizeof( expected_val ) ];
+	uint8_t a[ 7 ], b[ 1 ], c[ 30 ];
+	struct iovec in[ 4 ];
+	struct iovec out[ 4 ];
+	ring_buffer_t _r;
+	ring_buffer_t *r = &_r;
+	unsigned head;
+	unsigned i;
+
+	for( i = 0; i < sizeof( body ); i++ ) {
+		body[ i ] = 0x40 + i;
+	}
+	memcpy( expected_val, hdr, sizeof( hdr ) );
+	memcpy( & expected_val[ sizeof( hdr ) ], body, sizeof( body ) );
+	memcpy( & expected_val[ sizeof( hdr ) + sizeof( body ) ], trailer, sizeof( trailer ) );
+
+	in[ 0 ].iov_base = hdr; in[ 0 ].iov_len = sizeof( hdr );
+	in[ 1 ].iov_base = NULL; in[ 1 ].iov_len = 0;
+	in[ 2 ].iov_base = body; in[ 2 ].iov_len = sizeof( body );
+	in[ 3 ].iov_base = trailer; in[ 3 ].iov_len = sizeof( trailer );
+
+	out[ 0 ].iov_base = a; out[ 0 ].iov_len = sizeof( a );
+	out[ 1 ].iov_base = NULL; out[ 1 ].iov_len = 0;
+	out[ 2 ].iov_base = b; out[ 2 ].iov_len = sizeof( b );
+	out[ 3 ].iov_base = c; out[ 3 ].iov_len = sizeof( c );
+
+	ring_buffer_init( r, cap, storage );
+
+	// the wrap point lands in every fragment, and between them
+	for( head = 0; head < cap; head++ ) {
+		r->reset( r );
+		r->head = head;
+		EXPECT_EQ( (int)sizeof( expected_val ), ring_buffer_writev( r, in, 4, 1 ) );
+		EXPECT_EQ( sizeof( expected_val ), r->len );
+		EXPECT_EQ( head, r->head );
+
+		memset( a, 0, sizeof( a ) );
+		memset( b, 0, sizeof( b ) );
+		memset( c, 0, sizeof( c ) );
+		// asking for more than is there
+		EXPECT_EQ( 0, ring_buffer_readv( r, out, 4, 1 ) );
+		EXPECT_EQ( (int)sizeof( expected_val ), ring_buffer_readv( r, out, 4, 0 ) );
+		EXPECT_EQ( 0U, r->len );
+
+		memcpy( actual_val, a, sizeof( a ) );
+		memcpy( & actual_val[ sizeof( a ) ], b, sizeof( b ) );
+		memcpy( & actual_val[ sizeof( a ) + sizeof( b ) ], c, sizeof( actual_val ) - sizeof( a ) - sizeof( b ) );
+		EXPECT_EQ( 0, memcmp( expected_val, actual_val, sizeof( expected_val ) ) );
+	}
+
+	// partial and all-or-nothing writes into a ring that is too small
+	r->reset( r );
+	r->len = cap - 10;
+	EXPECT_EQ( 0, ring_buffer_writev( r, in, 4, 1 ) );
+	EXPECT_EQ( cap - 10, r->len );
+	EXPECT_EQ( 10, ring_buffer_writev( r, in, 4, 0 ) );
+	EXPECT_EQ( cap, r->len );
+
+	EXPECT_EQ( 0, ring_buffer_writev( r, in, 0, 1 ) );
+	EXPECT_EQ( -1, ring_buffer_writev( r, NULL, 1, 1 ) );
+	EXPECT_EQ( -1, ring_buffer_writev( r, in, -1, 1 ) );
+	in[ 1 ].iov_len = 1;
+	EXPECT_EQ( -1, ring_buffer_writev( r, in, 4, 1 ) );
+	EXPECT_EQ( -1, ring_buffer_readv( NULL, out, 3, 1 ) );
+}
+
+//
+// Tests for ring_buffer_mc_t
+//
+
+TEST( RingBufferMcTest, RingBufferMcFanOut ) {
+	static const unsigned cap = 10;
+	uint8_t storage[ cap ];
+	uint8_t in[ 2 * cap ];
+	uint8_t out[ 2 * cap ];
+	ring_buffer_mc_t mc;
+	int r0, r1, r2;
+	unsigned i;
+
+	for( i = 0; i < sizeof( in ); i++ ) {
+		in[ i ] = i + 1;
+	}
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_mc_init( & mc, cap, storage ) );
+	EXPECT_EQ( -1, ring_buffer_mc_init( NULL, cap, storage ) );
+
+	// with no readers the stream simply flows past
+	EXPECT_EQ( (int)cap, ring_buffer_mc_write( & mc, in, cap ) );
+	EXPECT_EQ( cap, ring_buffer_mc_available( & mc ) );
+
+	r0 = ring_buffer_mc_join( & mc );
+	r1 = ring_buffer_mc_join( & mc );
+	ASSERT_LE( 0, r0 );
+	ASSERT_LE( 0, r1 );
+	ASSERT_NE( r0, r1 );
+	EXPECT_EQ( 0U, ring_buffer_mc_size( & mc, r0 ) );
+
+	EXPECT_EQ( 6, ring_buffer_mc_write( & mc, in, 6 ) );
+	EXPECT_EQ( 6U, ring_buffer_mc_size( & mc, r0 ) );
+	EXPECT_EQ( 6U, ring_buffer_mc_size( & mc, r1 ) );
+
+	// each reader sees every byte
+	EXPECT_EQ( 6, ring_buffer_mc_read( & mc, r0, out, sizeof( out ) ) );
+	EXPECT_EQ( 0, memcmp( in, out, 6 ) );
+	EXPECT_EQ( 2, ring_buffer_mc_read( & mc, r1, out, 2 ) );
+	EXPECT_EQ( 0, memcmp( in, out, 2 ) );
+
+	// the slowest reader bounds the free space, and wraps are handled per reader
+	EXPECT_EQ( 6U, ring_buffer_mc_available( & mc ) );
+	EXPECT_EQ( 6, ring_buffer_mc_write( & mc, & in[ 6 ], 10 ) );
+	EXPECT_EQ( 0, ring_buffer_mc_write( & mc, in, 1 ) );
+	EXPECT_EQ( 10, ring_buffer_mc_read( & mc, r1, out, sizeof( out ) ) );
+	EXPECT_EQ( 0, memcmp( & in[ 2 ], out, 10 ) );
+
+	// a late joiner starts at the end of the stream
+	r2 = ring_buffer_mc_join( & mc );
+	ASSERT_LE( 0, r2 );
+	EXPECT_EQ( 0U, ring_buffer_mc_size( & mc, r2 ) );
+
+	// a departed reader no longer holds the producer back
+	EXPECT_EQ( 6, ring_buffer_mc_peek( & mc, r0, out, sizeof( out ) ) );
+	EXPECT_EQ( 0, memcmp( & in[ 6 ], out, 6 ) );
+	EXPECT_EQ( 4U, ring_buffer_mc_available( & mc ) );
+	ring_buffer_mc_leave( & mc, r0 );
+	EXPECT_EQ( cap, ring_buffer_mc_available( & mc ) );
+	EXPECT_EQ( -1, ring_buffer_mc_read( & mc, r0, out, 1 ) );
+	EXPECT_EQ( 3, ring_buffer_mc_write( & mc, in, 3 ) );
+	EXPECT_EQ( 3, ring_buffer_mc_skip( & mc, r2, 5 ) );
+	EXPECT_EQ( 0U, ring_buffer_mc_size( & mc, r2 ) );
+}
+
+TEST( RingBufferMcTest, RingBufferMcJoinLimit ) {
+	uint8_t storage[ 1 ];
+	ring_buffer_mc_t mc;
+	int i;
+
+	ring_buffer_mc_init( & mc, sizeof( storage ), storage );
+	for( i = 0; i < RING_BUFFER_MC_MAX_READERS; i++ ) {
+		EXPECT_EQ( i, ring_buffer_mc_join( & mc ) );
+	}
+	EXPECT_EQ( -1, ring_buffer_mc_join( & mc ) );
+	ring_buffer_mc_leave( & mc, 3 );
+	EXPECT_EQ( 3, ring_buffer_mc_join( & mc ) );
+}
+
+// readers join and leave while the producer streams a counting pattern; every
+// reader must see a gap-free continuation of the stream from where it joined
+TEST( RingBufferMcTest, RingBufferMcStress ) {
+	static const unsigned cap = 257;
+	static const uint64_t total = 4 << 20;
+	static const unsigned nreaders = 4;
+	uint8_t storage[ cap ];
+	ring_buffer_mc_t mc;
+	std::atomic< bool > done( false );
+	std::atomic< unsigned > errors( 0 );
+	std::vector< std::thread > readers;
+	unsigned i;
+
+	ring_buffer_mc_init( & mc, cap, storage );
+
+	for( i = 0; i < nreaders; i++ ) {
+		readers.push_back( std::thread( [ & mc, & done, & errors, i ]() {
+			uint8_t buf[ 64 ];
+			uint8_t expected;
+			bool first;
+			int id;
+			int r;
+			int j;
+			unsigned sessions;
+
+			for( sessions = 0; ! done.load(); sessions++ ) {
+				id = ring_buffer_mc_join( & mc );
+				first = true;
+				expected = 0;
+				// short sessions for half of the readers, so that joins and leaves are frequent
+				for( j = 0; ! done.load() && ( i % 2 == 0 || j < 1000 ); j++ ) {
+					r = ring_buffer_mc_read( & mc, id, buf, sizeof( buf ) );
+					if ( 0 == r ) {
+						std::this_thread::yield();
+						continue;
+					}
+					for( int k = 0; k < r; k++ ) {
+						if ( ! first && buf[ k ] != expected ) {
+							errors++;
+						}
+						first = false;
+						expected = buf[ k ] + 1;
+					}
+				}
+				ring_buffer_mc_leave( & mc, id );
+			}
+		} ) );
+	}
+
+	uint8_t buf[ 100 ];
+	uint64_t sent;
+	unsigned n;
+	int r;
+	for( sent = 0; sent < total; ) {
+		n = 1 + sent % sizeof( buf );
+		for( i = 0; i < n; i++ ) {
+			buf[ i ] = sent + i;
+		}
+		r = ring_buffer_mc_write( & mc, buf, n );
+		if ( 0 == r ) {
+			std::this_thread::yield();
+		}
+		sent += r;
+	}
+	done = true;
+
+	for( auto &t: readers ) {
+		t.join();
+	}
+	EXPECT_EQ( 0U, errors.load() );
+}
+
+// a joiner caught between its two cursor stores can expose a cursor more than
+// capacity behind the tail; the producer must see no room, not wrap around
+TEST( RingBufferMcTest, RingBufferMcStaleJoinCursor ) {
+	static const unsigned cap = 64;
+	uint8_t storage[ cap ];
+	uint8_t buf[ 2 * cap ] = {};
+	ring_buffer_mc_t mc;
+	int id;
+
+	ring_buffer_mc_init( & mc, cap, storage );
+	for( unsigned i = 0; i < 5; i++ ) {
+		ASSERT_EQ( (int) cap, ring_buffer_mc_write( & mc, buf, cap ) );
+	}
+	id = ring_buffer_mc_join( & mc );
+	ASSERT_EQ( 0, id );
+	mc.readers[ id ].cursor = 0;
+
+	EXPECT_EQ( 0U, ring_buffer_mc_available( & mc ) );
+	EXPECT_EQ( 0, ring_buffer_mc_write( & mc, buf, sizeof( buf ) ) );
+
+	// the joiner's second store releases the producer
+	mc.readers[ id ].cursor = mc.tail;
+	EXPECT_EQ( cap, ring_buffer_mc_available( & mc ) );
+	EXPECT_EQ( (int) cap, ring_buffer_mc_write( & mc, buf, sizeof( buf ) ) );
+}
+
+// a reader repeatedly joins while a producer with no other readers runs flat
+// out; the producer must never be offered more than capacity, and the joiner
+// must always see a gap-free stream
+TEST( RingBufferMcTest, RingBufferMcJoinRace ) {
+	static const unsigned cap = 128;
+	static const unsigned sessions = 20000;
+	uint8_t storage[ cap ];
+	ring_buffer_mc_t mc;
+	std::atomic< bool > done( false );
+	std::atomic< unsigned > errors( 0 );
+
+	ring_buffer_mc_init( & mc, cap, storage );
+
+	std::thread producer( [ & ]() {
+		uint8_t buf[ 2 * cap ];
+		uint64_t sent = 0;
+		unsigned room;
+		int r;
+		while( ! done.load() ) {
+			room = ring_buffer_mc_available( & mc );
+			errors += room > cap;
+			for( unsigned i = 0; i < sizeof( buf ); i++ ) {
+				buf[ i ] = sent + i;
+			}
+			r = ring_buffer_mc_write( & mc, buf, sizeof( buf ) );
+			errors += r < 0 || (unsigned) r > cap;
+			if ( r <= 0 ) {
+				std::this_thread::yield();
+			} else {
+				sent += r;
+			}
+		}
+	} );
+
+	uint8_t buf[ 16 ];
+	uint8_t expected;
+	int id;
+	int r;
+	for( unsigned i = 0; i < sessions; i++ ) {
+		id = ring_buffer_mc_join( & mc );
+		if ( -1 == id ) {
+			errors++;
+			break;
+		}
+		r = ring_buffer_mc_read( & mc, id, buf, sizeof( buf ) );
+		for( int k = 1; k < r; k++ ) {
+			expected = buf[ k - 1 ] + 1;
+			errors += buf[ k ] != expected;
+		}
+		ring_buffer_mc_leave( & mc, id );
+	}
+	done = true;
+	producer.join();
+
+	EXPECT_EQ( 0U, errors.load() );
+}
+
+#ifdef __linux__
+
+//
+// Tests for ring_buffer_evt_t
+//
+
+TEST( RingBufferEvtTest, RingBufferEvtEdges ) {
+	static const unsigned cap = 8;
+	uint8_t storage[ cap ];
+	uint8_t buf[ cap ];
+	ring_buffer_evt_t e;
+	ring_buffer_t *r = & e.rb;
+	int data_fd;
+	int space_fd;
+
+	data_fd = ring_buffer_evt_fd();
+	space_fd = ring_buffer_evt_fd();
+	ASSERT_NE( -1, data_fd );
+	ASSERT_NE( -1, space_fd );
+
+	EXPECT_EQ( -1, ring_buffer_evt_init( NULL, cap, storage, data_fd, space_fd, 0 ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_evt_init( & e, cap, storage, data_fd, space_fd, 4 ) );
+	ring_buffer_valid_after_init( r, cap );
+
+	// only the first write into an empty ring signals
+	EXPECT_EQ( 2, r->write( r, buf, 2 ) );
+	EXPECT_EQ( 2, r->write( r, buf, 2 ) );
+	EXPECT_EQ( 1U, ring_buffer_evt_ack( data_fd ) );
+	EXPECT_EQ( 0U, ring_buffer_evt_ack( data_fd ) );
+
+	// nothing to signal until the length drops from above the mark to it
+	EXPECT_EQ( 4, r->write( r, buf, 8 ) );
+	EXPECT_EQ( 0U, ring_buffer_evt_ack( space_fd ) );
+	EXPECT_EQ( 2, r->read( r, buf, 2 ) );
+	EXPECT_EQ( 0U, ring_buffer_evt_ack( space_fd ) );
+	EXPECT_EQ( 2, r->skip( r, 2 ) );
+	EXPECT_EQ( 1U, ring_buffer_evt_ack( space_fd ) );
+	EXPECT_EQ( 1, r->skip( r, 1 ) );
+	EXPECT_EQ( 0U, ring_buffer_evt_ack( space_fd ) );
+
+	// draining does not signal data; refilling does
+	r->reset( r );
+	EXPECT_EQ( 0U, ring_buffer_evt_ack( data_fd ) );
+	EXPECT_EQ( 0U, ring_buffer_evt_ack( space_fd ) );
+	EXPECT_EQ( r->write, e.rb.write );
+
+	// send() into the ring is an edge for it too
+	uint8_t in_storage[ 4 ] = { 1, 2, 3, 4, };
+	ring_buffer_t in;
+	ring_buffer_init( & in, sizeof( in_storage ), in_storage );
+	in.len = sizeof( in_storage );
+	EXPECT_EQ( 4, r->send( r, & in, 4 ) );
+	EXPECT_EQ( 1U, ring_buffer_evt_ack( data_fd ) );
+
+	// the default mark signals as soon as a full ring has room
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_evt_init( & e, cap, storage, data_fd, space_fd, 0 ) );
+	EXPECT_EQ( cap - 1, e.space_mark );
+	EXPECT_EQ( (int)cap, r->write( r, buf, cap ) );
+	EXPECT_EQ( 1, r->read( r, buf, 1 ) );
+	EXPECT_EQ( 1U, ring_buffer_evt_ack( space_fd ) );
+
+	// the free writers end with commit(), so theirs are edges as well
+	EXPECT_EQ( 1U, ring_buffer_evt_ack( data_fd ) );
+	r->reset( r );
+	EXPECT_EQ( 1, ring_buffer_write8( r, 7 ) );
+	EXPECT_EQ( 1U, ring_buffer_evt_ack( data_fd ) );
+
+	close( data_fd );
+	close( space_fd );
+}
+
+// a consumer sleeping in epoll on two rings that share one fd, fed by a producer thread
+TEST( RingBufferEvtTest, RingBufferEvtEpoll ) {
+	static const unsigned cap = 64;
+	static const unsigned total = 100000;
+	uint8_t storage[ 2 ][ cap ];
+	ring_buffer_evt_t e[ 2 ];
+	std::mutex lock[ 2 ];
+	// set on a failure, so that the producer gives up and can be joined
+	std::atomic< bool > stop( false );
+	struct epoll_event ev;
+	uint64_t expected[ 2 ] = { 0, 0, };
+	unsigned got;
+	unsigned wakeups;
+	int epfd;
+	int fd;
+	int i;
+	int r;
+
+	fd = ring_buffer_evt_fd();
+	for( i = 0; i < 2; i++ ) {
+		ring_buffer_evt_init( & e[ i ], cap, storage[ i ], fd, -1, 0 );
+	}
+
+	epfd = epoll_create1( EPOLL_CLOEXEC );
+	ASSERT_NE( -1, epfd );
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	ASSERT_EQ( 0, epoll_ctl( epfd, EPOLL_CTL_ADD, fd, & ev ) );
+
+	std::thread producer( [ & ]() {
+		uint8_t buf[ 10 ];
+		unsigned sent[ 2 ] = { 0, 0, };
+		unsigned k;
+		int j;
+		for( j = 0; ! stop && sent[ 0 ] + sent[ 1 ] < total; j ^= 1 ) {
+			if ( sent[ j ] >= total / 2 ) {
+				continue;
+			}
+			for( k = 0; k < sizeof( buf ); k++ ) {
+				buf[ k ] = sent[ j ] + k;
+			}
+			std::lock_guard< std::mutex > g( lock[ j ] );
+			sent[ j ] += e[ j ].rb.write( & e[ j ].rb, buf, std::min( (unsigned) sizeof( buf ), total / 2 - sent[ j ] ) );
+		}
+	} );
+
+	// no ASSERT_*() until the producer is joined: returning with it still
+	// joinable would end the whole run in std::terminate()
+	for( got = 0, wakeups = 0; got < total && ! stop; ) {
+		r = epoll_wait( epfd, & ev, 1, 5000 );
+		EXPECT_EQ( 1, r );
+		if ( 1 != r ) {
+			stop = true;
+			break;
+		}
+		wakeups++;
+		// ack before draining, so that an edge raised meanwhile is not lost
+		ring_buffer_evt_ack( fd );
+		for( i = 0; i < 2; i++ ) {
+			uint8_t buf[ cap ];
+			std::lock_guard< std::mutex > g( lock[ i ] );
+			// drain until empty, since only the next empty -> non-empty edge signals again
+			while( ! stop && ( r = e[ i ].rb.read( & e[ i ].rb, buf, sizeof( buf ) ) ) > 0 ) {
+				for( int k = 0; k < r; k++ ) {
+					if ( (uint8_t) expected[ i ] != buf[ k ] ) {
+						ADD_FAILURE() << "ring " << i << " byte " << expected[ i ] << ": " << (unsigned) buf[ k ];
+						stop = true;
+						break;
+					}
+					expected[ i ]++;
+				}
+				got += r;
+			}
+		}
+	}
+
+	producer.join();
+	EXPECT_EQ( total / 2, expected[ 0 ] );
+	EXPECT_EQ( total / 2, expected[ 1 ] );
+	// far fewer wake-ups than writes
+	EXPECT_LT( wakeups, total / 10 );
+
+	close( epfd );
+	close( fd );
+}
+
+#endif // __linux__
+
+//
+// Tests for ring_buffer_wm_t
+//
+
+struct wm_counts {
+	unsigned low;
+	unsigned high;
+};
+
+static void wm_on_low( ring_buffer_t *rb, void *arg ) {
+	( (struct wm_counts *) arg )->low++;
+}
+
+static void wm_on_high( ring_buffer_t *rb, void *arg ) {
+	( (struct wm_counts *) arg )->high++;
+}
+
+TEST( RingBufferWmTest, RingBufferWmInit ) {
+	uint8_t storage[ 8 ];
+	ring_buffer_wm_t w;
+
+	EXPECT_EQ( -1, ring_buffer_wm_init( NULL, 8, storage, 2, NULL, 6, NULL, NULL ) );
+	// the marks must be ordered and within the ring
+	EXPECT_EQ( -1, ring_buffer_wm_init( & w, 8, storage, 6, NULL, 6, NULL, NULL ) );
+	EXPECT_EQ( -1, ring_buffer_wm_init( & w, 8, storage, 2, NULL, 9, NULL, NULL ) );
+	EXPECT_EQ( -1, ring_buffer_wm_init( & w, 8, NULL, 2, NULL, 6, NULL, NULL ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_wm_init( & w, 8, storage, 2, NULL, 6, NULL, NULL ) );
+	ring_buffer_valid_after_init( & w.rb, 8 );
+}
+
+// the free functions end with skip() or commit(), so their crossings are reported
+TEST( RingBufferWmTest, RingBufferWmFreeFunctions ) {
+	static const unsigned cap = 10;
+	uint8_t storage[ cap ];
+	uint8_t buf[ cap ] = {};
+	ring_buffer_wm_t w;
+	ring_buffer_t *r = & w.rb;
+	struct wm_counts c = { 0, 0, };
+	struct iovec iov = { buf, 6 };
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_wm_init( & w, cap, storage, 2, wm_on_low, 7, wm_on_high, & c ) );
+
+	r->write( r, buf, 8 );
+	EXPECT_EQ( 1U, c.high );
+	EXPECT_EQ( 6, ring_buffer_readv( r, & iov, 1, 1 ) );
+	EXPECT_EQ( 1U, c.low );
+
+	ring_buffer_codec_t e;
+	uint64_t v;
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_encode_begin( & e, r ) );
+	EXPECT_EQ( 0, ring_buffer_put_u32le( & e, 1 ) );
+	EXPECT_EQ( 0, ring_buffer_put_u16le( & e, 2 ) );
+	EXPECT_EQ( 1U, c.high );
+	EXPECT_EQ( 6, ring_buffer_encode_commit( & e ) );
+	EXPECT_EQ( 2U, c.high );
+	EXPECT_EQ( 8, ring_buffer_read64( r, & v ) );
+	EXPECT_EQ( 2U, c.low );
+}
+
+TEST( RingBufferWmTest, RingBufferWmCrossings ) {
+	static const unsigned cap = 10;
+	uint8_t storage[ cap ];
+	uint8_t buf[ cap ] = {};
+	ring_buffer_wm_t w;
+	ring_buffer_t *r = & w.rb;
+	struct wm_counts c = { 0, 0, };
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_wm_init( & w, cap, storage, 2, wm_on_low, 7, wm_on_high, & c ) );
+
+	r->write( r, buf, 6 );
+	EXPECT_EQ( 0U, c.high );
+	// exactly reaching the mark is a crossing, staying above it is not
+	r->write( r, buf, 1 );
+	EXPECT_EQ( 1U, c.high );
+	r->write( r, buf, 3 );
+	EXPECT_EQ( 1U, c.high );
+
+	r->read( r, buf, 3 );
+	r->skip( r, 4 );
+	EXPECT_EQ( 0U, c.low );
+	r->skip( r, 1 );
+	EXPECT_EQ( 1U, c.low );
+	r->read( r, buf, 2 );
+	EXPECT_EQ( 1U, c.low );
+
+	// a single operation can jump straight past the mark
+	r->write( r, buf, cap );
+	EXPECT_EQ( 2U, c.high );
+	r->reset( r );
+	EXPECT_EQ( 2U, c.low );
+
+	// send() raises the output, and the input's skip() lowers the input
+	uint8_t in_storage[ cap ];
+	ring_buffer_wm_t in;
+	struct wm_counts in_c = { 0, 0, };
+	ring_buffer_wm_init( & in, cap, in_storage, 2, wm_on_low, 7, wm_on_high, & in_c );
+	in.rb.write( & in.rb, buf, 8 );
+	EXPECT_EQ( 1U, in_c.high );
+	EXPECT_EQ( 8, r->send( r, & in.rb, 8 ) );
+	EXPECT_EQ( 3U, c.high );
+	EXPECT_EQ( 1U, in_c.low );
+}
+
+//
+// Tests for the C++ wrapper
+//
+
+static_assert( std::random_access_iterator< ringbuffer::ring::iterator > );
+static_assert( std::random_access_iterator< ringbuffer::ring::const_iterator > );
+
+// leave the contents "0123456789" straddling the end of an 8-byte ring's storage
+static void fill_wrapped( ringbuffer::ring &r, const char *s ) {
+	uint8_t junk[ 5 ];
+	r.reset();
+	ASSERT_EQ( 5, r.write( "xxxxx", 5 ) );
+	ASSERT_EQ( 5, r.read( junk, 5 ) );
+	ASSERT_EQ( (int) strlen( s ), r.write( s, strlen( s ) ) );
+}
+
+TEST( RingBufferCxx, Segments ) {
+	ringbuffer::ring r( 8 );
+
+	auto s = r.contiguous_segments();
+	EXPECT_TRUE( s.first.empty() );
+	EXPECT_TRUE( s.second.empty() );
+
+	fill_wrapped( r, "abcdefg" );
+	s = r.contiguous_segments();
+	ASSERT_EQ( 3U, s.first.size() );
+	ASSERT_EQ( 4U, s.second.size() );
+	EXPECT_EQ( 0, memcmp( "abc", s.first.data(), 3 ) );
+	EXPECT_EQ( 0, memcmp( "defg", s.second.data(), 4 ) );
+	// the spans alias the storage, they are not copies
+	EXPECT_EQ( (uint8_t *) r.handle()->buffer + 5, s.first.data() );
+	EXPECT_EQ( (uint8_t *) r.handle()->buffer, s.second.data() );
+
+	r.skip( 3 );
+	s = r.contiguous_segments();
+	EXPECT_EQ( 4U, s.first.size() );
+	EXPECT_TRUE( s.second.empty() );
+}
+
+TEST( RingBufferCxx, Algorithms ) {
+	ringbuffer::ring r( 8 );
+	const char needle[] = "fg";
+	std::vector< uint8_t > out;
+
+	fill_wrapped( r, "abcdefg" );
+	EXPECT_EQ( 7, std::distance( r.begin(), r.end() ) );
+	EXPECT_EQ( 'a', r[ 0 ] );
+	EXPECT_EQ( 'g', r[ 6 ] );
+	EXPECT_EQ( 'd', r.begin()[ 3 ] );
+	EXPECT_EQ( 'e', *( r.end() - 3 ) );
+
+	EXPECT_EQ( r.begin() + 3, std::find( r.begin(), r.end(), 'd' ) );
+	EXPECT_EQ( r.end(), std::find( r.cbegin(), r.cend(), 'z' ) );
+
+	// straddles the wrap point
+	auto it = std::search( r.begin(), r.end(), needle, needle + 2 );
+	EXPECT_EQ( 5, it - r.begin() );
+	const char across[] = "cd";
+	EXPECT_EQ( r.begin() + 2, std::search( r.begin(), r.end(), across, across + 2 ) );
+
+	std::copy( r.begin(), r.end(), std::back_inserter( out ) );
+	EXPECT_EQ( std::vector< uint8_t >( { 'a', 'b', 'c', 'd', 'e', 'f', 'g' } ), out );
+
+	// writes land in place, in logical order
+	std::reverse( r.begin(), r.end() );
+	char buf[ 8 ] = {};
+	EXPECT_EQ( 7, r.peek( buf, 7 ) );
+	EXPECT_STREQ( "gfedcba", buf );
+	std::sort( r.begin(), r.end() );
+	EXPECT_EQ( 7, r.read( buf, 7 ) );
+	EXPECT_STREQ( "abcdefg", buf );
+	EXPECT_TRUE( r.empty() );
+}
+
+TEST( RingBufferCxx, Move ) {
+	ringbuffer::ring a( 8 );
+	char buf[ 4 ] = {};
+
+	EXPECT_EQ( 3, a.write( "xyz", 3 ) );
+
+	ringbuffer::ring b( std::move( a ) );
+	EXPECT_EQ( 8U, b.capacity() );
+	EXPECT_EQ( 3U, b.size() );
+	EXPECT_EQ( 0U, a.capacity() );
+	EXPECT_TRUE( a.empty() );
+	EXPECT_EQ( a.begin(), a.end() );
+	// a moved-from ring still accepts calls, it just has no room
+	EXPECT_EQ( 0, a.write( "q", 1 ) );
+
+	ringbuffer::ring c( 2 );
+	c = std::move( b );
+	EXPECT_EQ( 8U, c.capacity() );
+	EXPECT_EQ( 3, c.read( buf, 3 ) );
+	EXPECT_STREQ( "xyz", buf );
+	EXPECT_EQ( 0U, b.capacity() );
+}
+
+//
+// Tests for the typed C++ ring
+//
+
+// counts live instances, to catch leaked or doubly-destroyed elements
+struct Counted {
+	static int live;
+	int v;
+	Counted( int v ) : v( v ) { live++; }
+	Counted( const Counted &o ) : v( o.v ) { live++; }
+	Counted( Counted &&o ) : v( o.v ) { o.v = -1; live++; }
+	Counted &operator=( Counted &&o ) { v = o.v; o.v = -1; return *this; }
+	~Counted() { live--; }
+};
+int Counted::live;
+
+TEST( RingBufferTyped, Strings ) {
+	ringbuffer::typed_ring< std::string > r( 3 );
+	std::string s;
+
+	EXPECT_EQ( 3U, r.capacity() );
+	ASSERT_TRUE( r.push_back( std::string( 64, 'a' ) ) );
+	ASSERT_NE( nullptr, r.emplace_back( 64, 'b' ) );
+	ASSERT_NE( nullptr, r.emplace_back( "c" ) );
+	EXPECT_TRUE( r.full() );
+	EXPECT_EQ( nullptr, r.emplace_back( "d" ) );
+
+	// around the wrap several times
+	for( int i = 0; i < 10; i++ ) {
+		ASSERT_TRUE( r.pop_front( s ) );
+		EXPECT_TRUE( 64U == s.size() || 1U == s.size() );
+		ASSERT_TRUE( r.push_back( std::move( s ) ) );
+	}
+	EXPECT_EQ( 3U, r.size() );
+	EXPECT_EQ( "c", r[ 1 ] );
+	EXPECT_EQ( std::string( 64, 'a' ), r.back() );
+}
+
+TEST( RingBufferTyped, UniquePtr ) {
+	ringbuffer::typed_ring< std::unique_ptr< int > > r( 2 );
+	std::unique_ptr< int > p;
+
+	ASSERT_TRUE( r.push_back( std::make_unique< int >( 1 ) ) );
+	ASSERT_TRUE( r.push_back( std::make_unique< int >( 2 ) ) );
+	ASSERT_TRUE( r.pop_front( p ) );
+	EXPECT_EQ( 1, *p );
+	ASSERT_TRUE( r.push_back( std::move( p ) ) );
+	EXPECT_EQ( nullptr, p );
+	EXPECT_EQ( 2, *r.front() );
+	EXPECT_EQ( 1, *r.back() );
+
+	ringbuffer::typed_ring< std::unique_ptr< int > > r2( std::move( r ) );
+	EXPECT_EQ( 0U, r.capacity() );
+	EXPECT_FALSE( r.pop_front( p ) );
+	EXPECT_EQ( 2U, r2.size() );
+}
+
+TEST( RingBufferTyped, Lifetimes ) {
+	Counted out( 0 );
+	Counted items[] = { 1, 2, 3 };
+
+	Counted::live = 0;
+	{
+		ringbuffer::typed_ring< Counted > r( 4 );
+		ringbuffer::typed_ring< Counted > r2( 1 );
+
+		EXPECT_EQ( 3U, r.write( items, 3 ) );
+		EXPECT_EQ( 3, Counted::live );
+		r.pop_front();
+		EXPECT_EQ( 2, Counted::live );
+		// wraps
+		EXPECT_EQ( 2U, r.write( items, 4 ) );
+		EXPECT_EQ( 4, Counted::live );
+		EXPECT_EQ( 1U, r.read( & out, 1 ) );
+		EXPECT_EQ( 2, out.v );
+		EXPECT_EQ( 3, Counted::live );
+
+		r.reset();
+		EXPECT_EQ( 0, Counted::live );
+		EXPECT_TRUE( r.empty() );
+
+		r.emplace_back( 7 );
+		r2.emplace_back( 8 );
+		EXPECT_EQ( 2, Counted::live );
+		// r2's element is destroyed in the move
+		r2 = std::move( r );
+		EXPECT_EQ( 1, Counted::live );
+		EXPECT_EQ( 7, r2.front().v );
+	}
+	EXPECT_EQ( 0, Counted::live );
+}
+
+TEST( RingBufferTyped, Trivial ) {
+	struct pt { int x, y; };
+	ringbuffer::typed_ring< pt > r( 4 );
+	pt in[ 6 ] = { { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, { 8, 9 }, { 10, 11 } };
+	pt out[ 6 ] = {};
+
+	EXPECT_EQ( 3U, r.write( in, 3 ) );
+	EXPECT_EQ( 2U, r.read( out, 2 ) );
+	EXPECT_EQ( 3U, r.write( & in[ 3 ], 6 ) );
+	// the byte ring underneath sees whole elements
+	EXPECT_EQ( 4 * sizeof( pt ), r.handle()->size( r.handle() ) );
+	EXPECT_EQ( 4U, r.read( out, 6 ) );
+	EXPECT_EQ( 4, out[ 0 ].x );
+	EXPECT_EQ( 11, out[ 3 ].y );
+}
+
+//
+// Tests for the sample windows
+//
+
+// feed random samples, evicting now and then, and compare every aggregate
+// against a recompute over a plain copy of the window
+#define SAMPLE_WINDOW_CHECK( _type, _short_type, _gen ) \
+static void sample_window_check_ ## _short_type( unsigned capacity ) { \
+	sample_window_ ## _short_type ## _t w; \
+	vector< uint64_t > buffer( sample_window_ ## _short_type ## _footprint( capacity ) / sizeof( uint64_t ) + 1 ); \
+	vector< _type > copy; \
+	_type x, mn, mx; \
+	double sum, sumsq, mean; \
+	unsigned i; \
+	ASSERT_EQ( EXIT_SUCCESS, sample_window_ ## _short_type ## _init( & w, capacity, buffer.data() ) ); \
+	EXPECT_EQ( -1, sample_window_ ## _short_type ## _min( & w, & mn ) ); \
+	EXPECT_EQ( -1, sample_window_ ## _short_type ## _evict( & w ) ); \
+	for( i = 0; i < 20 * capacity; i++ ) { \
+		if ( 0 == rand() % 7 ) { \
+			EXPECT_EQ( copy.empty() ? -1 : 0, sample_window_ ## _short_type ## _evict( & w ) ); \
+			if ( ! copy.empty() ) { \
+				copy.erase( copy.begin() ); \
+			} \
+		} else { \
+			x = _gen; \
+			ASSERT_EQ( EXIT_SUCCESS, sample_window_ ## _short_type ## _write( & w, x ) ); \
+			if ( copy.size() == capacity ) { \
+				copy.erase( copy.begin() ); \
+			} \
+			copy.push_back( x ); \
+		} \
+		ASSERT_EQ( copy.size(), sample_window_ ## _short_type ## _size( & w ) ); \
+		if ( copy.empty() ) { \
+			continue; \
+		} \
+		sum = sumsq = 0; \
+		for( _type v: copy ) { \
+			sum += v; \
+			sumsq += (double) v * v; \
+		} \
+		mean = sum / copy.size(); \
+		ASSERT_EQ( 0, sample_window_ ## _short_type ## _min( & w, & mn ) ); \
+		ASSERT_EQ( 0, sample_window_ ## _short_type ## _max( & w, & mx ) ); \
+		ASSERT_EQ( *min_element( copy.begin(), copy.end() ), mn ); \
+		ASSERT_EQ( *max_element( copy.begin(), copy.end() ), mx ); \
+		ASSERT_NEAR( sum, sample_window_ ## _short_type ## _sum( & w ), 1e-9 * ( 1 + fabs( sum ) ) ); \
+		ASSERT_NEAR( mean, sample_window_ ## _short_type ## _mean( & w ), 1e-9 * ( 1 + fabs( mean ) ) ); \
+		ASSERT_NEAR( sumsq / copy.size() - mean * mean, sample_window_ ## _short_type ## _variance( & w ), 1e-6 * ( 1 + sumsq / copy.size() ) ); \
+	} \
+}
+
+SAMPLE_WINDOW_CHECK( uint8_t, u8, (uint8_t) rand() )
+SAMPLE_WINDOW_CHECK( uint32_t, u32, (uint32_t) rand() )
+SAMPLE_WINDOW_CHECK( int64_t, s64, (int64_t) rand() - RAND_MAX / 2 )
+SAMPLE_WINDOW_CHECK( float, f32, (float) rand() / RAND_MAX - 0.5f )
+SAMPLE_WINDOW_CHECK( double, f64, 1e6 * rand() / RAND_MAX )
+
+TEST( SampleWindow, BruteForce ) {
+	unsigned caps[] = { 1, 2, 3, 17, 256 };
+	srand( 36 );
+	for( unsigned cap: caps ) {
+		sample_window_check_u8( cap );
+		sample_window_check_u32( cap );
+		sample_window_check_s64( cap );
+		sample_window_check_f32( cap );
+		sample_window_check_f64( cap );
+	}
+}
+
+TEST( SampleWindow, Monotonic ) {
+	sample_window_s32_t w;
+	uint64_t buffer[ 32 ];
+	int32_t mn, mx;
+	int i;
+
+	ASSERT_EQ( -1, sample_window_s32_init( & w, 0, buffer ) );
+	ASSERT_EQ( EXIT_SUCCESS, sample_window_s32_init( & w, 4, buffer ) );
+	// rising, then falling, input exercises each deque at its worst
+	for( i = 0; i < 10; i++ ) {
+		sample_window_s32_write( & w, i );
+	}
+	sample_window_s32_min( & w, & mn );
+	sample_window_s32_max( & w, & mx );
+	EXPECT_EQ( 6, mn );
+	EXPECT_EQ( 9, mx );
+	for( i = 10; i > 0; i-- ) {
+		sample_window_s32_write( & w, i );
+	}
+	sample_window_s32_min( & w, & mn );
+	sample_window_s32_max( & w, & mx );
+	EXPECT_EQ( 1, mn );
+	EXPECT_EQ( 4, mx );
+	EXPECT_DOUBLE_EQ( 2.5, sample_window_s32_mean( & w ) );
+	EXPECT_DOUBLE_EQ( 1.25, sample_window_s32_variance( & w ) );
+
+	sample_window_s32_reset( & w );
+	EXPECT_EQ( 0U, sample_window_s32_size( & w ) );
+	EXPECT_EQ( -1, sample_window_s32_max( & w, & mx ) );
+}
+
+//
+// Tests for ring_buffer_seq_t
+//
+
+TEST( RingBufferSeq, Snapshot ) {
+	ring_buffer_seq_t s;
+	uint8_t storage[ 8 ];
+	char snap[ 8 ] = {};
+	ring_buffer_t *r = & s.rb;
+
+	ASSERT_EQ( -1, ring_buffer_seq_init( NULL, sizeof( storage ), storage ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_seq_init( & s, sizeof( storage ), storage ) );
+	EXPECT_EQ( 0, ring_buffer_seq_snapshot( & s, snap, sizeof( snap ), 1 ) );
+
+	EXPECT_EQ( 6, r->write( r, (void *) "abcdef", 6 ) );
+	EXPECT_EQ( 4, r->skip( r, 4 ) );
+	EXPECT_EQ( 5, r->write( r, (void *) "ghijk", 5 ) );
+	EXPECT_EQ( 6U, s.seq );
+	// across the wrap, and truncated
+	EXPECT_EQ( 7, ring_buffer_seq_snapshot( & s, snap, 7, 1 ) );
+	EXPECT_EQ( 0, memcmp( "efghijk", snap, 7 ) );
+	EXPECT_EQ( 3, ring_buffer_seq_snapshot( & s, snap, 3, 1 ) );
+	EXPECT_EQ( 0, memcmp( "efg", snap, 3 ) );
+
+	// an operation in progress
+	s.seq++;
+	EXPECT_EQ( -EAGAIN, ring_buffer_seq_snapshot( & s, snap, 7, 3 ) );
+	s.seq++;
+
+	r->realign( r );
+	EXPECT_EQ( 0U, r->head );
+	EXPECT_EQ( 10U, s.seq );
+	r->reset( r );
+	EXPECT_EQ( 0, ring_buffer_seq_snapshot( & s, snap, 7, 1 ) );
+
+	// the free writers end with commit(), which counts like any operation
+	EXPECT_EQ( 1, ring_buffer_write8( r, 'x' ) );
+	EXPECT_EQ( 14U, s.seq );
+	EXPECT_EQ( 1, ring_buffer_seq_snapshot( & s, snap, 7, 1 ) );
+	EXPECT_EQ( 'x', snap[ 0 ] );
+}
+
+// stands in for the wrapped realign, to see the counter from inside an operation
+static ring_buffer_seq_t *seq_probe_ring;
+static void ( *seq_probe_realign )( ring_buffer_t *rb );
+static unsigned seq_probe_calls;
+static unsigned seq_probe_even;
+
+static void seq_probe( ring_buffer_t *rb ) {
+	seq_probe_calls++;
+	if ( 0 == seq_probe_ring->seq % 2 ) {
+		seq_probe_even++;
+	}
+	seq_probe_realign( rb );
+}
+
+// send() realigns its output, which is itself a wrapped operation
+TEST( RingBufferSeq, SendOutput ) {
+	ring_buffer_seq_t s;
+	ring_buffer_t in;
+	uint8_t storage[ 8 ];
+	uint8_t in_storage[ 8 ];
+	char snap[ 8 ] = {};
+	ring_buffer_t *r = & s.rb;
+	unsigned seq0;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_seq_init( & s, sizeof( storage ), storage ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_init( & in, sizeof( in_storage ), in_storage ) );
+	seq_probe_ring = & s;
+	seq_probe_realign = s.realign;
+	seq_probe_calls = 0;
+	seq_probe_even = 0;
+	s.realign = seq_probe;
+
+	// leave the output wrapped, so that send() has to move it
+	EXPECT_EQ( 6, r->write( r, (void *) "abcdef", 6 ) );
+	EXPECT_EQ( 5, r->skip( r, 5 ) );
+	EXPECT_EQ( 3, in.write( & in, (void *) "ghi", 3 ) );
+
+	seq0 = s.seq;
+	EXPECT_EQ( 3, r->send( r, & in, 3 ) );
+	EXPECT_EQ( 1U, seq_probe_calls );
+	EXPECT_EQ( 0U, seq_probe_even );
+	EXPECT_EQ( seq0 + 2, s.seq );
+	EXPECT_EQ( 0U, s.depth );
+	EXPECT_EQ( 4, ring_buffer_seq_snapshot( & s, snap, sizeof( snap ), 1 ) );
+	EXPECT_EQ( 0, memcmp( "fghi", snap, 4 ) );
+}
+
+// a ring that is the input of a send() only changes through its own skip()
+TEST( RingBufferSeq, SendInput ) {
+	ring_buffer_seq_t s;
+	ring_buffer_t out;
+	uint8_t storage[ 8 ];
+	uint8_t copy[ 8 ];
+	uint8_t out_storage[ 8 ];
+	uint8_t got[ 8 ];
+	ring_buffer_t *r = & s.rb;
+	unsigned seq0;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_seq_init( & s, sizeof( storage ), storage ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_init( & out, sizeof( out_storage ), out_storage ) );
+	seq_probe_ring = & s;
+	seq_probe_realign = s.realign;
+	seq_probe_calls = 0;
+	s.realign = seq_probe;
+
+	// wrap the input
+	EXPECT_EQ( 6, r->write( r, (void *) "abcdef", 6 ) );
+	EXPECT_EQ( 4, r->skip( r, 4 ) );
+	EXPECT_EQ( 5, r->write( r, (void *) "ghijk", 5 ) );
+	memcpy( copy, storage, sizeof( copy ) );
+
+	seq0 = s.seq;
+	EXPECT_EQ( 6, out.send( & out, r, 6 ) );
+	EXPECT_EQ( 0U, seq_probe_calls );
+	EXPECT_EQ( 0, memcmp( copy, storage, sizeof( copy ) ) );
+	EXPECT_EQ( seq0 + 2, s.seq );
+	EXPECT_EQ( 1, r->size( r ) );
+	EXPECT_EQ( 6, out.read( & out, got, 6 ) );
+	EXPECT_EQ( 0, memcmp( "efghij", got, 6 ) );
+}
+
+// the producer appends consecutive 64-bit counters, discarding the oldest to
+// make room, while observers check that every snapshot is an unbroken run
+TEST( RingBufferSeq, Stress ) {
+	static const unsigned cap = 4096 * sizeof( uint64_t );
+	ring_buffer_seq_t s;
+	vector< uint8_t > storage( cap );
+	atomic< bool > done( false );
+	atomic< unsigned > snaps( 0 );
+	atomic< unsigned > bad( 0 );
+	vector< thread > observers;
+	uint64_t next = 0;
+	uint64_t batch[ 5 ];
+	unsigned i;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_seq_init( & s, cap, & storage[ 0 ] ) );
+
+	for( i = 0; i < 2; i++ ) {
+		observers.push_back( thread( [ & ]() {
+			vector< uint64_t > snap( cap / sizeof( uint64_t ) );
+			int r;
+			while( ! done ) {
+				r = ring_buffer_seq_snapshot( & s, & snap[ 0 ], cap, 0 );
+				if ( r < 0 || 0 != r % sizeof( uint64_t ) ) {
+					bad++;
+					continue;
+				}
+				for( unsigned j = 1; j < r / sizeof( uint64_t ); j++ ) {
+					if ( snap[ j ] != snap[ j - 1 ] + 1 ) {
+						bad++;
+						break;
+					}
+				}
+				snaps++;
+			}
+		} ) );
+	}
+
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds( 300 );
+	while( chrono::steady_clock::now() < deadline || snaps < 100 ) {
+		for( i = 0; i < 1000; i++ ) {
+			for( auto &v: batch ) {
+				v = next++;
+			}
+			if ( s.rb.available( & s.rb ) < sizeof( batch ) ) {
+				s.rb.skip( & s.rb, sizeof( batch ) );
+			}
+			s.rb.write( & s.rb, batch, sizeof( batch ) );
+		}
+	}
+	done = true;
+	for( auto &th: observers ) {
+		th.join();
+	}
+
+	EXPECT_EQ( 0U, bad.load() );
+	EXPECT_GE( snaps.load(), 100U );
+}
+
+//
+// Tests for histogram_t
+//
+
+TEST( Histogram, Percentiles ) {
+	histogram_t *h = new histogram_t;
+	uint64_t v;
+
+	histogram_reset( h );
+	EXPECT_EQ( 0U, histogram_percentile( h, 50 ) );
+
+	// small values are exact
+	for( v = 1; v <= 10; v++ ) {
+		histogram_record( h, v );
+	}
+	EXPECT_EQ( 10U, histogram_count( h ) );
+	EXPECT_EQ( 1U, histogram_percentile( h, 0 ) );
+	EXPECT_EQ( 5U, histogram_percentile( h, 50 ) );
+	EXPECT_EQ( 9U, histogram_percentile( h, 90 ) );
+	EXPECT_EQ( 10U, histogram_percentile( h, 100 ) );
+	EXPECT_DOUBLE_EQ( 5.5, histogram_mean( h ) );
+
+	// large ones to within the sub-bucket resolution, and never below
+	histogram_reset( h );
+	for( v = 1; v <= 100000; v++ ) {
+		histogram_record( h, v * 1000 );
+	}
+	for( double p: { 1.0, 25.0, 50.0, 99.0, 99.9, 100.0 } ) {
+		double want = p * 1000 * 1000;
+		uint64_t got = histogram_percentile( h, p );
+		EXPECT_GE( got, want * ( 1 - 1.0 / 32 ) ) << p;
+		EXPECT_LE( got, want * ( 1 + 1.0 / 32 ) ) << p;
+	}
+	EXPECT_EQ( 100000000U, histogram_max( h ) );
+
+	histogram_record( h, UINT64_MAX );
+	EXPECT_EQ( UINT64_MAX, histogram_percentile( h, 100 ) );
+
+	delete h;
+}
+
+TEST( Histogram, Concurrent ) {
+	histogram_t *h = new histogram_t;
+	vector< thread > threads;
+
+	histogram_reset( h );
+	for( unsigned i = 0; i < 4; i++ ) {
+		threads.push_back( thread( [ h, i ]() {
+			for( uint64_t v = 0; v < 100000; v++ ) {
+				histogram_record( h, v * ( i + 1 ) );
+			}
+		} ) );
+	}
+	for( auto &th: threads ) {
+		th.join();
+	}
+	EXPECT_EQ( 400000U, histogram_count( h ) );
+	EXPECT_EQ( 399996U, histogram_max( h ) );
+
+	delete h;
+}
+
+//
+// Tests for ring_buffer_ts_t
+//
+
+static uint64_t fake_clock( void *arg ) {
+	return *(uint64_t *) arg;
+}
+
+TEST( RingBufferTs, Residence ) {
+	ring_buffer_ts_t t;
+	ring_buffer_ts_stamp_t stamps[ 2 ];
+	uint8_t storage[ 16 ];
+	uint8_t buf[ 16 ];
+	histogram_t *h = new histogram_t;
+	// times are kept below 2^HISTOGRAM_SUB_BITS, where the histogram is exact
+	uint64_t now = 1;
+	ring_buffer_t *r = & t.rb;
+
+	histogram_reset( h );
+	ASSERT_EQ( -1, ring_buffer_ts_init( & t, sizeof( storage ), storage, stamps, 0, fake_clock, & now, h ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_ts_init( & t, sizeof( storage ), storage, stamps, 2, fake_clock, & now, h ) );
+
+	EXPECT_EQ( 3, r->write( r, (void *) "abc", 3 ) );
+	now = 2;
+	EXPECT_EQ( 2, r->write( r, (void *) "de", 2 ) );
+	now = 2;
+	// the first write is not yet consumed in full
+	EXPECT_EQ( 2, r->read( r, buf, 2 ) );
+	EXPECT_EQ( 0U, histogram_count( h ) );
+	now = 3;
+	EXPECT_EQ( 2, r->skip( r, 2 ) );
+	EXPECT_EQ( 1U, histogram_count( h ) );
+	EXPECT_EQ( 2U, histogram_percentile( h, 100 ) );
+
+	// the side ring is full: "gh" is merged into "f" and takes its stamp
+	now = 4;
+	EXPECT_EQ( 1, r->write( r, (void *) "f", 1 ) );
+	now = 5;
+	EXPECT_EQ( 2, r->write( r, (void *) "gh", 2 ) );
+	now = 6;
+	EXPECT_EQ( 4, r->read( r, buf, 16 ) );
+	EXPECT_EQ( 3U, histogram_count( h ) );
+	EXPECT_EQ( 2U, histogram_percentile( h, 50 ) );
+	EXPECT_EQ( 4U, histogram_percentile( h, 100 ) );
+
+	// discarded data is not recorded, and positions restart
+	EXPECT_EQ( 2, r->write( r, (void *) "ij", 2 ) );
+	r->reset( r );
+	EXPECT_EQ( 1, r->write( r, (void *) "k", 1 ) );
+	now = 11;
+	EXPECT_EQ( 1, r->read( r, buf, 1 ) );
+	EXPECT_EQ( 4U, histogram_count( h ) );
+	EXPECT_EQ( 5U, histogram_percentile( h, 100 ) );
+
+	delete h;
+}
+
+// the free readers consume through skip(), so they keep the positions in step
+// with the writes made through the ring's own operations
+TEST( RingBufferTs, FreeReaders ) {
+	ring_buffer_ts_t t;
+	ring_buffer_ts_stamp_t stamps[ 4 ];
+	uint8_t storage[ 16 ];
+	uint8_t a[ 3 ], b[ 2 ];
+	uint32_t v;
+	histogram_t *h = new histogram_t;
+	uint64_t now = 1;
+	ring_buffer_t *r = & t.rb;
+	ring_buffer_codec_t c;
+	struct iovec iov[ 2 ];
+
+	histogram_reset( h );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_ts_init( & t, sizeof( storage ), storage, stamps, 4, fake_clock, & now, h ) );
+
+	EXPECT_EQ( 5, r->write( r, (void *) "abcde", 5 ) );
+	now = 2;
+	EXPECT_EQ( 4, r->write( r, (void *) "fghi", 4 ) );
+	now = 4;
+	iov[ 0 ].iov_base = a; iov[ 0 ].iov_len = sizeof( a );
+	iov[ 1 ].iov_base = b; iov[ 1 ].iov_len = sizeof( b );
+	EXPECT_EQ( 5, ring_buffer_readv( r, iov, 2, 1 ) );
+	EXPECT_EQ( 1U, histogram_count( h ) );
+	EXPECT_EQ( 3U, histogram_percentile( h, 100 ) );
+
+	now = 7;
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_decode_begin( & c, r ) );
+	EXPECT_EQ( 0, ring_buffer_get_u32le( & c, & v ) );
+	EXPECT_EQ( 4, ring_buffer_decode_commit( & c ) );
+	EXPECT_EQ( 2U, histogram_count( h ) );
+	EXPECT_EQ( 5U, histogram_percentile( h, 100 ) );
+	EXPECT_EQ( t.written, t.consumed );
+
+	delete h;
+}
+
+// the free writers end with commit(), and are stamped like write()
+TEST( RingBufferTs, FreeWriters ) {
+	ring_buffer_ts_t t;
+	ring_buffer_ts_stamp_t stamps[ 4 ];
+	uint8_t storage[ 16 ];
+	uint8_t buf[ 16 ];
+	uint32_t crc = 0;
+	histogram_t *h = new histogram_t;
+	uint64_t now = 1;
+	ring_buffer_t *r = & t.rb;
+	ring_buffer_codec_t c;
+	struct iovec iov[ 2 ];
+
+	histogram_reset( h );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_ts_init( & t, sizeof( storage ), storage, stamps, 4, fake_clock, & now, h ) );
+
+	iov[ 0 ].iov_base = (void *) "ab"; iov[ 0 ].iov_len = 2;
+	iov[ 1 ].iov_base = (void *) "c"; iov[ 1 ].iov_len = 1;
+	EXPECT_EQ( 3, ring_buffer_writev( r, iov, 2, 1 ) );
+	now = 3;
+	EXPECT_EQ( 4, ring_buffer_write32( r, 0x64636261 ) );
+	now = 6;
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_encode_begin( & c, r ) );
+	EXPECT_EQ( 0, ring_buffer_put_u16le( & c, 0x6261 ) );
+	EXPECT_EQ( 2, ring_buffer_encode_commit( & c ) );
+	EXPECT_EQ( 9U, t.written );
+
+	now = 10;
+	EXPECT_EQ( 9, ring_buffer_read_crc32c( r, buf, sizeof( buf ), & crc ) );
+	EXPECT_EQ( 3U, histogram_count( h ) );
+	EXPECT_EQ( 9U, histogram_percentile( h, 100 ) );
+	EXPECT_EQ( t.written, t.consumed );
+
+	delete h;
+}
+
+TEST( RingBufferTs, Monotonic ) {
+	ring_buffer_ts_t t;
+	ring_buffer_ts_stamp_t stamps[ 8 ];
+	uint8_t storage[ 64 ];
+	uint8_t buf[ 64 ];
+	histogram_t *h = new histogram_t;
+	ring_buffer_t *r = & t.rb;
+
+	histogram_reset( h );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_ts_init( & t, sizeof( storage ), storage, stamps, 8, NULL, NULL, h ) );
+	EXPECT_EQ( 10, r->write( r, buf, 10 ) );
+	usleep( 2000 );
+	EXPECT_EQ( 10, r->read( r, buf, sizeof( buf ) ) );
+	EXPECT_EQ( 1U, histogram_count( h ) );
+	EXPECT_GE( histogram_max( h ), 2000000U );
+
+	delete h;
+}
+
+//
+// Tests for ring_buffer_mpsc_t
+//
+
+TEST( RingBufferMpsc, Chunks ) {
+	ring_buffer_mpsc_t mpsc;
+	ring_buffer_mpsc_producer_t a, b;
+	uint64_t storage[ 4 * 2 ];
+	char buf[ 32 ] = {};
+
+	ASSERT_EQ( -1, ring_buffer_mpsc_init( & mpsc, sizeof( storage ), storage, 24 ) );
+	ASSERT_EQ( -1, ring_buffer_mpsc_init( & mpsc, sizeof( storage ), storage, RING_BUFFER_MPSC_HEADER ) );
+	// four chunks of 8 bytes of data each
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_mpsc_init( & mpsc, sizeof( storage ), storage, 16 ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_mpsc_producer_init( & a, & mpsc ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_mpsc_producer_init( & b, & mpsc ) );
+
+	EXPECT_EQ( -1, ring_buffer_mpsc_write( & a, "123456789", 9 ) );
+	EXPECT_EQ( 3, ring_buffer_mpsc_write( & a, "abc", 3 ) );
+	EXPECT_EQ( 3, ring_buffer_mpsc_write( & b, "xyz", 3 ) );
+	// nothing is visible until published
+	EXPECT_EQ( 0, ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) ) );
+	ring_buffer_mpsc_publish( & b );
+	EXPECT_EQ( 0, ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) ) );
+	ring_buffer_mpsc_publish( & a );
+	EXPECT_EQ( 3, ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) ) );
+	EXPECT_EQ( 0, memcmp( "abc", buf, 3 ) );
+
+	// "efgh" does not fit in a's chunk, which is sealed with its unused tail
+	EXPECT_EQ( 2, ring_buffer_mpsc_write( & a, "de", 2 ) );
+	EXPECT_EQ( 4, ring_buffer_mpsc_write( & a, "efgh", 4 ) );
+	ring_buffer_mpsc_publish( & a );
+	EXPECT_EQ( 5, ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) ) );
+	EXPECT_EQ( 0, memcmp( "dexyz", buf, 5 ) );
+	ring_buffer_mpsc_flush( & b );
+	EXPECT_EQ( 4, ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) ) );
+	EXPECT_EQ( 0, memcmp( "efgh", buf, 4 ) );
+
+	// fill the ring: a holds chunk 2, and chunks 3, 4 and 5 are free
+	for( int i = 0; i < 3; i++ ) {
+		EXPECT_EQ( 8, ring_buffer_mpsc_write( & b, "01234567", 8 ) );
+	}
+	ring_buffer_mpsc_flush( & b );
+	EXPECT_EQ( 0, ring_buffer_mpsc_write( & b, "8", 1 ) );
+	// draining a's chunk makes room
+	ring_buffer_mpsc_flush( & a );
+	EXPECT_EQ( 8, ring_buffer_mpsc_read( & mpsc, buf, 8 ) );
+	EXPECT_EQ( 1, ring_buffer_mpsc_write( & b, "8", 1 ) );
+	ring_buffer_mpsc_flush( & b );
+	EXPECT_EQ( 17, ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) ) );
+	EXPECT_EQ( 0, memcmp( "01234567012345678", buf, 17 ) );
+	EXPECT_EQ( 0, ring_buffer_mpsc_read( & mpsc, buf, sizeof( buf ) ) );
+}
+
+// every producer's records must arrive complete and in its own order
+TEST( RingBufferMpsc, Stress ) {
+	static const unsigned nproducers = 8;
+	static const uint64_t nrecords = 50000;
+	ring_buffer_mpsc_t mpsc;
+	vector< uint64_t > storage( 64 * 1024 / sizeof( uint64_t ) );
+	vector< thread > producers;
+	vector< uint64_t > next( nproducers, 0 );
+	uint64_t rec[ 2 ];
+	uint64_t got;
+	int r;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_mpsc_init( & mpsc, storage.size() * sizeof( uint64_t ), & storage[ 0 ], 1024 ) );
+
+	for( unsigned i = 0; i < nproducers; i++ ) {
+		producers.push_back( thread( [ & mpsc, i ]() {
+			ring_buffer_mpsc_producer_t p;
+			uint64_t rec[ 2 ];
+			ring_buffer_mpsc_producer_init( & p, & mpsc );
+			for( uint64_t j = 0; j < nrecords; j++ ) {
+				rec[ 0 ] = i;
+				rec[ 1 ] = j;
+				while( 0 == ring_buffer_mpsc_write( & p, rec, sizeof( rec ) ) ) {
+					this_thread::yield();
+				}
+				if ( 0 == j % 16 ) {
+					ring_buffer_mpsc_publish( & p );
+				}
+			}
+			ring_buffer_mpsc_flush( & p );
+		} ) );
+	}
+
+	for( got = 0; got < nproducers * nrecords; ) {
+		r = ring_buffer_mpsc_read( & mpsc, rec, sizeof( rec ) );
+		if ( 0 == r ) {
+			this_thread::yield();
+			continue;
+		}
+		ASSERT_EQ( (int) sizeof( rec ), r );
+		ASSERT_LT( rec[ 0 ], nproducers );
+		ASSERT_EQ( next[ rec[ 0 ] ], rec[ 1 ] );
+		next[ rec[ 0 ] ]++;
+		got++;
+	}
+	for( auto &th: producers ) {
+		th.join();
+	}
+	EXPECT_EQ( 0, ring_buffer_mpsc_read( & mpsc, rec, sizeof( rec ) ) );
+}
+
+//
+// Tests for ring_buffer_trace_t
+//
+
+TEST( RingBufferTrace, RecordReplay ) {
+	ring_buffer_trace_t t;
+	ring_buffer_trace_stats_t stats = {};
+	ring_buffer_trace_header_t h;
+	ring_buffer_trace_rec_t rec;
+	ring_buffer_t in, replay;
+	uint8_t storage[ 16 ], in_storage[ 8 ], replay_storage[ 16 ], small_storage[ 4 ];
+	uint8_t buf[ 16 ];
+	ring_buffer_t *r = & t.rb;
+	histogram_t *h_write = new histogram_t;
+	FILE *f = tmpfile();
+
+	ASSERT_NE( nullptr, f );
+	ASSERT_EQ( -1, ring_buffer_trace_init( & t, sizeof( storage ), storage, NULL ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_trace_init( & t, sizeof( storage ), storage, f ) );
+	ring_buffer_init( & in, sizeof( in_storage ), in_storage );
+	in.write( & in, (void *) "12345678", 8 );
+
+	EXPECT_EQ( 10, r->write( r, (void *) "abcdefghij", 10 ) );
+	EXPECT_EQ( 4, r->peek( r, buf, 4 ) );
+	EXPECT_EQ( 6, r->read( r, buf, 6 ) );
+	EXPECT_EQ( 8, r->send( r, & in, 8 ) );
+	EXPECT_EQ( 2, r->skip( r, 2 ) );
+	r->realign( r );
+	EXPECT_EQ( 6, r->write( r, (void *) "klmnopqr", 8 ) );
+	r->reset( r );
+	EXPECT_EQ( 0, r->read( r, buf, 1 ) );
+	ASSERT_EQ( 0, ring_buffer_trace_flush( & t ) );
+
+	// the file: a header, then one record per operation
+	rewind( f );
+	ASSERT_EQ( 1U, fread( & h, sizeof( h ), 1, f ) );
+	EXPECT_EQ( (uint32_t) RING_BUFFER_TRACE_MAGIC, h.magic );
+	EXPECT_EQ( 16U, h.capacity );
+	ASSERT_EQ( 1U, fread( & rec, sizeof( rec ), 1, f ) );
+	EXPECT_EQ( RING_BUFFER_TRACE_WRITE, rec.op );
+	EXPECT_EQ( 10U, rec.size );
+	EXPECT_EQ( 10, rec.result );
+	EXPECT_EQ( 0, fseek( f, 0, SEEK_END ) );
+	EXPECT_EQ( (long)( sizeof( h ) + 9 * sizeof( rec ) ), ftell( f ) );
+
+	// an identical ring reproduces every result
+	histogram_reset( h_write );
+	stats.latency[ RING_BUFFER_TRACE_WRITE ] = h_write;
+	ring_buffer_init( & replay, sizeof( replay_storage ), replay_storage );
+	EXPECT_EQ( 9, ring_buffer_trace_replay( f, & replay, 0, & stats ) );
+	EXPECT_EQ( 0U, stats.mismatches );
+	EXPECT_EQ( 2U, stats.ops[ RING_BUFFER_TRACE_WRITE ] );
+	EXPECT_EQ( 2U, stats.ops[ RING_BUFFER_TRACE_READ ] );
+	EXPECT_EQ( 1U, stats.ops[ RING_BUFFER_TRACE_SEND ] );
+	EXPECT_EQ( 1U, stats.ops[ RING_BUFFER_TRACE_REALIGN ] );
+	EXPECT_EQ( 10U + 4 + 6 + 8 + 2 + 6, stats.bytes );
+	EXPECT_EQ( 2U, histogram_count( h_write ) );
+	EXPECT_GT( stats.elapsed_ns, 0U );
+
+	// a smaller one does not
+	ring_buffer_init( & replay, sizeof( small_storage ), small_storage );
+	EXPECT_EQ( 9, ring_buffer_trace_replay( f, & replay, 1, & stats ) );
+	EXPECT_GT( stats.mismatches, 0U );
+
+	// recorded sizes far beyond the replay ring need no more memory than it
+	// holds, and sizes that move no data need none at all
+	FILE *g = tmpfile();
+	ASSERT_NE( nullptr, g );
+	fwrite( & h, sizeof( h ), 1, g );
+	for( uint8_t op: { RING_BUFFER_TRACE_SKIP, RING_BUFFER_TRACE_WRITE, RING_BUFFER_TRACE_SEND, RING_BUFFER_TRACE_READ } ) {
+		rec = {};
+		rec.op = op;
+		rec.size = 0xfffffff0;
+		fwrite( & rec, sizeof( rec ), 1, g );
+	}
+	fflush( g );
+	ring_buffer_init( & replay, sizeof( small_storage ), small_storage );
+	EXPECT_EQ( 4, ring_buffer_trace_replay( g, & replay, 0, & stats ) );
+	EXPECT_EQ( 4U + 4, stats.bytes );
+	fclose( g );
+
+	// not a trace
+	rewind( f );
+	fwrite( "nope", 4, 1, f );
+	fflush( f );
+	EXPECT_EQ( -1, ring_buffer_trace_replay( f, & replay, 0, & stats ) );
+
+	fclose( f );
+	delete h_write;
+}
+
+// the free functions are recorded as the commit() or skip() they end with
+TEST( RingBufferTrace, FreeFunctions ) {
+	ring_buffer_trace_t t;
+	ring_buffer_trace_stats_t stats = {};
+	ring_buffer_trace_header_t h;
+	ring_buffer_t replay;
+	uint8_t storage[ 16 ], replay_storage[ 16 ];
+	uint16_t v;
+	ring_buffer_t *r = & t.rb;
+	struct iovec iov = { (void *) "abcdef", 6 };
+	FILE *f = tmpfile();
+
+	ASSERT_NE( nullptr, f );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_trace_init( & t, sizeof( storage ), storage, f ) );
+	EXPECT_EQ( 4, ring_buffer_write32( r, 1 ) );
+	EXPECT_EQ( 6, ring_buffer_writev( r, & iov, 1, 1 ) );
+	EXPECT_EQ( 2, ring_buffer_read16( r, & v ) );
+	ASSERT_EQ( 0, ring_buffer_trace_flush( & t ) );
+
+	ring_buffer_init( & replay, sizeof( replay_storage ), replay_storage );
+	EXPECT_EQ( 3, ring_buffer_trace_replay( f, & replay, 0, & stats ) );
+	EXPECT_EQ( 0U, stats.mismatches );
+	EXPECT_EQ( 2U, stats.ops[ RING_BUFFER_TRACE_COMMIT ] );
+	EXPECT_EQ( 1U, stats.ops[ RING_BUFFER_TRACE_SKIP ] );
+	EXPECT_EQ( 8U, replay.len );
+
+	// traces from before commit was added are still read
+	rewind( f );
+	ASSERT_EQ( 1U, fread( & h, sizeof( h ), 1, f ) );
+	EXPECT_EQ( (uint32_t) RING_BUFFER_TRACE_VERSION, h.version );
+	h.version = 1;
+	rewind( f );
+	fwrite( & h, sizeof( h ), 1, f );
+	fflush( f );
+	ring_buffer_init( & replay, sizeof( replay_storage ), replay_storage );
+	EXPECT_EQ( 3, ring_buffer_trace_replay( f, & replay, 0, & stats ) );
+	h.version = RING_BUFFER_TRACE_VERSION + 1;
+	rewind( f );
+	fwrite( & h, sizeof( h ), 1, f );
+	fflush( f );
+	EXPECT_EQ( -1, ring_buffer_trace_replay( f, & replay, 0, & stats ) );
+
+	fclose( f );
+}
+
+//
+// Tests for the in-place encoders and decoders
+//
+
+TEST( RingBufferCodec, Layout ) {
+	uint8_t storage[ 64 ];
+	uint8_t out[ 64 ];
+	ring_buffer_t rb;
+	ring_buffer_codec_t c;
+	static const uint8_t want[] = {
+		0x34, 0x12,
+		0x12, 0x34,
+		0x78, 0x56, 0x34, 0x12,
+		0x12, 0x34, 0x56, 0x78,
+		0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
+		0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+		0x00, 0x7f, 0xac, 0x02,
+		0x03, 'a', 'b', 'c',
+	};
+
+	ring_buffer_init( & rb, sizeof( storage ), storage );
+	ASSERT_EQ( -1, ring_buffer_encode_begin( & c, NULL ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_encode_begin( & c, & rb ) );
+	ring_buffer_put_u16le( & c, 0x1234 );
+	ring_buffer_put_u16be( & c, 0x1234 );
+	ring_buffer_put_u32le( & c, 0x12345678 );
+	ring_buffer_put_u32be( & c, 0x12345678 );
+	ring_buffer_put_u64le( & c, 0x0102030405060708ull );
+	ring_buffer_put_u64be( & c, 0x0102030405060708ull );
+	ring_buffer_put_varint( & c, 0 );
+	ring_buffer_put_varint( & c, 127 );
+	ring_buffer_put_varint( & c, 300 );
+	ring_buffer_put_bytes( & c, "abc", 3 );
+	// nothing is visible before the commit
+	EXPECT_EQ( 0U, rb.len );
+	EXPECT_EQ( (int) sizeof( want ), ring_buffer_encode_commit( & c ) );
+	ASSERT_EQ( (int) sizeof( want ), rb.read( & rb, out, sizeof( out ) ) );
+	EXPECT_EQ( 0, memcmp( want, out, sizeof( want ) ) );
+}
+
+TEST( RingBufferCodec, RoundTripWrap ) {
+	uint8_t storage[ 40 ];
+	ring_buffer_t rb;
+	ring_buffer_codec_t c;
+	uint16_t a;
+	uint32_t b;
+	uint64_t d, e, f;
+	char s[ 8 ];
+	unsigned head;
+
+	ring_buffer_init( & rb, sizeof( storage ), storage );
+	// the 38-byte record straddles the end of storage at every possible point
+	for( head = 0; head < sizeof( storage ); head++ ) {
+		rb.reset( & rb );
+		rb.head = head;
+		ASSERT_EQ( EXIT_SUCCESS, ring_buffer_encode_begin( & c, & rb ) );
+		ring_buffer_put_u16be( & c, 0xbeef );
+		ring_buffer_put_u32le( & c, 0xdeadbeef );
+		ring_buffer_put_u64be( & c, 0x1122334455667788ull );
+		ring_buffer_put_varint( & c, UINT64_MAX );
+		ring_buffer_put_u64le( & c, head );
+		ring_buffer_put_bytes( & c, "hello", 5 );
+		ASSERT_EQ( 38, ring_buffer_encode_commit( & c ) ) << head;
+
+		ASSERT_EQ( EXIT_SUCCESS, ring_buffer_decode_begin( & c, & rb ) );
+		EXPECT_EQ( 0, ring_buffer_get_u16be( & c, & a ) );
+		EXPECT_EQ( 0, ring_buffer_get_u32le( & c, & b ) );
+		EXPECT_EQ( 0, ring_buffer_get_u64be( & c, & d ) );
+		EXPECT_EQ( 0, ring_buffer_get_varint( & c, & e ) );
+		EXPECT_EQ( 0, ring_buffer_get_u64le( & c, & f ) );
+		EXPECT_EQ( 5, ring_buffer_get_bytes( & c, s, sizeof( s ) ) );
+		EXPECT_EQ( 0xbeef, a );
+		EXPECT_EQ( 0xdeadbeef, b );
+		EXPECT_EQ( 0x1122334455667788ull, d );
+		EXPECT_EQ( UINT64_MAX, e );
+		EXPECT_EQ( head, f );
+		EXPECT_EQ( 0, memcmp( "hello", s, 5 ) );
+		EXPECT_EQ( 38U, rb.len );
+		EXPECT_EQ( 38, ring_buffer_decode_commit( & c ) );
+		EXPECT_EQ( 0U, rb.len );
+	}
+}
+
+TEST( RingBufferCodec, Failures ) {
+	uint8_t storage[ 8 ];
+	ring_buffer_t rb;
+	ring_buffer_codec_t c;
+	uint32_t v;
+	uint64_t x;
+	char s[ 2 ];
+	uint8_t big[ 16 ];
+	ring_buffer_t brb;
+
+	ring_buffer_init( & rb, sizeof( storage ), storage );
+
+	// a record that does not fit is not written at all
+	ring_buffer_encode_begin( & c, & rb );
+	EXPECT_EQ( 0, ring_buffer_put_u32le( & c, 1 ) );
+	EXPECT_EQ( -1, ring_buffer_put_u64le( & c, 2 ) );
+	EXPECT_EQ( -1, ring_buffer_put_u16le( & c, 3 ) );
+	EXPECT_EQ( -1, ring_buffer_encode_commit( & c ) );
+	EXPECT_EQ( 0U, rb.len );
+
+	// an incomplete record is not consumed
+	ring_buffer_encode_begin( & c, & rb );
+	ring_buffer_put_u32le( & c, 1 );
+	ring_buffer_put_varint( & c, 1 << 20 );
+	EXPECT_EQ( 7, ring_buffer_encode_commit( & c ) );
+	rb.len -= 1;
+	ring_buffer_decode_begin( & c, & rb );
+	EXPECT_EQ( 0, ring_buffer_get_u32le( & c, & v ) );
+	EXPECT_EQ( -1, ring_buffer_get_varint( & c, & x ) );
+	EXPECT_EQ( -1, ring_buffer_decode_commit( & c ) );
+	EXPECT_EQ( 6U, rb.len );
+
+	// a string longer than the caller's buffer
+	rb.reset( & rb );
+	ring_buffer_encode_begin( & c, & rb );
+	ring_buffer_put_bytes( & c, "abc", 3 );
+	ring_buffer_encode_commit( & c );
+	ring_buffer_decode_begin( & c, & rb );
+	EXPECT_EQ( -1, ring_buffer_get_bytes( & c, s, sizeof( s ) ) );
+	EXPECT_EQ( -1, ring_buffer_decode_commit( & c ) );
+	EXPECT_EQ( 4U, rb.len );
+
+	// an over-long varint
+	rb.reset( & rb );
+	memset( storage, 0xff, sizeof( storage ) );
+	rb.len = sizeof( storage );
+	ring_buffer_decode_begin( & c, & rb );
+	EXPECT_EQ( -1, ring_buffer_get_varint( & c, & x ) );
+
+	// a 10th byte may only hold bit 63, and must end the varint
+	ring_buffer_init( & brb, sizeof( big ), big );
+	for( uint8_t last: { 0x01, 0x02, 0x81 } ) {
+		brb.reset( & brb );
+		memset( big, 0xff, 9 );
+		big[ 9 ] = last;
+		big[ 10 ] = 0x00;
+		brb.len = 11;
+		ring_buffer_decode_begin( & c, & brb );
+		EXPECT_EQ( 0x01 == last ? 0 : -1, ring_buffer_get_varint( & c, & x ) ) << (unsigned) last;
+	}
+	EXPECT_EQ( UINT64_MAX, x );
+
+	// empty bytes need no buffer on either side
+	rb.reset( & rb );
+	ring_buffer_encode_begin( & c, & rb );
+	EXPECT_EQ( 0, ring_buffer_put_bytes( & c, NULL, 0 ) );
+	EXPECT_EQ( 1, ring_buffer_encode_commit( & c ) );
+	ring_buffer_decode_begin( & c, & rb );
+	EXPECT_EQ( 0, ring_buffer_get_bytes( & c, NULL, 0 ) );
+	EXPECT_EQ( 1, ring_buffer_decode_commit( & c ) );
+}
+
+//
+// Tests for ring_buffer_peek_at() and ring_buffer_patch_at()
+//
+
+TEST_F( RingBufferTest, RingBufferPeekPatchAt ) {
+	uint8_t storage[ 16 ];
+	ring_buffer_t _rb;
+	ring_buffer_t *rb = &_rb;
+	char buf[ 16 ] = {};
+	uint8_t len;
+
+	ring_buffer_init( rb, sizeof( storage ), storage );
+	EXPECT_EQ( -1, ring_buffer_peek_at( NULL, 0, buf, 1 ) );
+	EXPECT_EQ( 0, ring_buffer_peek_at( rb, 0, buf, 1 ) );
+
+	// a length byte, then a body, straddling the end of storage
+	fill_at( rb, 12, "?hello world", 12 );
+	EXPECT_EQ( 5, ring_buffer_peek_at( rb, 1, buf, 5 ) );
+	EXPECT_EQ( 0, memcmp( "hello", buf, 5 ) );
+	EXPECT_EQ( 5, ring_buffer_peek_at( rb, 7, buf, 8 ) );
+	EXPECT_EQ( 0, memcmp( "world", buf, 5 ) );
+	EXPECT_EQ( 0, ring_buffer_peek_at( rb, 12, buf, 1 ) );
+
+	// rewrite the length once the body is in
+	len = 11;
+	EXPECT_EQ( 1, ring_buffer_patch_at( rb, 0, & len, 1 ) );
+	EXPECT_EQ( 5, ring_buffer_patch_at( rb, 7, "WORLD", 5 ) );
+	EXPECT_EQ( -1, ring_buffer_patch_at( rb, 8, "WORLD", 5 ) );
+	EXPECT_EQ( -1, ring_buffer_patch_at( rb, 13, "", 0 ) );
+	EXPECT_EQ( 0, ring_buffer_patch_at( rb, 12, "", 0 ) );
+
+	EXPECT_EQ( 12, rb->read( rb, buf, sizeof( buf ) ) );
+	EXPECT_EQ( 0, memcmp( "\x0bhello WORLD", buf, 12 ) );
+}
+
+//
+// Tests for ring_buffer_ws_t
+//
+
+TEST( RingBufferWs, Ends ) {
+	RING_BUFFER_WS_DECL_CONTIG( 4, deque );
+	ring_buffer_ws_t *ws = RING_BUFFER_WS_CONTIG_HANDLE( deque );
+	void *x = NULL;
+	uintptr_t i;
+
+	ASSERT_EQ( -1, ring_buffer_ws_init( ws, 0, RING_BUFFER_WS_CONTIG_BUFFER( deque ) ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_ws_init( ws, 4, RING_BUFFER_WS_CONTIG_BUFFER( deque ) ) );
+	EXPECT_EQ( 0U, (uintptr_t) ws % RING_BUFFER_WS_CACHELINE );
+	EXPECT_EQ( -1, ring_buffer_ws_pop( ws, & x ) );
+	EXPECT_EQ( -1, ring_buffer_ws_steal( ws, & x ) );
+
+	for( i = 1; i <= 4; i++ ) {
+		EXPECT_EQ( EXIT_SUCCESS, ring_buffer_ws_push( ws, (void *) i ) );
+	}
+	EXPECT_EQ( -1, ring_buffer_ws_push( ws, (void *) 5 ) );
+	EXPECT_EQ( 4U, ring_buffer_ws_size( ws ) );
+
+	// the owner pops the newest, thieves take the oldest
+	EXPECT_EQ( EXIT_SUCCESS, ring_buffer_ws_pop( ws, & x ) );
+	EXPECT_EQ( (void *) 4, x );
+	EXPECT_EQ( EXIT_SUCCESS, ring_buffer_ws_steal( ws, & x ) );
+	EXPECT_EQ( (void *) 1, x );
+
+	// around the ring
+	for( i = 5; i <= 6; i++ ) {
+		EXPECT_EQ( EXIT_SUCCESS, ring_buffer_ws_push( ws, (void *) i ) );
+	}
+	EXPECT_EQ( -1, ring_buffer_ws_push( ws, (void *) 7 ) );
+	for( i = 2; i <= 3; i++ ) {
+		EXPECT_EQ( EXIT_SUCCESS, ring_buffer_ws_steal( ws, & x ) );
+		EXPECT_EQ( (void *) i, x );
+	}
+	EXPECT_EQ( EXIT_SUCCESS, ring_buffer_ws_pop( ws, & x ) );
+	EXPECT_EQ( (void *) 6, x );
+	EXPECT_EQ( EXIT_SUCCESS, ring_buffer_ws_pop( ws, & x ) );
+	EXPECT_EQ( (void *) 5, x );
+	EXPECT_EQ( -1, ring_buffer_ws_pop( ws, & x ) );
+	EXPECT_EQ( 0U, ring_buffer_ws_size( ws ) );
+}
+
+// every item pushed is taken exactly once, by the owner or by a thief
+TEST( RingBufferWs, Stress ) {
+	static const uintptr_t n = 50000;
+	RING_BUFFER_WS_DECL_CONTIG( 64, deque );
+	ring_buffer_ws_t *ws = RING_BUFFER_WS_CONTIG_HANDLE( deque );
+	vector< atomic< uint8_t > > seen( n + 1 );
+	atomic< bool > done( false );
+	atomic< uintptr_t > taken( 0 );
+	vector< thread > thieves;
+	uintptr_t i;
+	void *x;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_ws_init( ws, 64, RING_BUFFER_WS_CONTIG_BUFFER( deque ) ) );
+
+	for( unsigned j = 0; j < 3; j++ ) {
+		thieves.push_back( thread( [ & ]() {
+			void *x;
+			int r;
+			while( ! done ) {
+				r = ring_buffer_ws_steal( ws, & x );
+				if ( EXIT_SUCCESS == r ) {
+					seen[ (uintptr_t) x ]++;
+					taken++;
+				} else if ( -1 == r ) {
+					this_thread::yield();
+				}
+			}
+		} ) );
+	}
+
+	for( i = 1; i <= n; ) {
+		if ( EXIT_SUCCESS == ring_buffer_ws_push( ws, (void *) i ) ) {
+			i++;
+		}
+		// pop now and then, so that owner and thieves meet over the last element
+		if ( 0 == i % 3 && EXIT_SUCCESS == ring_buffer_ws_pop( ws, & x ) ) {
+			seen[ (uintptr_t) x ]++;
+			taken++;
+		}
+	}
+	while( EXIT_SUCCESS == ring_buffer_ws_pop( ws, & x ) ) {
+		seen[ (uintptr_t) x ]++;
+		taken++;
+	}
+	done = true;
+	for( auto &th: thieves ) {
+		th.join();
+	}
+
+	EXPECT_EQ( n, taken.load() );
+	for( i = 1; i <= n; i++ ) {
+		ASSERT_EQ( 1, seen[ i ] ) << i;
+	}
+}
+
+//
+// Tests for ring_buffer_pool_t
+//
+
+TEST( RingBufferPool, AllocFree ) {
+	alignas( RING_BUFFER_POOL_ALIGN ) uint8_t slab[ 4 * 32 + 4 * sizeof( uint32_t ) ];
+	ring_buffer_pool_t p;
+	void *obj[ 4 ];
+	uint8_t *x;
+
+	EXPECT_EQ( sizeof( slab ), ring_buffer_pool_footprint( 20, 4 ) );
+	ASSERT_EQ( -1, ring_buffer_pool_init( & p, 0, 4, slab ) );
+	ASSERT_EQ( -1, ring_buffer_pool_init( & p, 20, 4, slab + 1 ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_pool_init( & p, 20, 4, slab ) );
+	EXPECT_EQ( 4U, ring_buffer_pool_available( & p ) );
+
+	for( unsigned i = 0; i < 4; i++ ) {
+		obj[ i ] = ring_buffer_pool_alloc( & p );
+		ASSERT_EQ( (void *) & slab[ 32 * i ], obj[ i ] );
+		memset( obj[ i ], 0xff, 20 );
+	}
+	EXPECT_EQ( NULL, ring_buffer_pool_alloc( & p ) );
+	EXPECT_EQ( 0U, ring_buffer_pool_available( & p ) );
+
+	// foreign and misaligned objects are refused
+	EXPECT_EQ( -1, ring_buffer_pool_free( & p, & slab[ 1 ] ) );
+	EXPECT_EQ( -1, ring_buffer_pool_free( & p, & slab[ 4 * 32 ] ) );
+	EXPECT_EQ( -1, ring_buffer_pool_free( & p, & p ) );
+
+	// objects come back in the order they were freed
+	EXPECT_EQ( EXIT_SUCCESS, ring_buffer_pool_free( & p, obj[ 2 ] ) );
+	EXPECT_EQ( EXIT_SUCCESS, ring_buffer_pool_free( & p, obj[ 0 ] ) );
+	EXPECT_EQ( 2U, ring_buffer_pool_available( & p ) );
+	x = (uint8_t *) ring_buffer_pool_alloc( & p );
+	EXPECT_EQ( obj[ 2 ], x );
+	x = (uint8_t *) ring_buffer_pool_alloc( & p );
+	EXPECT_EQ( obj[ 0 ], x );
+
+	for( unsigned i = 0; i < 4; i++ ) {
+		EXPECT_EQ( EXIT_SUCCESS, ring_buffer_pool_free( & p, obj[ i ] ) );
+	}
+	// one free too many
+	EXPECT_EQ( -1, ring_buffer_pool_free( & p, obj[ 0 ] ) );
+}
+
+TEST( RingBufferPool, Spsc ) {
+	alignas( RING_BUFFER_POOL_ALIGN ) uint8_t slab[ 3 * 16 + 3 * sizeof( uint32_t ) ];
+	ring_buffer_pool_spsc_t p;
+	void *obj[ 3 ];
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_pool_spsc_init( & p, 8, 3, slab ) );
+	EXPECT_EQ( 3U, ring_buffer_pool_spsc_available( & p ) );
+	EXPECT_EQ( -1, ring_buffer_pool_spsc_free( & p, slab ) );
+
+	for( unsigned i = 0; i < 3; i++ ) {
+		obj[ i ] = ring_buffer_pool_spsc_alloc( & p );
+		ASSERT_EQ( (void *) & slab[ 16 * i ], obj[ i ] );
+	}
+	EXPECT_EQ( NULL, ring_buffer_pool_spsc_alloc( & p ) );
+	EXPECT_EQ( -1, ring_buffer_pool_spsc_free( & p, & slab[ 8 ] ) );
+
+	EXPECT_EQ( EXIT_SUCCESS, ring_buffer_pool_spsc_free( & p, obj[ 1 ] ) );
+	EXPECT_EQ( obj[ 1 ], ring_buffer_pool_spsc_alloc( & p ) );
+	for( unsigned i = 0; i < 3; i++ ) {
+		EXPECT_EQ( EXIT_SUCCESS, ring_buffer_pool_spsc_free( & p, obj[ i ] ) );
+	}
+	EXPECT_EQ( 3U, ring_buffer_pool_spsc_available( & p ) );
+}
+
+// one thread allocates and hands objects over a ring to another, which frees
+// them. no object may be handed out twice at once
+TEST( RingBufferPool, SpscThreads ) {
+	static const unsigned n = 16;
+	static const uint64_t rounds = 100000;
+	vector< uint8_t > slab( ring_buffer_pool_footprint( sizeof( uint64_t ), n ) + RING_BUFFER_POOL_ALIGN );
+	uint8_t *aligned = (uint8_t *)( ( (uintptr_t) & slab[ 0 ] + RING_BUFFER_POOL_ALIGN - 1 ) & ~( (uintptr_t) RING_BUFFER_POOL_ALIGN - 1 ) );
+	ring_buffer_pool_spsc_t p;
+	mutex lock;
+	deque< uint64_t * > handoff;
+	atomic< uint64_t > errors( 0 );
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_pool_spsc_init( & p, sizeof( uint64_t ), n, aligned ) );
+
+	thread freer( [ & ]() {
+		uint64_t expect = 0;
+		uint64_t *obj;
+		while( expect < rounds ) {
+			lock.lock();
+			obj = handoff.empty() ? NULL : handoff.front();
+			if ( NULL != obj ) {
+				handoff.pop_front();
+			}
+			lock.unlock();
+			if ( NULL == obj ) {
+				this_thread::yield();
+				continue;
+			}
+			errors += *obj != expect++;
+			*obj = ~0ULL;
+			errors += EXIT_SUCCESS != ring_buffer_pool_spsc_free( & p, obj );
+		}
+	} );
+
+	for( uint64_t i = 0; i < rounds; ) {
+		uint64_t *obj = (uint64_t *) ring_buffer_pool_spsc_alloc( & p );
+		if ( NULL == obj ) {
+			this_thread::yield();
+			continue;
+		}
+		// freed objects were poisoned after their last use
+		errors += ~0ULL != *obj && i >= n;
+		*obj = i++;
+		lock.lock();
+		handoff.push_back( obj );
+		lock.unlock();
+	}
+	freer.join();
+
+	EXPECT_EQ( 0U, errors.load() );
+	EXPECT_EQ( n, ring_buffer_pool_spsc_available( & p ) );
+}
+
+//
+// Tests for ring_buffer_tb_t
+//
+
+TEST( RingBufferTb, Latest ) {
+	uint32_t storage[ 3 ];
+	ring_buffer_tb_t tb;
+	uint32_t v;
+	int fresh;
+
+	// the writer's, the reader's and the shared state are on separate lines
+	EXPECT_NE( offsetof( ring_buffer_tb_t, back ) / RING_BUFFER_TB_CACHELINE, offsetof( ring_buffer_tb_t, front ) / RING_BUFFER_TB_CACHELINE );
+	EXPECT_NE( offsetof( ring_buffer_tb_t, back ) / RING_BUFFER_TB_CACHELINE, offsetof( ring_buffer_tb_t, middle ) / RING_BUFFER_TB_CACHELINE );
+	EXPECT_NE( offsetof( ring_buffer_tb_t, valid ) / RING_BUFFER_TB_CACHELINE, offsetof( ring_buffer_tb_t, middle ) / RING_BUFFER_TB_CACHELINE );
+
+	ASSERT_EQ( -1, ring_buffer_tb_init( & tb, 0, storage ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_tb_init( & tb, sizeof( v ), storage ) );
+
+	EXPECT_EQ( NULL, ring_buffer_tb_latest( & tb, & fresh ) );
+	EXPECT_EQ( 0, fresh );
+	EXPECT_EQ( 0, ring_buffer_tb_read( & tb, & v ) );
+
+	// the writer never waits, and the reader only sees the newest value
+	for( v = 1; v <= 5; v++ ) {
+		EXPECT_EQ( (int) sizeof( v ), ring_buffer_tb_write( & tb, & v ) );
+	}
+	v = 0;
+	EXPECT_EQ( (int) sizeof( v ), ring_buffer_tb_read( & tb, & v ) );
+	EXPECT_EQ( 5U, v );
+	EXPECT_EQ( 0, ring_buffer_tb_read( & tb, & v ) );
+	EXPECT_EQ( 5U, *(const uint32_t *) ring_buffer_tb_latest( & tb, & fresh ) );
+	EXPECT_EQ( 0, fresh );
+
+	// in place
+	*(uint32_t *) ring_buffer_tb_back( & tb ) = 6;
+	EXPECT_EQ( 5U, *(const uint32_t *) ring_buffer_tb_latest( & tb, & fresh ) );
+	ring_buffer_tb_publish( & tb );
+	EXPECT_EQ( 6U, *(const uint32_t *) ring_buffer_tb_latest( & tb, & fresh ) );
+	EXPECT_EQ( 1, fresh );
+
+	// alternating, every value gets through
+	for( v = 7; v < 20; v++ ) {
+		uint32_t w;
+		ring_buffer_tb_write( & tb, & v );
+		EXPECT_EQ( (int) sizeof( w ), ring_buffer_tb_read( & tb, & w ) );
+		EXPECT_EQ( v, w );
+	}
+}
+
+// values never tear, and never go backwards
+TEST( RingBufferTb, Threads ) {
+	static const uint64_t n = 200000;
+	static const unsigned words = 16;
+	uint64_t storage[ 3 * words ];
+	ring_buffer_tb_t tb;
+	uint64_t errors = 0;
+	uint64_t last = 0;
+	uint64_t seen = 0;
+	const uint64_t *v;
+	int fresh;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_tb_init( & tb, sizeof( uint64_t ) * words, storage ) );
+
+	thread writer( [ & ]() {
+		uint64_t *slot;
+		for( uint64_t i = 1; i <= n; i++ ) {
+			slot = (uint64_t *) ring_buffer_tb_back( & tb );
+			for( unsigned j = 0; j < words; j++ ) {
+				slot[ j ] = i;
+			}
+			ring_buffer_tb_publish( & tb );
+		}
+	} );
+
+	while( last < n ) {
+		v = (const uint64_t *) ring_buffer_tb_latest( & tb, & fresh );
+		if ( ! fresh ) {
+			this_thread::yield();
+			continue;
+		}
+		for( unsigned j = 1; j < words; j++ ) {
+			errors += v[ j ] != v[ 0 ];
+		}
+		errors += v[ 0 ] <= last;
+		last = v[ 0 ];
+		seen++;
+	}
+	writer.join();
+
+	EXPECT_EQ( 0U, errors );
+	EXPECT_EQ( n, last );
+	EXPECT_LE( seen, n );
+}
+
+//
+// Tests for ringbuffer::async_ring
+//
+
+// resumes posted coroutines from run(), one at a time, in order
+class queue_executor : public ringbuffer::executor {
+
+public:
+
+	void post( coroutine_handle<> h ) override {
+		q.push_back( h );
+	}
+
+	// returns the number of coroutines resumed
+	unsigned run() {
+		unsigned r;
+		for( r = 0; ! q.empty(); r++ ) {
+			coroutine_handle<> h = q.front();
+			q.pop_front();
+			h.resume();
+		}
+		return r;
+	}
+
+private:
+
+	deque< coroutine_handle<> > q;
+};
+
+// a coroutine that starts at once and frees itself when done
+struct detached {
+	struct promise_type {
+		detached get_return_object() { return {}; }
+		suspend_never initial_suspend() { return {}; }
+		suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { terminate(); }
+	};
+};
+
+static detached async_reader( ringbuffer::async_ring &ar, unsigned chunk, unsigned count, string &out, int &status ) {
+	char buf[ 16 ];
+	int r;
+	for( unsigned i = 0; i < count; i++ ) {
+		r = co_await ringbuffer::async_read( ar, buf, chunk );
+		if ( (int) chunk != r ) {
+			status = r;
+			co_return;
+		}
+		out.append( buf, chunk );
+	}
+	status = 1;
+}
+
+static detached async_writer( ringbuffer::async_ring &ar, const string &in, unsigned chunk, int &status ) {
+	int r;
+	for( unsigned i = 0; i < in.size(); i += chunk ) {
+		r = co_await ringbuffer::async_write( ar, & in[ i ], chunk );
+		if ( (int) chunk != r ) {
+			status = r;
+			co_return;
+		}
+	}
+	status = 1;
+}
+
+TEST( RingBufferAsync, ReadSuspendsUntilWritten ) {
+	ringbuffer::ring r( 8 );
+	queue_executor ex;
+	ringbuffer::async_ring ar( r, ex );
+	string out;
+	int status = 0;
+
+	async_reader( ar, 4, 2, out, status );
+	EXPECT_EQ( 0, status );
+	EXPECT_EQ( 0U, ex.run() );
+
+	// not enough yet: the reader stays parked
+	EXPECT_EQ( 3, ar.write( "abc", 3 ) );
+	EXPECT_EQ( 0U, ex.run() );
+
+	// the write that satisfies the reader also does its read
+	EXPECT_EQ( 3, ar.write( "def", 3 ) );
+	EXPECT_EQ( 2U, r.size() );
+	EXPECT_EQ( 1U, ex.run() );
+	EXPECT_EQ( "abcd", out );
+
+	EXPECT_EQ( 2, ar.write( "gh", 2 ) );
+	EXPECT_EQ( 1U, ex.run() );
+	EXPECT_EQ( 1, status );
+	EXPECT_EQ( "abcdefgh", out );
+	EXPECT_TRUE( r.empty() );
+}
+
+TEST( RingBufferAsync, WriteSuspendsUntilRead ) {
+	ringbuffer::ring r( 8 );
+	queue_executor ex;
+	ringbuffer::async_ring ar( r, ex );
+	string in = "0123456789ab";
+	char buf[ 8 ];
+	int status = 0;
+
+	// the first two writes complete without suspending
+	async_writer( ar, in, 4, status );
+	EXPECT_EQ( 8U, r.size() );
+	EXPECT_EQ( 0, status );
+
+	EXPECT_EQ( 3, ar.read( buf, 3 ) );
+	EXPECT_EQ( 0U, ex.run() );
+	EXPECT_EQ( 1, ar.read( buf, 1 ) );
+	EXPECT_EQ( 8U, r.size() );
+	EXPECT_EQ( 1U, ex.run() );
+	EXPECT_EQ( 1, status );
+
+	ASSERT_EQ( 8, ar.read( buf, 8 ) );
+	EXPECT_EQ( 0, memcmp( "456789ab", buf, 8 ) );
+}
+
+TEST( RingBufferAsync, PingPong ) {
+	static const unsigned chunk = 3;
+	ringbuffer::ring r( 5 );
+	queue_executor ex;
+	ringbuffer::async_ring ar( r, ex );
+	string in;
+	string out;
+	int wstatus = 0;
+	int rstatus = 0;
+
+	for( unsigned i = 0; i < 300; i++ ) {
+		in += 'a' + i % 26;
+	}
+
+	// neither side ever fits more than one chunk, so they must take turns
+	async_reader( ar, chunk, in.size() / chunk, out, rstatus );
+	async_writer( ar, in, chunk, wstatus );
+	while( 0 != ex.run() );
+
+	EXPECT_EQ( 1, wstatus );
+	EXPECT_EQ( 1, rstatus );
+	EXPECT_EQ( in, out );
+}
+
+TEST( RingBufferAsync, InlineAndOversize ) {
+	ringbuffer::ring r( 4 );
+	ringbuffer::inline_executor ex;
+	ringbuffer::async_ring ar( r, ex );
+	string in = "abcdefghijkl";
+	string out;
+	int wstatus = 0;
+	int rstatus = 0;
+
+	async_reader( ar, 2, 6, out, rstatus );
+	async_writer( ar, in, 4, wstatus );
+	EXPECT_EQ( 1, wstatus );
+	EXPECT_EQ( 1, rstatus );
+	EXPECT_EQ( in, out );
+
+	// more than the ring can ever hold
+	async_reader( ar, 5, 1, out, rstatus );
+	EXPECT_EQ( -1, rstatus );
+}
+
+//
+// Tests for ring_buffer_par_t
+//
+
+static void par_fill( vector< uint8_t > &v, unsigned seed ) {
+	for( size_t i = 0; i < v.size(); i++ ) {
+		v[ i ] = ( i * 2654435761u + seed ) >> 13;
+	}
+}
+
+TEST( RingBufferPar, Memcpy ) {
+	ring_buffer_par_pool_t p;
+	vector< uint8_t > src( 3 * RING_BUFFER_PAR_MIN_CHUNK + 13 );
+	vector< uint8_t > dst;
+
+	par_fill( src, 1 );
+	ASSERT_EQ( -1, ring_buffer_par_pool_init( & p, RING_BUFFER_PAR_MAX_THREADS + 1 ) );
+	for( unsigned nthreads: { 0, 1, 3 } ) {
+		ASSERT_EQ( EXIT_SUCCESS, ring_buffer_par_pool_init( & p, nthreads ) );
+		// below, at and well above the size at which the pool joins in
+		for( size_t len: { (size_t) 100, (size_t) 2 * RING_BUFFER_PAR_MIN_CHUNK, src.size() } ) {
+			// one spare byte, to catch a copy that runs past len
+			dst.assign( src.size() + 1, 0 );
+			ring_buffer_par_memcpy( & p, & dst[ 0 ], & src[ 0 ], len );
+			EXPECT_TRUE( equal( src.begin(), src.begin() + len, dst.begin() ) ) << nthreads << " " << len;
+			EXPECT_EQ( 0, dst[ len ] );
+		}
+		ring_buffer_par_pool_destroy( & p );
+	}
+}
+
+TEST( RingBufferPar, WriteAndSend ) {
+	static const unsigned cap = 5 * RING_BUFFER_PAR_MIN_CHUNK + 7;
+	ring_buffer_par_pool_t p;
+	ring_buffer_par_t par;
+	ring_buffer_t in;
+	ring_buffer_t *rb = & par.rb;
+	vector< uint8_t > storage( cap );
+	vector< uint8_t > in_storage( cap );
+	vector< uint8_t > src( cap );
+	vector< uint8_t > out( cap );
+	unsigned n = 3 * RING_BUFFER_PAR_MIN_CHUNK + 1;
+
+	par_fill( src, 2 );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_par_pool_init( & p, 3 ) );
+	ASSERT_EQ( -1, ring_buffer_par_init( & par, cap, & storage[ 0 ], NULL, 0 ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_par_init( & par, cap, & storage[ 0 ], & p, RING_BUFFER_PAR_MIN_CHUNK ) );
+
+	// small writes take the usual path, and put the tail near the end of storage
+	ASSERT_EQ( 100, rb->write( rb, & src[ 0 ], 100 ) );
+	rb->head = cap - 2 * RING_BUFFER_PAR_MIN_CHUNK;
+	rb->len = 0;
+
+	// across the wrap
+	ASSERT_EQ( (int) n, rb->write( rb, & src[ 0 ], n ) );
+	ASSERT_EQ( n, rb->size( rb ) );
+	ASSERT_EQ( (int) n, rb->peek( rb, & out[ 0 ], n ) );
+	EXPECT_TRUE( equal( src.begin(), src.begin() + n, out.begin() ) );
+
+	// no more than fits
+	EXPECT_EQ( (int)( cap - n ), rb->write( rb, & src[ 0 ], cap ) );
+	rb->reset( rb );
+
+	// from a wrapped input into a wrapped output, wrapping at different points
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_init( & in, cap, & in_storage[ 0 ] ) );
+	in.head = cap - RING_BUFFER_PAR_MIN_CHUNK - 5;
+	ASSERT_EQ( (int) n, in.write( & in, & src[ 0 ], n ) );
+	rb->head = cap - 2 * RING_BUFFER_PAR_MIN_CHUNK;
+	ASSERT_EQ( (int) n, rb->send( rb, & in, n ) );
+	EXPECT_EQ( 0U, in.len );
+	ASSERT_EQ( (int) n, rb->read( rb, & out[ 0 ], n ) );
+	EXPECT_TRUE( equal( src.begin(), src.begin() + n, out.begin() ) );
+
+	ring_buffer_par_pool_destroy( & p );
+}
+
+//
+// Tests for the small-transfer fast paths
+//
+
+// every size, at every position, against the general operations
+TEST( RingBufferSmall, AllPositions ) {
+	static const unsigned cap = 19;
+	RING_BUFFER_DECL_CONTIG( cap, ring );
+	ring_buffer_t *rb = RING_BUFFER_CONTIG_HANDLE( ring );
+	uint8_t in[ RING_BUFFER_SMALL_MAX ];
+	uint8_t out[ RING_BUFFER_SMALL_MAX ];
+	uint8_t expect[ RING_BUFFER_SMALL_MAX ];
+
+	for( unsigned i = 0; i < sizeof( in ); i++ ) {
+		in[ i ] = 0xa0 + i;
+	}
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_init( rb, cap, RING_BUFFER_CONTIG_BUFFER( ring ) ) );
+
+	for( unsigned n = 1; n <= RING_BUFFER_SMALL_MAX; n++ ) {
+		for( unsigned head = 0; head < cap; head++ ) {
+			rb->reset( rb );
+			memset( RING_BUFFER_CONTIG_BUFFER( ring ), 0, cap );
+			rb->head = head;
+			rb->len = 1;
+
+			ASSERT_EQ( (int) n, ring_buffer_write_small( rb, in, n ) );
+			ASSERT_EQ( n + 1, rb->size( rb ) );
+			ASSERT_EQ( 1, rb->skip( rb, 1 ) );
+			ASSERT_EQ( (int) n, rb->peek( rb, expect, n ) );
+			ASSERT_EQ( 0, memcmp( in, expect, n ) ) << n << " " << head;
+
+			memset( out, 0, sizeof( out ) );
+			ASSERT_EQ( (int) n, ring_buffer_peek_small( rb, out, n ) );
+			ASSERT_EQ( 0, memcmp( in, out, n ) ) << n << " " << head;
+			memset( out, 0, sizeof( out ) );
+			ASSERT_EQ( (int) n, ring_buffer_read_small( rb, out, n ) );
+			ASSERT_EQ( 0, memcmp( in, out, n ) ) << n << " " << head;
+			ASSERT_EQ( 0U, rb->size( rb ) );
+			ASSERT_EQ( ( head + 1 + n ) % cap, rb->head );
+		}
+	}
+}
+
+TEST( RingBufferSmall, Fixed ) {
+	RING_BUFFER_DECL_CONTIG( 16, ring );
+	ring_buffer_t *rb = RING_BUFFER_CONTIG_HANDLE( ring );
+	uint8_t v8;
+	uint16_t v16;
+	uint32_t v32;
+	uint64_t v64;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_init( rb, 16, RING_BUFFER_CONTIG_BUFFER( ring ) ) );
+	rb->head = 13;
+
+	EXPECT_EQ( 0, ring_buffer_read8( rb, & v8 ) );
+	EXPECT_EQ( 1, ring_buffer_write8( rb, 0x12 ) );
+	EXPECT_EQ( 2, ring_buffer_write16( rb, 0x3456 ) );
+	EXPECT_EQ( 4, ring_buffer_write32( rb, 0x789abcde ) );
+	EXPECT_EQ( 8, ring_buffer_write64( rb, 0x0123456789abcdefULL ) );
+	EXPECT_EQ( 15U, rb->size( rb ) );
+	// all or nothing
+	EXPECT_EQ( 0, ring_buffer_write16( rb, 0 ) );
+	EXPECT_EQ( 15U, rb->size( rb ) );
+
+	EXPECT_EQ( 1, ring_buffer_read8( rb, & v8 ) );
+	EXPECT_EQ( 0x12, v8 );
+	EXPECT_EQ( 2, ring_buffer_peek16( rb, & v16 ) );
+	EXPECT_EQ( 2, ring_buffer_read16( rb, & v16 ) );
+	EXPECT_EQ( 0x3456, v16 );
+	EXPECT_EQ( 4, ring_buffer_read32( rb, & v32 ) );
+	EXPECT_EQ( 0x789abcdeU, v32 );
+	EXPECT_EQ( 8, ring_buffer_read64( rb, & v64 ) );
+	EXPECT_EQ( 0x0123456789abcdefULL, v64 );
+	EXPECT_EQ( 0U, rb->size( rb ) );
+	EXPECT_EQ( 0, ring_buffer_read64( rb, & v64 ) );
+}
+
+//
+// Tests for ring_buffer_poll_many()
+//
+
+struct poll_log {
+	vector< string > seen;
+	unsigned consume;
+	unsigned stop_after;
+};
+
+static int poll_cb( ring_buffer_t *rb, const struct iovec *seg, int nseg, void *arg ) {
+	poll_log *log = (poll_log *) arg;
+	string s;
+	for( int i = 0; i < nseg; i++ ) {
+		s.append( (const char *) seg[ i ].iov_base, seg[ i ].iov_len );
+		s += '|';
+	}
+	log->seen.push_back( s );
+	return log->seen.size() == log->stop_after ? -1 : min< unsigned >( log->consume, rb->len );
+}
+
+TEST( RingBufferPoll, Many ) {
+	static const unsigned n = 40;
+	vector< vector< uint8_t > > storage( n, vector< uint8_t >( 8 ) );
+	vector< ring_buffer_t > rbs( n );
+	vector< ring_buffer_t * > rings( n );
+	poll_log log = { {}, 2, 0 };
+
+	EXPECT_EQ( -1, ring_buffer_poll_many( NULL, n, poll_cb, & log ) );
+
+	for( unsigned i = 0; i < n; i++ ) {
+		ring_buffer_init( & rbs[ i ], 8, & storage[ i ][ 0 ] );
+		rings[ i ] = & rbs[ i ];
+	}
+	// every third ring has data; ring 3 wraps
+	for( unsigned i = 0; i < n; i += 3 ) {
+		rbs[ i ].head = 3 == i ? 6 : 0;
+		rbs[ i ].write( & rbs[ i ], (void *) "abcd", 4 );
+	}
+
+	EXPECT_EQ( 14, ring_buffer_poll_many( & rings[ 0 ], n, poll_cb, & log ) );
+	ASSERT_EQ( 14U, log.seen.size() );
+	EXPECT_EQ( "abcd|", log.seen[ 0 ] );
+	EXPECT_EQ( "ab|cd|", log.seen[ 1 ] );
+	// the callback's bytes were consumed
+	for( unsigned i = 0; i < n; i++ ) {
+		EXPECT_EQ( 0 == i % 3 ? 2U : 0U, rbs[ i ].len ) << i;
+	}
+
+	// a negative return ends the sweep, and consumes nothing
+	log.seen.clear();
+	log.stop_after = 5;
+	EXPECT_EQ( 5, ring_buffer_poll_many( & rings[ 0 ], n, poll_cb, & log ) );
+	EXPECT_EQ( "cd|", log.seen[ 4 ] );
+	EXPECT_EQ( 2U, rbs[ 12 ].len );
+	EXPECT_EQ( 0U, rbs[ 0 ].len );
+
+	EXPECT_EQ( 0, ring_buffer_poll_many( & rings[ 1 ], 2, poll_cb, & log ) );
+}
+
+#ifdef __linux__
+
+//
+// Tests for ring_buffer_numa_spsc_t
+//
+
+TEST( RingBufferNuma, Alloc ) {
+	int nodes = ring_buffer_numa_nodes();
+	uint8_t *p;
+
+	ASSERT_GE( nodes, 1 );
+	EXPECT_GE( ring_buffer_numa_current_node(), 0 );
+	EXPECT_LT( ring_buffer_numa_current_node(), nodes );
+	EXPECT_LT( ring_buffer_numa_node_of_cpu( 0 ), nodes );
+
+	EXPECT_EQ( NULL, ring_buffer_numa_alloc( 4096, nodes ) );
+	EXPECT_EQ( NULL, ring_buffer_numa_alloc( 4096, -2 ) );
+	EXPECT_EQ( NULL, ring_buffer_numa_alloc( 0, 0 ) );
+
+	for( int node: { RING_BUFFER_NUMA_LOCAL, 0, nodes - 1 } ) {
+		p = (uint8_t *) ring_buffer_numa_alloc( 3 * 4096 + 5, node );
+		ASSERT_NE( (uint8_t *) NULL, p );
+		EXPECT_EQ( 0U, (uintptr_t) p % 4096 );
+		EXPECT_EQ( 0, p[ 0 ] | p[ 3 * 4096 + 4 ] );
+		memset( p, 0xff, 3 * 4096 + 5 );
+		ring_buffer_numa_free( p, 3 * 4096 + 5 );
+	}
+}
+
+TEST( RingBufferNuma, Spsc ) {
+	static const unsigned cap = 13;
+	ring_buffer_numa_spsc_t s;
+	uint8_t buf[ cap ];
+	char out[ 16 ];
+
+	ASSERT_EQ( -1, ring_buffer_numa_spsc_init( & s, 0, buf, 0, 0 ) );
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_numa_spsc_init( & s, cap, buf, 0, ring_buffer_numa_nodes() - 1 ) );
+
+	EXPECT_EQ( 0, ring_buffer_numa_spsc_read( & s, out, sizeof( out ) ) );
+	EXPECT_EQ( 10, ring_buffer_numa_spsc_write( & s, "0123456789", 10 ) );
+	EXPECT_EQ( 3, ring_buffer_numa_spsc_write( & s, "abcdef", 6 ) );
+	EXPECT_EQ( 0, ring_buffer_numa_spsc_write( & s, "x", 1 ) );
+	EXPECT_EQ( 8, ring_buffer_numa_spsc_read( & s, out, 8 ) );
+	EXPECT_EQ( 0, memcmp( "01234567", out, 8 ) );
+
+	// across the wrap
+	EXPECT_EQ( 6, ring_buffer_numa_spsc_write( & s, "ABCDEF", 6 ) );
+	EXPECT_EQ( 11, ring_buffer_numa_spsc_read( & s, out, sizeof( out ) ) );
+	EXPECT_EQ( 0, memcmp( "89abcABCDEF", out, 11 ) );
+
+	ring_buffer_numa_spsc_destroy( & s );
+	EXPECT_EQ( NULL, s.head );
+}
+
+TEST( RingBufferNuma, SpscThreads ) {
+	static const uint64_t n = 1 << 20;
+	vector< uint8_t > buf( 4099 );
+	ring_buffer_numa_spsc_t s;
+	uint64_t errors = 0;
+	uint64_t next = 0;
+	uint8_t in[ 61 ];
+	uint8_t out[ 97 ];
+	int r;
+
+	ASSERT_EQ( EXIT_SUCCESS, ring_buffer_numa_spsc_init( & s, buf.size(), & buf[ 0 ], RING_BUFFER_NUMA_LOCAL, RING_BUFFER_NUMA_LOCAL ) );
+
+	thread producer( [ & ]() {
+		uint64_t i = 0;
+		unsigned len;
+		int r;
+		while( i < n ) {
+			len = min< uint64_t >( sizeof( in ), n - i );
+			for( unsigned j = 0; j < len; j++ ) {
+				in[ j ] = i + j;
+			}
+			r = ring_buffer_numa_spsc_write( & s, in, len );
+			if ( 0 == r ) {
+				this_thread::yield();
+			}
+			i += r;
+		}
+	} );
+
+	while( next < n ) {
+		r = ring_buffer_numa_spsc_read( & s, out, sizeof( out ) );
+		if ( 0 == r ) {
+			this_thread::yield();
+		}
+		for( int j = 0; j < r; j++ ) {
+			errors += out[ j ] != (uint8_t) next++;
+		}
+	}
+	producer.join();
+
+	EXPECT_EQ( 0U, errors );
+	ring_buffer_numa_spsc_destroy( & s );
+}
+
+#endif // __linux__
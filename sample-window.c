@@ -0,0 +1,180 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sample-window.h"
+
+// a + b modulo n, for a, b < n
+static inline unsigned swadd( unsigned a, unsigned b, unsigned n ) {
+	a += b;
+	return a >= n ? a - n : a;
+}
+
+// the deques hold positions in samples[], oldest first. the min deque's values
+// increase from front to back and the max deque's decrease, so each front is
+// the extremum of the window. a deque's front leaves when its sample is evicted
+#define SAMPLE_WINDOW( _type, _short_type ) \
+size_t sample_window_ ## _short_type ## _footprint( unsigned capacity ) { \
+	return 2 * (size_t) capacity * sizeof( unsigned ) + (size_t) capacity * sizeof( _type ); \
+} \
+\
+int sample_window_ ## _short_type ## _init( sample_window_ ## _short_type ## _t *w, unsigned capacity, void *buffer ) { \
+	int r; \
+	if ( NULL == w || NULL == buffer || 0 == capacity ) { \
+		r = -1; \
+		goto out; \
+	} \
+	w->capacity = capacity; \
+	w->minq = (unsigned *) buffer; \
+	w->maxq = & w->minq[ capacity ]; \
+	w->samples = (_type *) & w->maxq[ capacity ]; \
+	sample_window_ ## _short_type ## _reset( w ); \
+	r = EXIT_SUCCESS; \
+out: \
+	return r; \
+} \
+\
+void sample_window_ ## _short_type ## _reset( sample_window_ ## _short_type ## _t *w ) { \
+	if ( NULL == w ) { \
+		goto out; \
+	} \
+	w->head = 0; \
+	w->len = 0; \
+	w->minq_head = 0; \
+	w->minq_len = 0; \
+	w->maxq_head = 0; \
+	w->maxq_len = 0; \
+	w->sum = 0; \
+	w->sumsq = 0; \
+	w->evicted = 0; \
+out: \
+	return; \
+} \
+\
+int sample_window_ ## _short_type ## _write( sample_window_ ## _short_type ## _t *w, _type sample ) { \
+	int r; \
+	unsigned pos; \
+	if ( NULL == w ) { \
+		r = -1; \
+		goto out; \
+	} \
+	if ( w->len == w->capacity ) { \
+		sample_window_ ## _short_type ## _evict( w ); \
+	} \
+	pos = swadd( w->head, w->len, w->capacity ); \
+	w->samples[ pos ] = sample; \
+	w->len++; \
+	w->sum += (double) sample; \
+	w->sumsq += (double) sample * (double) sample; \
+	while( w->minq_len > 0 && w->samples[ w->minq[ swadd( w->minq_head, w->minq_len - 1, w->capacity ) ] ] >= sample ) { \
+		w->minq_len--; \
+	} \
+	w->minq[ swadd( w->minq_head, w->minq_len, w->capacity ) ] = pos; \
+	w->minq_len++; \
+	while( w->maxq_len > 0 && w->samples[ w->maxq[ swadd( w->maxq_head, w->maxq_len - 1, w->capacity ) ] ] <= sample ) { \
+		w->maxq_len--; \
+	} \
+	w->maxq[ swadd( w->maxq_head, w->maxq_len, w->capacity ) ] = pos; \
+	w->maxq_len++; \
+	r = EXIT_SUCCESS; \
+out: \
+	return r; \
+} \
+\
+int sample_window_ ## _short_type ## _evict( sample_window_ ## _short_type ## _t *w ) { \
+	int r; \
+	unsigned i; \
+	_type sample; \
+	if ( NULL == w || 0 == w->len ) { \
+		r = -1; \
+		goto out; \
+	} \
+	sample = w->samples[ w->head ]; \
+	w->sum -= (double) sample; \
+	w->sumsq -= (double) sample * (double) sample; \
+	if ( w->minq_len > 0 && w->minq[ w->minq_head ] == w->head ) { \
+		w->minq_head = swadd( w->minq_head, 1, w->capacity ); \
+		w->minq_len--; \
+	} \
+	if ( w->maxq_len > 0 && w->maxq[ w->maxq_head ] == w->head ) { \
+		w->maxq_head = swadd( w->maxq_head, 1, w->capacity ); \
+		w->maxq_len--; \
+	} \
+	w->head = swadd( w->head, 1, w->capacity ); \
+	w->len--; \
+	if ( ++w->evicted == w->capacity ) { \
+		w->evicted = 0; \
+		w->sum = 0; \
+		w->sumsq = 0; \
+		for( i = 0; i < w->len; i++ ) { \
+			sample = w->samples[ swadd( w->head, i, w->capacity ) ]; \
+			w->sum += (double) sample; \
+			w->sumsq += (double) sample * (double) sample; \
+		} \
+	} \
+	r = EXIT_SUCCESS; \
+out: \
+	return r; \
+} \
+\
+unsigned sample_window_ ## _short_type ## _size( sample_window_ ## _short_type ## _t *w ) { \
+	return NULL == w ? 0 : w->len; \
+} \
+\
+double sample_window_ ## _short_type ## _sum( sample_window_ ## _short_type ## _t *w ) { \
+	return NULL == w ? 0 : w->sum; \
+} \
+\
+double sample_window_ ## _short_type ## _mean( sample_window_ ## _short_type ## _t *w ) { \
+	return NULL == w || 0 == w->len ? 0 : w->sum / w->len; \
+} \
+\
+double sample_window_ ## _short_type ## _variance( sample_window_ ## _short_type ## _t *w ) { \
+	double r; \
+	double mean; \
+	if ( NULL == w || 0 == w->len ) { \
+		r = 0; \
+		goto out; \
+	} \
+	mean = w->sum / w->len; \
+	r = w->sumsq / w->len - mean * mean; \
+	r = r < 0 ? 0 : r; \
+out: \
+	return r; \
+} \
+\
+int sample_window_ ## _short_type ## _min( sample_window_ ## _short_type ## _t *w, _type *min ) { \
+	int r; \
+	if ( NULL == w || NULL == min || 0 == w->len ) { \
+		r = -1; \
+		goto out; \
+	} \
+	*min = w->samples[ w->minq[ w->minq_head ] ]; \
+	r = EXIT_SUCCESS; \
+out: \
+	return r; \
+} \
+\
+int sample_window_ ## _short_type ## _max( sample_window_ ## _short_type ## _t *w, _type *max ) { \
+	int r; \
+	if ( NULL == w || NULL == max || 0 == w->len ) { \
+		r = -1; \
+		goto out; \
+	} \
+	*max = w->samples[ w->maxq[ w->maxq_head ] ]; \
+	r = EXIT_SUCCESS; \
+out: \
+	return r; \
+}
+
+SAMPLE_WINDOW( uint8_t, u8 );
+SAMPLE_WINDOW( uint16_t, u16 );
+SAMPLE_WINDOW( uint32_t, u32 );
+SAMPLE_WINDOW( uint64_t, u64 );
+
+SAMPLE_WINDOW( int8_t, s8 );
+SAMPLE_WINDOW( int16_t, s16 );
+SAMPLE_WINDOW( int32_t, s32 );
+SAMPLE_WINDOW( int64_t, s64 );
+
+SAMPLE_WINDOW( float, f32 );
+SAMPLE_WINDOW( double, f64 );
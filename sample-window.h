@@ -0,0 +1,63 @@
+#ifndef SAMPLE_WINDOW_H_
+#define SAMPLE_WINDOW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A ring of the last N numeric samples that keeps its aggregates up to date as
+// samples are written and evicted, so that queries cost O(1) instead of a pass
+// over the window. Sum and sum of squares are running totals; min and max are
+// the fronts of monotonic deques of sample positions, O(1) amortized per write.
+// The running totals are kept as doubles, and are recomputed from the samples
+// once every N evictions so that rounding error cannot accumulate.
+//
+// One variant per numeric type, e.g. sample_window_u32_t. The buffer passed
+// to init must be sample_window_*_footprint( capacity ) bytes, suitably
+// aligned for the sample type. Writing to a full window evicts the oldest
+// sample.
+
+#undef _decl_sw
+#define _decl_sw( _type, _short_type ) \
+	typedef struct { \
+		unsigned   capacity; \
+		unsigned   head; \
+		unsigned   len; \
+		_type     *samples; \
+		unsigned  *minq; \
+		unsigned   minq_head; \
+		unsigned   minq_len; \
+		unsigned  *maxq; \
+		unsigned   maxq_head; \
+		unsigned   maxq_len; \
+		double     sum; \
+		double     sumsq; \
+		unsigned   evicted; \
+	} sample_window_ ## _short_type ## _t; \
+	size_t sample_window_ ## _short_type ## _footprint( unsigned capacity ); \
+	int sample_window_ ## _short_type ## _init( sample_window_ ## _short_type ## _t *w, unsigned capacity, void *buffer ); \
+	void sample_window_ ## _short_type ## _reset( sample_window_ ## _short_type ## _t *w ); \
+	int sample_window_ ## _short_type ## _write( sample_window_ ## _short_type ## _t *w, _type sample ); \
+	int sample_window_ ## _short_type ## _evict( sample_window_ ## _short_type ## _t *w ); \
+	unsigned sample_window_ ## _short_type ## _size( sample_window_ ## _short_type ## _t *w ); \
+	double sample_window_ ## _short_type ## _sum( sample_window_ ## _short_type ## _t *w ); \
+	double sample_window_ ## _short_type ## _mean( sample_window_ ## _short_type ## _t *w ); \
+	double sample_window_ ## _short_type ## _variance( sample_window_ ## _short_type ## _t *w ); \
+	int sample_window_ ## _short_type ## _min( sample_window_ ## _short_type ## _t *w, _type *min ); \
+	int sample_window_ ## _short_type ## _max( sample_window_ ## _short_type ## _t *w, _type *max )
+
+_decl_sw( uint8_t, u8 );
+_decl_sw( uint16_t, u16 );
+_decl_sw( uint32_t, u32 );
+_decl_sw( uint64_t, u64 );
+
+_decl_sw( int8_t, s8 );
+_decl_sw( int16_t, s16 );
+_decl_sw( int32_t, s32 );
+_decl_sw( int64_t, s64 );
+
+_decl_sw( float, f32 );
+_decl_sw( double, f64 );
+
+#undef _decl_sw
+
+#endif /* SAMPLE_WINDOW_H_ */